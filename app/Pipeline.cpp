@@ -0,0 +1,588 @@
+#include "Pipeline.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PIPELINE_MMAP
+#endif
+
+namespace
+{
+using eval::operand_t;
+
+#ifdef EVAL_DECIMAL_OPERAND
+const operand_t missing = NAN;
+#else
+const operand_t missing = 0;
+#endif
+
+operand_t toOperand(eval::decimal_t v)
+{
+#ifdef EVAL_MIXED_OPERAND
+    return eval::Number::integer(v);
+#else
+    return static_cast<operand_t>(v);
+#endif
+}
+
+// A column of raw little endian values, as eval::encode writes them. Where
+// mmap exists the file is mapped, and chunks are converted straight out of
+// the page cache without being read into a buffer first.
+class BinaryColumn
+{
+  protected:
+    const unsigned char *data = nullptr;
+    size_t bytes = 0;
+#ifndef PIPELINE_MMAP
+    std::vector<unsigned char> contents;
+#endif
+
+  public:
+    std::string name;
+
+    BinaryColumn() = default;
+    BinaryColumn(const BinaryColumn &) = delete;
+    BinaryColumn &operator=(const BinaryColumn &) = delete;
+    ~BinaryColumn()
+    {
+#ifdef PIPELINE_MMAP
+        if (data)
+            munmap(const_cast<unsigned char *>(data), bytes);
+#endif
+    }
+
+    bool open(const std::string &path);
+    size_t rows() const { return bytes / eval::binarySize; }
+    // Whether the file holds whole values only.
+    bool whole() const { return bytes % eval::binarySize == 0; }
+
+    void read(size_t first, size_t n, operand_t *out) const
+    {
+        const unsigned char *p = data + first * eval::binarySize;
+        for (size_t i = 0; i < n; ++i, p += eval::binarySize)
+        {
+            uint64_t bits = 0;
+            for (size_t k = 0; k < eval::binarySize; ++k)
+                bits |= uint64_t(p[k]) << (8 * k);
+#ifdef EVAL_DECIMAL_OPERAND
+            double d;
+            std::memcpy(&d, &bits, sizeof(d));
+            out[i] = toOperand(d);
+#else
+            out[i] = static_cast<operand_t>(static_cast<int64_t>(bits));
+#endif
+        }
+    }
+};
+
+bool BinaryColumn::open(const std::string &path)
+{
+#ifdef PIPELINE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    bytes = static_cast<size_t>(st.st_size);
+    if (bytes)
+    {
+        void *p = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            bytes = 0;
+            return false;
+        }
+        madvise(p, bytes, MADV_SEQUENTIAL);
+        data = static_cast<const unsigned char *>(p);
+    }
+    close(fd);
+#else
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    unsigned char block[1 << 16];
+    size_t got;
+    while ((got = std::fread(block, 1, sizeof(block), file)) > 0)
+        contents.insert(contents.end(), block, block + got);
+    std::fclose(file);
+    data = contents.data();
+    bytes = contents.size();
+#endif
+    return true;
+}
+
+// Reads a CSV file line by line. The next block of the file is read on
+// another thread while the lines of the current one are parsed and
+// evaluated.
+class CsvReader
+{
+  protected:
+    static constexpr size_t blockSize = size_t(1) << 20;
+    std::FILE *file = nullptr;
+    std::future<std::string> next;
+    std::string buffer;
+    size_t pos = 0;
+    bool eof = false;
+
+    void readAhead()
+    {
+        next = std::async(std::launch::async,
+                          [file = file]
+                          {
+                              std::string block(blockSize, '\0');
+                              block.resize(std::fread(&block[0], 1,
+                                                      blockSize, file));
+                              return block;
+                          });
+    }
+
+  public:
+    std::string headerLine;
+    std::vector<std::string> header;
+
+    CsvReader() = default;
+    CsvReader(const CsvReader &) = delete;
+    CsvReader &operator=(const CsvReader &) = delete;
+    ~CsvReader()
+    {
+        if (next.valid())
+            next.wait();
+        if (file)
+            std::fclose(file);
+    }
+
+    bool open(const std::string &path);
+    // The next line that is not blank, without its line break. It stays
+    // valid until the next call.
+    bool line(std::string_view &out);
+};
+
+// Splits a CSV line at the commas outside of double quotes.
+void split(std::string_view line, std::vector<std::string_view> &fields)
+{
+    fields.clear();
+    size_t start = 0;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        if (line[i] == '"')
+            quoted = !quoted;
+        else if (line[i] == ',' && !quoted)
+        {
+            fields.push_back(line.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    fields.push_back(line.substr(start));
+}
+
+// Without surrounding blanks and quotes.
+std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"')
+        s = s.substr(1, s.size() - 2);
+    return s;
+}
+
+bool parse(std::string_view s, operand_t &v)
+{
+    s = trim(s);
+    if (!s.empty() && s.front() == '+')
+        s.remove_prefix(1);
+    eval::decimal_t d;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), d);
+    if (s.empty() || r.ec != std::errc() || r.ptr != s.data() + s.size())
+        return false;
+    v = toOperand(d);
+    return true;
+}
+
+bool CsvReader::open(const std::string &path)
+{
+    file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    readAhead();
+    std::string_view first;
+    if (!line(first))
+        return false;
+    headerLine = std::string(first);
+    std::vector<std::string_view> fields;
+    split(first, fields);
+    for (auto f : fields)
+        header.emplace_back(trim(f));
+    return true;
+}
+
+bool CsvReader::line(std::string_view &out)
+{
+    while (true)
+    {
+        size_t eol = buffer.find('\n', pos);
+        if (eol == std::string::npos)
+        {
+            if (!eof)
+            {
+                std::string block = next.get();
+                if (block.empty())
+                    eof = true;
+                else
+                    readAhead();
+                if (pos == buffer.size())
+                    buffer = std::move(block);
+                else
+                {
+                    buffer.erase(0, pos);
+                    buffer += block;
+                }
+                pos = 0;
+                continue;
+            }
+            if (pos == buffer.size())
+                return false;
+            eol = buffer.size(); // the last line has no line break
+        }
+        std::string_view s(buffer.data() + pos, eol - pos);
+        pos = std::min(eol + 1, buffer.size());
+        if (!s.empty() && s.back() == '\r')
+            s.remove_suffix(1);
+        if (trim(s).empty())
+            continue;
+        out = s;
+        return true;
+    }
+}
+
+// An expression made into a custom function of the columns it reads, under
+// a name no input can spell, so that Context::tryCall evaluates it a whole
+// chunk at a time. One that reads no column is evaluated row by row, as a
+// call cannot have no arguments.
+struct Map
+{
+    std::string name;
+    std::vector<size_t> columns; // argument i is column columns[i]
+    std::vector<const operand_t *> args;
+};
+
+bool isBinaryInput(const std::string &input, size_t &eq)
+{
+    eq = input.find('=');
+    if (eq == std::string::npos || eq == 0)
+        return false;
+    for (size_t i = 0; i < eq; ++i)
+    {
+        char c = input[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+              (i && c >= '0' && c <= '9')))
+            return false;
+    }
+    return true;
+}
+
+void writeField(eval::ResultWriter &writer, const operand_t &v,
+                const eval::FormatOptions &format)
+{
+    char buf[64];
+    if (char *end = eval::format(buf, buf + sizeof(buf), v, format))
+        writer.write(std::string_view(buf, end - buf));
+    else
+        writer.write(eval::toString(v, format));
+}
+
+// An expression as a CSV header field.
+std::string quote(const std::string &expression)
+{
+    std::string s = "\"";
+    for (char c : expression)
+    {
+        if (c == '"')
+            s += '"';
+        s += c;
+    }
+    return s + '"';
+}
+} // namespace
+
+int runPipeline(eval::Context &context, const PipelineOptions &options)
+{
+    // Columns of the CSV input first, then the binary ones.
+    std::unique_ptr<CsvReader> csv;
+    std::vector<std::unique_ptr<BinaryColumn>> binaries;
+    std::vector<std::string> names;
+    for (const auto &input : options.inputs)
+    {
+        size_t eq;
+        if (isBinaryInput(input, eq))
+        {
+            auto column = std::make_unique<BinaryColumn>();
+            std::string path = input.substr(eq + 1);
+            if (!column->open(path))
+            {
+                std::cerr << "failed to read column file " << path << '\n';
+                return 1;
+            }
+            if (!column->whole())
+            {
+                std::cerr << path << " is not a column of "
+                          << eval::binarySize << " byte values\n";
+                return 1;
+            }
+            column->name = input.substr(0, eq);
+            binaries.push_back(std::move(column));
+            continue;
+        }
+        if (csv)
+        {
+            std::cerr << "only one CSV input is supported\n";
+            return 1;
+        }
+        csv = std::make_unique<CsvReader>();
+        if (!csv->open(input))
+        {
+            std::cerr << "failed to read CSV file " << input << '\n';
+            return 1;
+        }
+    }
+    if (csv)
+        names = csv->header;
+    size_t csvColumns = names.size();
+    size_t rows = static_cast<size_t>(-1);
+    for (const auto &column : binaries)
+    {
+        names.push_back(column->name);
+        rows = std::min(rows, column->rows());
+    }
+    if (!csv && binaries.empty())
+    {
+        std::cerr << "no input to map over\n";
+        return 1;
+    }
+
+    // Later columns of the same name shadow earlier ones.
+    auto columnOf = [&names](const std::string &symbol)
+    {
+        for (size_t c = names.size(); c-- > 0;)
+            if (names[c] == symbol)
+                return c;
+        return names.size();
+    };
+    std::vector<char> used(names.size());
+    std::vector<Map> maps;
+    for (const auto &expression : options.expressions)
+    {
+        auto tkl = eval::TokenList::tryParse(expression);
+        if (!tkl)
+        {
+            std::cerr << "--map " << expression << ": "
+                      << eval::EVAL_EXCEPTION_MSG[tkl.error] << '\n';
+            return 1;
+        }
+        Map m;
+        m.name = "#map" + std::to_string(maps.size());
+        eval::Function f(tkl.value.begin(), tkl.value.end());
+        // The column every token reads, names.size() for none.
+        std::vector<size_t> columnAt(f.tkList.size(), names.size());
+        for (auto ite = f.tkList.begin(); ite != f.tkList.end(); ++ite)
+        {
+            if (!ite->isSymbol() || !eval::Context::isVar(ite, f.tkList.end()))
+                continue;
+            size_t c = columnOf(ite->getSymbol());
+            columnAt[ite - f.tkList.begin()] = c;
+            if (c == names.size() || std::count(m.columns.begin(),
+                                                m.columns.end(), c))
+                continue;
+            m.columns.push_back(c);
+            used[c] = true;
+        }
+        if (m.columns.empty())
+        {
+            maps.push_back(std::move(m));
+            continue;
+        }
+        std::vector<size_t> parameterOf(f.tkList.size(), m.columns.size());
+        for (size_t k = 0; k < f.tkList.size(); ++k)
+            if (columnAt[k] != names.size())
+                parameterOf[k] = std::find(m.columns.begin(), m.columns.end(),
+                                           columnAt[k]) -
+                                 m.columns.begin();
+        f.parameterTable.assign(m.columns.size(), parameterOf);
+        context.funcTable[m.name] = std::move(f);
+        context.touch(m.name);
+        maps.push_back(std::move(m));
+    }
+
+    // Every column a chunk reads, and every result, fits in chunkBytes.
+    size_t width = maps.size() * sizeof(eval::Expected<operand_t>);
+    for (size_t c = 0; c < names.size(); ++c)
+        width += used[c] ? sizeof(operand_t) : 0;
+    size_t chunk = std::clamp(options.chunkBytes / width, size_t(64),
+                              size_t(1) << 16);
+    std::vector<std::vector<operand_t>> values(names.size());
+    for (size_t c = 0; c < names.size(); ++c)
+        if (used[c])
+            values[c].resize(chunk);
+    for (auto &m : maps)
+        for (size_t c : m.columns)
+            m.args.push_back(values[c].data());
+    std::vector<std::vector<eval::Expected<operand_t>>> results(
+        maps.size(), std::vector<eval::Expected<operand_t>>(chunk));
+
+    std::FILE *file = stdout;
+    if (!options.output.empty() &&
+        !(file = std::fopen(options.output.c_str(), "wb")))
+    {
+        std::cerr << "failed to write to file " << options.output << '\n';
+        return 1;
+    }
+    bool written;
+    size_t row = 0, failures = 0, firstFailure = 0;
+    eval::Expected<operand_t> firstError;
+    {
+        eval::ResultWriter writer(file,
+                                  options.binary
+                                      ? eval::ResultWriter::Mode::BINARY
+                                      : eval::ResultWriter::Mode::TEXT,
+                                  options.format);
+        if (!options.binary)
+        {
+            if (csv)
+                writer.write(csv->headerLine);
+            for (size_t k = 0; k < maps.size(); ++k)
+            {
+                if (csv || k)
+                    writer.write(",");
+                writer.write(quote(options.expressions[k]));
+            }
+            writer.write("\n");
+        }
+
+        // The lines of a chunk, echoed in front of their results, and the
+        // rows whose fields did not parse, or are more or fewer than the
+        // header's.
+        std::string lines;
+        std::vector<size_t> lineEnds;
+        std::vector<char> bad(chunk);
+        std::vector<std::string_view> fields;
+        while (row < rows)
+        {
+            if (context.cancellation && context.cancellation->cancelled())
+            {
+                std::cerr << "cancelled after " << row << " rows\n";
+                break;
+            }
+            size_t n = 0;
+            lines.clear();
+            lineEnds.clear();
+            while (n < chunk && row + n < rows)
+            {
+                if (csv)
+                {
+                    std::string_view l;
+                    if (!csv->line(l))
+                        break;
+                    split(l, fields);
+                    bad[n] = fields.size() != csvColumns;
+                    for (size_t c = 0; c < csvColumns && !bad[n]; ++c)
+                        if (used[c] && !parse(fields[c], values[c][n]))
+                            bad[n] = true;
+                    if (!options.binary)
+                    {
+                        lines.append(l.data(), l.size());
+                        lineEnds.push_back(lines.size());
+                    }
+                }
+                else
+                    bad[n] = false;
+                ++n;
+            }
+            if (!n)
+                break;
+            for (size_t b = 0; b < binaries.size(); ++b)
+                if (used[csvColumns + b])
+                    binaries[b]->read(row, n, values[csvColumns + b].data());
+            for (size_t k = 0; k < maps.size(); ++k)
+            {
+                if (maps[k].columns.empty())
+                    for (size_t i = 0; i < n; ++i)
+                        results[k][i] = context.tryEval(options.expressions[k]);
+                else
+                    context.tryCall(maps[k].name, maps[k].args.data(),
+                                    maps[k].args.size(), n, results[k].data());
+            }
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (!options.binary && csv)
+                    writer.write(std::string_view(lines).substr(
+                        i ? lineEnds[i - 1] : 0,
+                        lineEnds[i] - (i ? lineEnds[i - 1] : 0)));
+                for (size_t k = 0; k < maps.size(); ++k)
+                {
+                    auto &r = results[k][i];
+                    if (bad[i])
+                        r = eval::Expected<operand_t>::failure(
+                            eval::EVAL_PARSE_FAILED);
+                    if (!r && !failures++)
+                    {
+                        firstFailure = row + i;
+                        firstError = r;
+                    }
+                    if (options.binary)
+                    {
+                        writer.write(r ? r.value : missing);
+                        continue;
+                    }
+                    if (csv || k)
+                        writer.write(",");
+                    if (r)
+                        writeField(writer, r.value, options.format);
+                }
+                if (!options.binary)
+                    writer.write("\n");
+            }
+            row += n;
+        }
+        written = writer.flush();
+    }
+    if (file != stdout)
+        written = std::fclose(file) == 0 && written;
+    else
+        written = std::fflush(file) == 0 && written;
+    for (const auto &m : maps)
+    {
+        if (m.columns.empty())
+            continue;
+        context.funcTable.erase(m.name);
+        context.touch(m.name);
+    }
+
+    if (!written)
+        std::cerr << "failed to write the results\n";
+    if (failures)
+        std::cerr << failures << " results failed, the first one in row "
+                  << firstFailure + 1 << ": "
+                  << eval::EVAL_EXCEPTION_MSG[firstError.error] << '\n';
+    return written && !failures ? 0 : 1;
+}
\ No newline at end of file
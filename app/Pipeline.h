@@ -0,0 +1,36 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <string>
+#include <vector>
+
+#include <evaluator/Context.h>
+#include <evaluator/Format.h>
+
+// Evaluates expressions over every row of data files. The columns are bound
+// to the variables of the same name, rows are read in chunks a few columns
+// of which fit in cache, and each expression runs once per chunk through
+// Context::tryCall, compiled as soon as it is hot.
+struct PipelineOptions
+{
+    std::vector<std::string> expressions;
+    // "PATH" for a CSV file whose first line names the columns, at most one,
+    // or "NAME=PATH" for a column of raw little endian doubles, as written
+    // by !dump. Columns of different inputs are paired by row, up to the
+    // shortest.
+    std::vector<std::string> inputs;
+    // Standard output when empty.
+    std::string output;
+    // Results as raw little endian doubles, the values of one row back to
+    // back. As text, CSV rows get the results appended as new columns and
+    // other rows are the results alone.
+    bool binary = false;
+    eval::FormatOptions format;
+    // Scratch space of a chunk: its columns and results.
+    size_t chunkBytes = size_t(1) << 18;
+};
+
+// Returns the exit status of the app.
+int runPipeline(eval::Context &context, const PipelineOptions &options);
+
+#endif
\ No newline at end of file
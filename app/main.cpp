@@ -1,110 +1,355 @@
-#include <fstream>
-#include <iostream>
-
-#include <evaluator/Context.h>
-std::unordered_map<std::string, std::function<void(eval::Context &)>>
-    commandTable{{"exit", [](eval::Context &)
-                  { exit(0); }},
-                 {"math", [](eval::Context &context)
-                  { context.importMath(); }},
-                 {"list",
-                  [](eval::Context &context)
-                  {
-                      std::cout << " - Variables:\n";
-                      for (const auto &p : context.varTable)
-                          std::cout << '\t' << p.first << " = " << p.second
-                                    << '\n';
-                      std::cout << " - Functions:\n";
-                      std::cout << '\t';
-                      for (const auto &p : context.funcTable)
-                          std::cout << p.first << ", ";
-                      std::cout << '\n';
-                  }}
-
-    };
-
-void process(const std::string &input, eval::Context &context,
-             std::vector<std::string> &record)
-{
-    if (input.empty())
-        return;
-    if (input[0] == '!')
-    {
-        auto cmd = input.substr(1);
-        while (cmd.back() == ' ' || cmd.back() == '\n' || cmd.back() == '\t' ||
-               cmd.back() == '\r')
-            cmd.pop_back();
-        if (cmd.substr(0, 4) == "save")
-        {
-            std::string path = cmd.substr(5);
-            std::ofstream os(path);
-            if (!os)
-            {
-                std::cout << "failed to save to file " << path << '\n';
-                return;
-            }
-            for (const auto &s : record)
-                os << s << '\n';
-            std::cout << "saved to " << path << '\n';
-            os.close();
-            return;
-        }
-        auto ite = commandTable.find(cmd);
-        if (ite != commandTable.end())
-        {
-            (ite->second)(context);
-            record.push_back(input);
-        }
-        else
-            std::cout << "unknown command\n";
-    }
-    else
-    {
-        try
-        {
-            record.push_back(input);
-            auto ret = context.exec(input);
-            if (ret.first == eval::ExprType::EXPR)
-                std::cout << " = " << ret.second << '\n';
-        }
-        catch (const std::exception &e)
-        {
-            std::cerr << e.what() << std::endl;
-            record.pop_back();
-        }
-    }
-}
-
-int main(int argc, char *argv[])
-{
-    eval::Context context;
-    std::vector<std::string> record;
-    std::cout << std::fixed;
-    if (argc == 2)
-    {
-        std::string path(argv[1]);
-        std::ifstream is(path);
-        if (!is)
-        {
-            std::cout << "failed to load file " << path << '\n';
-            return 0;
-        }
-        while (!is.eof())
-        {
-            std::string input;
-            std::getline(is, input);
-            std::cout << "eval> " << input << '\n';
-            process(input, context, record);
-        }
-        is.close();
-    }
-
-    while (true)
-    {
-        std::cout << "eval> ";
-        std::string input;
-        std::getline(std::cin, input);
-        process(input, context, record);
-    }
-    return 0;
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include <evaluator/Context.h>
+#include <evaluator/Format.h>
+
+#include "Pipeline.h"
+
+eval::CancellationToken *interruptToken = nullptr;
+std::atomic<bool> evaluating{false};
+
+// Shortest round-trip digits unless set with !precision.
+eval::FormatOptions output;
+
+// Ctrl-C stops the running evaluation, and quits at the prompt as before.
+void onInterrupt(int)
+{
+    if (!evaluating.load())
+    {
+        std::signal(SIGINT, SIG_DFL);
+        std::raise(SIGINT);
+        return;
+    }
+    interruptToken->cancel();
+    std::signal(SIGINT, onInterrupt);
+}
+
+std::unordered_map<std::string, std::function<void(eval::Context &)>>
+    commandTable{{"exit", [](eval::Context &)
+                  { exit(0); }},
+                 {"math", [](eval::Context &context)
+                  { context.importMath(); }},
+                 {"strict",
+                  [](eval::Context &context)
+                  {
+                      context.strictMath = !context.strictMath;
+                      std::cout << "strict math "
+                                << (context.strictMath ? "on" : "off") << '\n';
+                  }},
+                 {"parallel",
+                  [](eval::Context &context)
+                  {
+                      context.parallel.enabled = !context.parallel.enabled;
+                      std::cout << "parallel evaluation "
+                                << (context.parallel.enabled ? "on" : "off")
+                                << '\n';
+                  }},
+                 {"list",
+                  [](eval::Context &context)
+                  {
+                      std::cout << " - Variables:\n";
+                      for (const auto &p : context.varTable)
+                          std::cout << '\t' << p.first << " = " << p.second
+                                    << '\n';
+                      for (const auto &p : context.arrayTable)
+                          std::cout << '\t' << p.first << " = ["
+                                    << p.second.size() << " elements]\n";
+                      std::cout << " - Functions:\n";
+                      std::cout << '\t';
+                      for (const auto &p : context.funcTable)
+                          std::cout << p.first << ", ";
+                      std::cout << '\n';
+                      if (!context.builtins)
+                          return;
+                      std::cout << " - Builtins:\n";
+                      std::cout << '\t';
+                      for (const auto &name : context.builtins->varNames())
+                          std::cout << name << ", ";
+                      for (const auto &name : context.builtins->funcNames())
+                          std::cout << name << ", ";
+                      for (const auto &name :
+                           context.builtins->arrayFuncNames())
+                          std::cout << name << ", ";
+                      std::cout << '\n';
+                  }},
+                 {"memory",
+                  [](eval::Context &context)
+                  {
+                      auto u = context.memoryUsage();
+                      std::cout << "\tvariables " << u.variables
+                                << "\n\tarrays " << u.arrays
+                                << "\n\tfunctions " << u.functions
+                                << "\n\tarray functions " << u.arrayFunctions
+                                << "\n\tcache " << u.cache << "\n\ttiers "
+                                << u.tiers << "\n\tversions " << u.versions
+                                << "\n\ttotal " << u.total() << " bytes\n";
+                  }},
+                 {"tiers",
+                  [](eval::Context &context)
+                  {
+                      for (const auto &p : context.tierProfile())
+                          std::cout << '\t' << p.first << ": " << p.second.runs
+                                    << " runs, " << p.second.compiledRuns
+                                    << " compiled"
+                                    << (p.second.promoted ? "" : ", cold")
+                                    << ", " << p.second.deoptimizations
+                                    << " deoptimizations, " << p.second.nodes
+                                    << " nodes, " << p.second.deduplicated
+                                    << " shared\n";
+                  }}
+
+    };
+
+void printArray(const eval::Array &a)
+{
+    constexpr size_t shown = 10;
+    std::cout << " = [";
+    for (size_t i = 0; i < a.size() && i < shown; ++i)
+        std::cout << (i ? ", " : "") << eval::toString(a[i], output);
+    if (a.size() > shown)
+        std::cout << ", ... (" << a.size() << " elements)";
+    std::cout << "]\n";
+}
+
+void process(const std::string &input, eval::Context &context,
+             std::vector<std::string> &record)
+{
+    if (input.empty())
+        return;
+    if (input[0] == '!')
+    {
+        auto cmd = input.substr(1);
+        while (cmd.back() == ' ' || cmd.back() == '\n' || cmd.back() == '\t' ||
+               cmd.back() == '\r')
+            cmd.pop_back();
+        if (cmd.substr(0, 9) == "precision")
+        {
+            // "!precision 10" for 10 decimals, "!precision" for the
+            // shortest digits that read back to the same value.
+            if (cmd.size() > 10)
+            {
+                output.style = eval::FloatStyle::FIXED;
+                output.precision = std::atoi(cmd.c_str() + 10);
+            }
+            else
+                output.style = eval::FloatStyle::SHORTEST;
+            record.push_back(input);
+            return;
+        }
+        if (cmd.substr(0, 4) == "dump")
+        {
+            // The last array result as raw little endian doubles.
+            std::string path = cmd.substr(5);
+            auto ite = context.arrayTable.find("ANS");
+            std::FILE *file = std::fopen(path.c_str(), "wb");
+            if (!file || ite == context.arrayTable.end())
+            {
+                std::cout << "failed to dump to file " << path << '\n';
+                if (file)
+                    std::fclose(file);
+                return;
+            }
+            bool written;
+            {
+                eval::ResultWriter writer(file,
+                                          eval::ResultWriter::Mode::BINARY);
+                writer.write(ite->second.data(), ite->second.size());
+                written = writer.flush();
+            }
+            written = std::fclose(file) == 0 && written;
+            std::cout << (written ? "dumped " : "failed to dump ")
+                      << ite->second.size() << " values to " << path << '\n';
+            return;
+        }
+        if (cmd.substr(0, 4) == "save")
+        {
+            std::string path = cmd.substr(5);
+            std::ofstream os(path);
+            if (!os)
+            {
+                std::cout << "failed to save to file " << path << '\n';
+                return;
+            }
+            for (const auto &s : record)
+                os << s << '\n';
+            std::cout << "saved to " << path << '\n';
+            os.close();
+            return;
+        }
+        auto ite = commandTable.find(cmd);
+        if (ite != commandTable.end())
+        {
+            (ite->second)(context);
+            record.push_back(input);
+        }
+        else
+            std::cout << "unknown command\n";
+    }
+    else
+    {
+        try
+        {
+            record.push_back(input);
+            context.cancellation->reset();
+            evaluating = true;
+            auto ret = context.exec(input);
+            evaluating = false;
+            if (ret.first == eval::ExprType::EXPR)
+                std::cout << " = " << eval::toString(ret.second, output)
+                          << '\n';
+            else if (ret.first == eval::ExprType::ARRAY)
+                printArray(context.arrayTable["ANS"]);
+        }
+        catch (const eval::EvalException &e)
+        {
+            evaluating = false;
+            std::cerr << e.what();
+            if (e.code >= eval::EVAL_OPERATION_LIMIT &&
+                e.code <= eval::EVAL_CANCELLED)
+                std::cerr << " after " << context.stats.operations
+                          << " operations, " << context.stats.calls
+                          << " calls, "
+                          << std::chrono::duration_cast<
+                                 std::chrono::milliseconds>(
+                                 context.stats.elapsed)
+                                 .count()
+                          << " ms";
+            std::cerr << std::endl;
+            record.pop_back();
+        }
+        catch (const std::exception &e)
+        {
+            evaluating = false;
+            std::cerr << e.what() << std::endl;
+            record.pop_back();
+        }
+    }
+}
+
+// Runs the definitions of a file ahead of a pipeline, which owns standard
+// output, so only errors are reported.
+bool define(const std::string &path, eval::Context &context)
+{
+    std::ifstream is(path);
+    if (!is)
+    {
+        std::cerr << "failed to load file " << path << '\n';
+        return false;
+    }
+    std::string input;
+    for (size_t line = 1; std::getline(is, input); ++line)
+    {
+        while (!input.empty() && (input.back() == '\r' || input.back() == ' '))
+            input.pop_back();
+        if (input.empty())
+            continue;
+        if (input[0] == '!')
+        {
+            auto ite = commandTable.find(input.substr(1));
+            if (ite != commandTable.end() && ite->first != "exit")
+                (ite->second)(context);
+            continue;
+        }
+        auto r = context.tryExec(input);
+        if (!r)
+        {
+            std::cerr << path << ':' << line << ": "
+                      << eval::EVAL_EXCEPTION_MSG[r.error] << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+const char usage[] =
+    "usage: eval [FILE]\n"
+    "       eval [FILE] --map EXPR... --input PATH|NAME=PATH... [--output "
+    "PATH] [--binary] [--precision N] [--math]\n";
+
+int main(int argc, char *argv[])
+{
+    eval::Context context;
+    context.cancellation = std::make_shared<eval::CancellationToken>();
+    interruptToken = context.cancellation.get();
+    std::signal(SIGINT, onInterrupt);
+    std::vector<std::string> record;
+
+    std::string path;
+    PipelineOptions pipeline;
+    bool math = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "--map" && hasValue)
+            pipeline.expressions.push_back(argv[++i]);
+        else if (arg == "--input" && hasValue)
+            pipeline.inputs.push_back(argv[++i]);
+        else if (arg == "--output" && hasValue)
+            pipeline.output = argv[++i];
+        else if (arg == "--binary")
+            pipeline.binary = true;
+        else if (arg == "--precision" && hasValue)
+        {
+            output.style = eval::FloatStyle::FIXED;
+            output.precision = std::atoi(argv[++i]);
+        }
+        else if (arg == "--math")
+            math = true;
+        else if (arg[0] != '-' && path.empty())
+            path = arg;
+        else
+        {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+    if (math)
+        context.importMath();
+
+    if (!pipeline.expressions.empty() || !pipeline.inputs.empty())
+    {
+        if (pipeline.expressions.empty() || pipeline.inputs.empty())
+        {
+            std::cerr << usage;
+            return 1;
+        }
+        if (!path.empty() && !define(path, context))
+            return 1;
+        pipeline.format = output;
+        evaluating = true;
+        return runPipeline(context, pipeline);
+    }
+
+    if (!path.empty())
+    {
+        std::ifstream is(path);
+        if (!is)
+        {
+            std::cout << "failed to load file " << path << '\n';
+            return 0;
+        }
+        while (!is.eof())
+        {
+            std::string input;
+            std::getline(is, input);
+            std::cout << "eval> " << input << '\n';
+            process(input, context, record);
+        }
+        is.close();
+    }
+
+    while (true)
+    {
+        std::cout << "eval> ";
+        std::string input;
+        std::getline(std::cin, input);
+        process(input, context, record);
+    }
+    return 0;
 }
\ No newline at end of file
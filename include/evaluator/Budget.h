@@ -0,0 +1,85 @@
+#ifndef BUDGET_H_
+#define BUDGET_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace eval
+{
+// Limits for a single exec, zero meaning unlimited. Checked at function
+// calls and at every iteration of SUM and MUL.
+struct Budget
+{
+    uint64_t maxOperations = 0;  // evaluated (sub)expressions
+    std::chrono::milliseconds timeout{0};
+    size_t maxMemory = 0;  // bytes of evaluation state, see ExecStats
+};
+
+// Limits on the definitions a context keeps between execs, zero meaning
+// unlimited. Only the variables, arrays and functions of its own layer
+// count, not those of the context it was forked from, and ANS only counts
+// towards the bytes.
+struct Quota
+{
+    size_t maxDefinitions = 0;
+    size_t maxDefinitionBytes = 0;  // see MemoryUsage::definitions
+};
+
+// Estimated bytes a context holds, by component: hash table nodes and
+// buckets, names, token lists, parameter tables and array elements. The
+// shared builtins and whatever host std::functions capture are not counted.
+struct MemoryUsage
+{
+    size_t variables = 0;
+    size_t arrays = 0;
+    size_t functions = 0;  // names, bodies and parameter tables
+    size_t arrayFunctions = 0;
+    size_t cache = 0;       // result cache entries
+    size_t tiers = 0;       // profiles and compiled code
+    size_t versions = 0;    // symbol versions of the cache and the tiers
+    size_t evaluation = 0;  // scratch held by a running exec
+
+    size_t definitions() const
+    {
+        return variables + arrays + functions + arrayFunctions;
+    }
+    size_t total() const
+    {
+        return definitions() + cache + tiers + versions + evaluation;
+    }
+};
+
+// What the last exec did, also when it stopped on an error.
+struct ExecStats
+{
+    uint64_t operations = 0;
+    uint64_t calls = 0;
+    // Peak size of the token lists, argument lists and batch buffers the
+    // evaluation held at once.
+    size_t peakMemory = 0;
+    std::chrono::nanoseconds elapsed{0};
+    // Terms used by the last SERIES or PRODUCT to converge.
+    uint64_t seriesTerms = 0;
+    // Operands evaluated as parallel tasks, see ParallelPolicy.
+    uint64_t tasks = 0;
+};
+
+// Lets another thread, or a signal handler, stop a running exec.
+class CancellationToken
+{
+   protected:
+    std::atomic<bool> requested{false};
+
+   public:
+    void cancel() noexcept { requested.store(true, std::memory_order_relaxed); }
+    void reset() noexcept { requested.store(false, std::memory_order_relaxed); }
+    bool cancelled() const noexcept
+    {
+        return requested.load(std::memory_order_relaxed);
+    }
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef BUILTINS_H_
+#define BUILTINS_H_
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <evaluator/EvaluatorDefs.h>
+#include <evaluator/Function.h>
+
+namespace eval
+{
+using Array = std::vector<operand_t>;
+// Builds or reduces arrays. Every argument is an array, scalars being arrays
+// of one element, and array variables are passed without a copy. Errors are
+// reported through Context::raise.
+using ArrayFunction = std::function<Array(
+    const std::vector<const Array*>& args, Context& context)>;
+
+// The constants and functions of importMath, built once per process and
+// never changed afterwards, so every context and every thread shares them.
+// Names are found through a perfect hash computed at compile time.
+class Builtins
+{
+   public:
+    static const Builtins& math();
+
+    // nullptr when name is not a builtin of that kind.
+    const operand_t* findVar(const std::string& name) const;
+    const Function* findFunc(const std::string& name) const;
+    const ArrayFunction* findArrayFunc(const std::string& name) const;
+
+    const std::vector<std::string>& varNames() const { return vars; }
+    const std::vector<std::string>& funcNames() const { return funcs; }
+    const std::vector<std::string>& arrayFuncNames() const
+    {
+        return arrayFuncs;
+    }
+
+   private:
+    struct Entry
+    {
+        bool hasVar = false, hasFunc = false, hasArrayFunc = false;
+        operand_t var = operand_zero;
+        Function func;
+        ArrayFunction arrayFunc;
+    };
+    // By index in the name list of Builtins.cpp.
+    std::vector<Entry> entries;
+    std::vector<std::string> vars, funcs, arrayFuncs;
+
+    const Entry* find(const std::string& name) const;
+
+    Builtins(std::unordered_map<std::string, operand_t> varTable,
+             std::unordered_map<std::string, Function> funcTable,
+             std::unordered_map<std::string, ArrayFunction> arrayFuncTable);
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
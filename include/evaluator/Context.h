@@ -1,58 +1,316 @@
-#ifndef CONTEXT_H_
-#define CONTEXT_H_
-
-#include <unordered_map>
-#include <utility>
-
-#include <evaluator/EvaluatorDefs.h>
-#include <evaluator/Function.h>
-namespace eval
-{
-enum class ExprType
-{
-    EXPR,
-    VAR_ASSIGN,
-    FUNC_DEF
-};
-
-class Context
-{
-   protected:
-    unsigned int depth;
-
-   public:
-    std::unordered_map<std::string, operand_t> varTable;
-    std::unordered_map<std::string, Function> funcTable;
-
-    static inline bool isVar(const TokenList::const_iterator& ite,
-                             const TokenList::const_iterator& end)
-    {
-        return ite + 1 == end || (ite + 1)->type != TokenType::LPAREN;
-    }
-
-    static inline bool isNeg(const TokenList::const_iterator& beg,
-                             const TokenList::const_iterator& ite)
-    {
-        if (ite->type != TokenType::SUB) return false;
-        if (ite == beg) return true;
-        auto pre = ite - 1;
-        return (!pre->isOperand()) && (!pre->isSymbol()) &&
-               (pre->type != TokenType::RPAREN);
-    }
-
-    operand_t evalExpr(const TokenList::const_iterator& beg,
-                       const TokenList::const_iterator& end);
-
-    bool DefFunc(const TokenList& tkl);
-
-   public:
-    Context();
-    void importMath();
-
-    std::pair<ExprType, operand_t> exec(const std::string& input);
-
-    virtual ~Context() {}
-};
-}  // namespace eval
-
+#ifndef CONTEXT_H_
+#define CONTEXT_H_
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <evaluator/Budget.h>
+#include <evaluator/Builtins.h>
+#include <evaluator/EvaluatorDefs.h>
+#include <evaluator/Function.h>
+#include <evaluator/Parallel.h>
+#include <evaluator/Polynomial.h>
+#include <evaluator/Random.h>
+#include <evaluator/ResultCache.h>
+#include <evaluator/Tiering.h>
+namespace eval
+{
+enum class ExprType
+{
+    EXPR,
+    VAR_ASSIGN,
+    FUNC_DEF,
+    ARRAY  // an expression with an array value, left in arrayTable["ANS"]
+};
+
+class Context
+{
+   protected:
+    unsigned int depth;
+
+    // The context a fork reads through to. Its tables are not copied, so it
+    // must outlive the fork and not change while the fork evaluates.
+    const Context* parent;
+    explicit Context(const Context* parent);
+
+    // Error bookkeeping of the non-throwing path: the input being executed,
+    // how many function bodies deep the evaluation is (positions are only
+    // known outside of them), and the error raised by a definition.
+    const TokenList* input;
+    unsigned int foreign;
+    bool raised;
+    EVAL_EXCEPTION raisedError;
+
+    // Budget bookkeeping of the running exec.
+    std::chrono::steady_clock::time_point started, deadline;
+    unsigned int clockTick;
+    size_t memory;
+
+    void begin(const TokenList* tkl);
+    void end();
+
+    std::unordered_map<std::string, uint64_t> versions;
+    uint64_t lastVersion;
+
+    // Running totals of the definitions in the tables, see Quota.
+    mutable size_t definitionCount, definitionBytes;
+    // Accounts for name becoming the function f when given, else the array
+    // a when given, else a variable, replacing what it was in this layer.
+    // Fails without changing anything when that would break the quota.
+    Expected<bool> reserve(const std::string& name, const Function* f,
+                           const Array* a = nullptr);
+
+    TierTable tiers;
+    // Compiles the entry once it has run threshold times since it was last
+    // made cold, and drops its code when a function it reaches changed.
+    void promote(TierTable::Entry& entry, uint64_t threshold,
+                 const std::function<bool(Expr&)>& compile);
+    // Counts calls of the custom function name, promoting it once it is
+    // hot.
+    TierTable::Entry& countCalls(const std::string& name, const Function& f,
+                                 uint64_t calls);
+
+    bool dependencies(const TokenList& tkl,
+                      ResultCache::Dependencies& deps) const;
+
+    // Expression depth from which operands are no longer spawned as tasks,
+    // moved by the sizes of the tasks, see ParallelPolicy.
+    unsigned int spawnDepth;
+    // The nearest layer with definitions of its own, which tasks fork from
+    // so that their lookups skip the empty ones.
+    const Context* definingLayer() const;
+    // Whether [beg, end) can not reach an impure function and calls a
+    // custom or high order one.
+    bool worthTask(const TokenList::const_iterator& beg,
+                   const TokenList::const_iterator& end) const;
+
+    Expected<std::pair<ExprType, operand_t>> execTokens(const TokenList& tkl);
+    // The operator [beg, end) applies last: end when there is none, beg
+    // for a minus negating everything after it.
+    Expected<TokenList::const_iterator> splitOperation(
+        const TokenList::const_iterator& beg,
+        const TokenList::const_iterator& end) const;
+    Expected<operand_t> evalOperation(const TokenList::const_iterator& beg,
+                                      const TokenList::const_iterator& end);
+    Expected<Array> evalArrayOperation(const TokenList::const_iterator& beg,
+                                       const TokenList::const_iterator& end);
+    // Whether [beg, end) names an array variable or a function that only
+    // exists for arrays, so that it needs tryEvalArray.
+    bool involvesArrays(const TokenList::const_iterator& beg,
+                        const TokenList::const_iterator& end) const;
+    Expected<bool> tryDefFunc(const TokenList& tkl);
+
+    friend class Builtins;
+    // Writes the library into the tables of a scratch context, from which
+    // Builtins::math takes it once.
+    void defineMath();
+    // ROOT, MINIMIZE, INTEGRATE and LIMIT, see Solvers.cpp.
+    void importSolvers();
+    // Array constructors and reductions, see Array.cpp.
+    void importArrays();
+
+   public:
+    // The definitions made in this context. A fork starts with empty tables
+    // and looks up whatever they lack in its parent.
+    std::unordered_map<std::string, operand_t> varTable;
+    std::unordered_map<std::string, Function> funcTable;
+
+    // Array variables, kept apart from varTable, and the functions that
+    // build or reduce arrays. Arithmetic and ORDINARY functions apply to
+    // arrays element by element, broadcasting scalars.
+    std::unordered_map<std::string, Array> arrayTable;
+    std::unordered_map<std::string, ArrayFunction> arrayFuncTable;
+
+    // The importMath library, shared by every context that imported it. It
+    // is looked up after the tables of every layer, so definitions shadow it.
+    const Builtins* builtins;
+
+    // Lookups through every layer and then the builtins, nullptr when the
+    // symbol is undefined.
+    const operand_t* findVar(const std::string& name) const;
+    const Function* findFunc(const std::string& name) const;
+    const Array* findArray(const std::string& name) const;
+    const ArrayFunction* findArrayFunc(const std::string& name) const;
+
+    // SUM and MUL evaluate their bodies in batches, where sin, cos, exp, ln,
+    // lg, erf, gamma, atan and ^ run through the double precision SIMD
+    // kernels of MathKernels.h. Strict math keeps every call on the long
+    // double libm functions the interpreter uses.
+    bool strictMath;
+
+    // Source of rand. Every context starts on a stream of its own, and a
+    // fork on the next stream split off its parent, so seeding the root
+    // with random.reseed makes a whole tree of forks reproducible.
+    Random random;
+
+    Budget budget;
+    // Optional, checked together with the budget.
+    std::shared_ptr<CancellationToken> cancellation;
+    ExecStats stats;
+    // Checked whenever exec stores a variable, an array or a function.
+    Quota quota;
+    // What this context holds, its own layer only. Also resets the running
+    // totals the quota is checked against, for hosts that write the tables
+    // directly.
+    MemoryUsage memoryUsage() const;
+
+    // Cheap enough for loop back-edges: the clock is read every 256th call.
+    bool overBudget(EVAL_EXCEPTION& code);
+    // Accounts for evaluation state held by function calls and loops.
+    void allocate(size_t bytes);
+    void release(size_t bytes) { memory -= bytes; }
+
+    // Results of expressions, keyed by their token stream, so whitespace and
+    // the spelling of literals do not matter. Off until given a capacity.
+    // Entries depend on the versions of the symbols they can read, which
+    // exec updates; hosts that write varTable or funcTable directly call
+    // touch. importMath only defines names that were undefined. Expressions
+    // that can reach an impure function are never cached.
+    ResultCache cache;
+    void touch(const std::string& name)
+    {
+        versions[name] = lastVersion = nextVersion();
+    }
+    uint64_t version(const std::string& name) const;
+    // Versions come from one counter for the whole process, so a fork and
+    // its parent never give out the same one.
+    static uint64_t nextVersion();
+    // The token stream of tkl, with operands in full precision, as the
+    // key of the result cache and of the tier table.
+    static std::string normalize(const TokenList& tkl);
+    // Whether evaluating tkl can not reach an impure function, so equal
+    // inputs give equal results as long as no symbol changes.
+    bool deterministic(const TokenList& tkl) const
+    {
+        ResultCache::Dependencies deps;
+        return dependencies(tkl, deps);
+    }
+
+    static inline bool isVar(const TokenList::const_iterator& ite,
+                             const TokenList::const_iterator& end)
+    {
+        return ite + 1 == end || (ite + 1)->type != TokenType::LPAREN;
+    }
+
+    static inline bool isNeg(const TokenList::const_iterator& beg,
+                             const TokenList::const_iterator& ite)
+    {
+        if (ite->type != TokenType::SUB) return false;
+        if (ite == beg) return true;
+        auto pre = ite - 1;
+        return (!pre->isOperand()) && (!pre->isSymbol()) &&
+               (pre->type != TokenType::RPAREN);
+    }
+
+    operand_t evalExpr(const TokenList::const_iterator& beg,
+                       const TokenList::const_iterator& end);
+
+    bool DefFunc(const TokenList& tkl);
+
+    // Evaluates an expression whose value may be an array.
+    Expected<Array> tryEvalArray(const TokenList::const_iterator& beg,
+                                 const TokenList::const_iterator& end);
+
+    // Non-throwing counterpart of evalExpr.
+    Expected<operand_t> tryEvalExpr(const TokenList::const_iterator& beg,
+                                    const TokenList::const_iterator& end);
+    // Evaluates a token list that is not part of the input, such as the body
+    // of a custom function.
+    Expected<operand_t> tryEvalBody(const TokenList::const_iterator& beg,
+                                    const TokenList::const_iterator& end);
+    // Runs the definition of an ORDINARY or HIGH_ORDER function.
+    Expected<operand_t> call(const Function& f, const TokenList& args);
+
+    // Fork-join evaluation, see Parallel.h.
+    ParallelPolicy parallel;
+    using Range =
+        std::pair<TokenList::const_iterator, TokenList::const_iterator>;
+    // Evaluates the n ranges, those worth a task at once, out[i] being the
+    // result of range i. False, having evaluated none of them, when fewer
+    // than two are worth a task or no thread of the pool is idle.
+    bool tryEvalParallel(const Range* ranges, size_t n,
+                         Expected<operand_t>* out);
+
+    // Promotion thresholds of tiered execution, see Tiering.h.
+    TieringPolicy tiering;
+    // What tiering did for every custom function, by name, and every loop
+    // body, by its tokens.
+    std::vector<std::pair<std::string, TierProfile>> tierProfile() const;
+    // Counts a call of the custom function name and, once it is hot, runs
+    // it compiled. False when the interpreter has to run it.
+    bool tieredCall(const std::string& name, const Function& f,
+                    const TokenList& args, operand_t& value);
+    // Same for n calls at once, argument i of call j being args[i][j].
+    bool tieredCall(const std::string& name, const Function& f,
+                    const operand_t* const* args, operand_t* out, size_t n);
+    // Counts n evaluations of a loop body, whose key is normalize(body),
+    // and returns its compiled form once it is hot, nullptr until then.
+    // Clears key when the tier table has no room for another body; the
+    // body is then compiled at once, as if tiering were off.
+    std::shared_ptr<Expr> tieredLoop(std::string& key, const TokenList& body,
+                                     const std::string& lane, size_t n);
+    // An error detected at ite.
+    Expected<operand_t> fail(EVAL_EXCEPTION e,
+                             const TokenList::const_iterator& ite) const;
+
+    // Lets a function definition report an error without throwing. The
+    // returned value is a placeholder, the call fails as soon as the
+    // definition returns.
+    operand_t raise(EVAL_EXCEPTION e);
+    operand_t raise(const Expected<operand_t>& r) { return raise(r.error); }
+
+   public:
+    Context();
+    // Makes the math library visible, in constant time.
+    void importMath();
+
+    // A child context in O(1): definitions and assignments made in it stay
+    // in its own layer, everything else is read from this context. Budget,
+    // cancellation token and strict math are inherited, the cache is not.
+    Context fork() const { return Context(this); }
+
+    std::pair<ExprType, operand_t> exec(const std::string& input);
+
+    // Same as exec and evaluating an expression, but every error, including
+    // the ones EVAL_NO_THROW removes from the throwing path, comes back in
+    // the result instead of being thrown. Only definitions registered by
+    // the host that throw themselves still unwind, up to their call.
+    Expected<std::pair<ExprType, operand_t>> tryExec(const std::string& input);
+    Expected<operand_t> tryEval(const std::string& input);
+
+    // Calls function name on operands, as the expression name(args...)
+    // would.
+    Expected<operand_t> tryCall(const std::string& name,
+                                const std::vector<operand_t>& args);
+    // Makes n such calls, argument i of call j being args[i][j]. A custom
+    // function that is hot runs compiled over all of them in one pass.
+    void tryCall(const std::string& name, const operand_t* const* args,
+                 size_t arity, size_t n, Expected<operand_t>* out);
+
+    // The coefficient form DefFunc recognized for the custom function name,
+    // nullptr when its body is not a polynomial or rational function of its
+    // parameters.
+    const RationalForm* rationalForm(const std::string& name) const;
+
+    // Forward mode automatic differentiation: the derivative of function
+    // name with respect to its argument index, at args.
+    operand_t derivative(const std::string& name,
+                         const std::vector<operand_t>& args, size_t index = 0);
+    Expected<operand_t> tryDerivative(const std::string& name,
+                                      const std::vector<operand_t>& args,
+                                      size_t index = 0);
+
+    // Reverse mode: the value of function name at args together with its
+    // full gradient, in a single pass.
+    std::pair<operand_t, std::vector<operand_t>> gradient(
+        const std::string& name, const std::vector<operand_t>& args);
+    Expected<std::pair<operand_t, std::vector<operand_t>>> tryGradient(
+        const std::string& name, const std::vector<operand_t>& args);
+
+    virtual ~Context() {}
+};
+}  // namespace eval
+
 #endif
\ No newline at end of file
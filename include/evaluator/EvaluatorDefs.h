@@ -1,75 +1,155 @@
-#ifndef EVALUATOR_DEFS_H_
-#define EVALUATOR_DEFS_H_
-
-#include <stdexcept>
-
-#define EVAL_DECIMAL_OPERAND
-
-#define EVAL_DO_TYPE_CHECK
-
-namespace eval
-{
-using int_t = int;
-using decimal_t = long double;
-#ifdef EVAL_DECIMAL_OPERAND
-using operand_t = decimal_t;
-#else
-using operand_t = int_t;
-#endif
-
-constexpr operand_t operand_zero = 0;
-constexpr operand_t operand_one = 1;
-
-constexpr unsigned int maxRecursionDepth = 1024;
-
-enum EVAL_EXCEPTION
-{
-    EVAL_INVALID_EXPR = 0,
-    EVAL_UNDEFINED_SYMBOL,
-    EVAL_PAREN_MISMATCH,
-    EVAL_DIV_BY_ZERO,
-    EVAL_STACK_OVERFLOW,
-    EVAL_REPEATED_PARAMETER_NAME,
-    EVAL_WRONG_NUMBER_OF_ARGS,
-    EVAL_INFINITE_LOOP,
-    EVAL_UNEXPECTED_TOKEN_TYPE,
-    EVAL_PARSE_FAILED,
-    EVAL_OPERAND_OVERFLOW,
-    EVAL_OPERAND_PARSER_UNDEFINED,
-};
-
-static const char* EVAL_EXCEPTION_MSG[]{"invalid expression",
-                                        "undefined symbol",
-                                        "parentheses mismatched",
-                                        "division by zero",
-                                        "stack overflow",
-                                        "repeated parameter name",
-                                        "wrong number of arguments",
-                                        "infinite loop",
-                                        "unexpected token type",
-                                        "parse failed",
-                                        "operand overflow",
-                                        "operand parser undefined"};
-
-class EvalException : public std::runtime_error
-{
-   public:
-    EVAL_EXCEPTION code;
-    explicit EvalException(const EVAL_EXCEPTION& e)
-        : std::runtime_error(EVAL_EXCEPTION_MSG[e]), code(e)
-    {
-    }
-};
-
-#ifndef EVAL_NO_THROW
-#define EVAL_THROW(cond, msg)               \
-    do                                      \
-    {                                       \
-        if (cond) throw EvalException(msg); \
-    } while (0)
-#else
-#define EVAL_THROW(cond, msg)
-#endif
-}  // namespace eval
-
-#endif
+#ifndef EVALUATOR_DEFS_H_
+#define EVALUATOR_DEFS_H_
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+#define EVAL_DECIMAL_OPERAND
+
+// Decimal operands that keep integral values as exact 64 bit integers, see
+// Number.h.
+// #define EVAL_MIXED_OPERAND
+
+#define EVAL_DO_TYPE_CHECK
+
+#if defined(EVAL_MIXED_OPERAND) && !defined(EVAL_DECIMAL_OPERAND)
+#define EVAL_DECIMAL_OPERAND
+#endif
+
+namespace eval
+{
+using int_t = int;
+using decimal_t = long double;
+}  // namespace eval
+
+#ifdef EVAL_MIXED_OPERAND
+#include <evaluator/Number.h>
+#endif
+
+namespace eval
+{
+#if defined(EVAL_MIXED_OPERAND)
+using operand_t = Number;
+#elif defined(EVAL_DECIMAL_OPERAND)
+using operand_t = decimal_t;
+#else
+using operand_t = int_t;
+#endif
+
+constexpr operand_t operand_zero = 0;
+constexpr operand_t operand_one = 1;
+
+constexpr unsigned int maxRecursionDepth = 1024;
+
+enum EVAL_EXCEPTION
+{
+    EVAL_INVALID_EXPR = 0,
+    EVAL_UNDEFINED_SYMBOL,
+    EVAL_PAREN_MISMATCH,
+    EVAL_DIV_BY_ZERO,
+    EVAL_STACK_OVERFLOW,
+    EVAL_REPEATED_PARAMETER_NAME,
+    EVAL_WRONG_NUMBER_OF_ARGS,
+    EVAL_INFINITE_LOOP,
+    EVAL_UNEXPECTED_TOKEN_TYPE,
+    EVAL_PARSE_FAILED,
+    EVAL_OPERAND_OVERFLOW,
+    EVAL_OPERAND_PARSER_UNDEFINED,
+    EVAL_NOT_DIFFERENTIABLE,
+    EVAL_OPERATION_LIMIT,
+    EVAL_DEADLINE_EXCEEDED,
+    EVAL_MEMORY_LIMIT,
+    EVAL_CANCELLED,
+    EVAL_NOT_BRACKETED,
+    EVAL_NOT_CONVERGED,
+    EVAL_SIZE_MISMATCH,
+    EVAL_NOT_SCALAR,
+    EVAL_INDEX_OUT_OF_RANGE,
+    EVAL_TOO_MANY_DEFINITIONS,
+    EVAL_DEFINITIONS_TOO_LARGE,
+};
+
+static const char* EVAL_EXCEPTION_MSG[]{"invalid expression",
+                                        "undefined symbol",
+                                        "parentheses mismatched",
+                                        "division by zero",
+                                        "stack overflow",
+                                        "repeated parameter name",
+                                        "wrong number of arguments",
+                                        "infinite loop",
+                                        "unexpected token type",
+                                        "parse failed",
+                                        "operand overflow",
+                                        "operand parser undefined",
+                                        "not differentiable",
+                                        "operation limit exceeded",
+                                        "deadline exceeded",
+                                        "memory limit exceeded",
+                                        "cancelled",
+                                        "root not bracketed",
+                                        "not converged",
+                                        "array size mismatch",
+                                        "array where a scalar is expected",
+                                        "index out of range",
+                                        "too many definitions",
+                                        "definitions exceed the size quota"};
+
+class EvalException : public std::runtime_error
+{
+   public:
+    EVAL_EXCEPTION code;
+    explicit EvalException(const EVAL_EXCEPTION& e)
+        : std::runtime_error(EVAL_EXCEPTION_MSG[e]), code(e)
+    {
+    }
+};
+
+constexpr size_t noPosition = static_cast<size_t>(-1);
+
+// Result of the non-throwing API: a value, or the error that stopped the
+// evaluation with the index of the input token it was detected at. Errors
+// found inside a function body are placed at the call.
+template <typename T>
+struct Expected
+{
+    T value{};
+    bool ok = true;
+    EVAL_EXCEPTION error = EVAL_INVALID_EXPR;
+    size_t position = noPosition;
+
+    Expected() = default;
+    Expected(const T& v) : value(v) {}
+    Expected(T&& v) : value(std::move(v)) {}
+
+    static Expected failure(EVAL_EXCEPTION e, size_t pos = noPosition)
+    {
+        Expected r;
+        r.ok = false;
+        r.error = e;
+        r.position = pos;
+        return r;
+    }
+
+    // Forwards the error of another result.
+    template <typename U>
+    static Expected failure(const Expected<U>& other)
+    {
+        return failure(other.error, other.position);
+    }
+
+    explicit operator bool() const { return ok; }
+};
+
+#ifndef EVAL_NO_THROW
+#define EVAL_THROW(cond, msg)               \
+    do                                      \
+    {                                       \
+        if (cond) throw EvalException(msg); \
+    } while (0)
+#else
+#define EVAL_THROW(cond, msg)
+#endif
+}  // namespace eval
+
+#endif
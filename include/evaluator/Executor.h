@@ -0,0 +1,119 @@
+#ifndef EXECUTOR_H_
+#define EXECUTOR_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <evaluator/Context.h>
+
+namespace eval
+{
+// Evaluates expressions and function calls on a fixed pool of threads. The
+// threads work on forks of one library context, so definitions are made
+// once and shared by all of them. Every thread has a queue of its own and
+// steals from the others when it runs dry. It takes up to maxBatch tasks at
+// a time, and the calls of one custom function among them run compiled in a
+// single pass, see Context::tryCall. Task i draws rand from stream i of the
+// library's generator, so results do not depend on the number of threads or
+// on which one runs the task.
+class Executor
+{
+   public:
+    using Result = Expected<operand_t>;
+    // Runs on the thread that evaluated the task, so it should be quick and
+    // must not wait for other work of the executor.
+    using Callback = std::function<void(const Result&)>;
+
+    struct Stats
+    {
+        uint64_t tasks = 0;
+        uint64_t batches = 0;
+        // Calls that ran in a batch with other calls of the same function.
+        uint64_t batchedCalls = 0;
+        // Tasks taken from the queue of another thread.
+        uint64_t stolen = 0;
+    };
+
+    // Copies library. Zero threads means one per hardware thread.
+    explicit Executor(const Context& library, unsigned int threads = 0,
+                      size_t maxBatch = 64);
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    // Finishes the work already submitted.
+    ~Executor();
+
+    std::future<Result> submit(const std::string& expression);
+    void submit(const std::string& expression, Callback done);
+    // Calls function name on args, see Context::tryCall.
+    std::future<Result> call(const std::string& name,
+                             std::vector<operand_t> args);
+    void call(const std::string& name, std::vector<operand_t> args,
+              Callback done);
+
+    // Executes input on a copy of the library, which then replaces it. Work
+    // submitted afterwards sees the change, work already running keeps the
+    // library it started with. Definitions are meant to be made up front or
+    // now and then: each one copies the whole library.
+    Expected<std::pair<ExprType, operand_t>> define(const std::string& input);
+
+    size_t size() const { return threads.size(); }
+    Stats stats() const;
+
+   protected:
+    struct Task
+    {
+        bool call = false;
+        std::string text;  // the expression, or the function called
+        std::vector<operand_t> args;
+        Callback done;
+        std::promise<Result> promise;  // kept when there is no callback
+        // Submission order, which picks the stream rand draws from.
+        uint64_t ticket = 0;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    const size_t maxBatch;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> tickets{0};
+
+    // Tasks in the queues, and the threads waiting for some.
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> sleeping{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    bool stopping = false;
+
+    // Replaced as a whole by define, so a fork never sees its parent change.
+    std::shared_ptr<const Context> library;
+    std::atomic<uint64_t> generation{0};
+    std::mutex libraryMutex;  // guards library
+    std::mutex defineMutex;   // orders definitions
+
+    std::atomic<uint64_t> tasks{0}, batches{0}, batchedCalls{0}, stolen{0};
+
+    void push(Task task);
+    // Waits for tasks and moves up to maxBatch of them to batch. False once
+    // the executor stops and nothing is left.
+    bool take(size_t self, std::vector<Task>& batch);
+    void work(size_t self);
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+#ifndef EXPR_H_
+#define EXPR_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <evaluator/EvaluatorDefs.h>
+#include <evaluator/Function.h>
+#include <evaluator/Tokenizer.h>
+
+namespace eval
+{
+class Context;
+
+enum class NodeType
+{
+    CONST,
+    VAR,   // global variable, read once per batch
+    LANE,   // the variable that differs between lanes
+    PARAM,  // parameter of a compiled function, value is its index
+    NEG,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    POW,
+    CALL,  // ORDINARY function
+};
+
+struct Node
+{
+    NodeType type;
+    operand_t value;
+    std::string symbol;
+    const Function* func;
+    std::vector<size_t> args;
+};
+
+// Expressions compiled against the current tables of a context. Custom
+// functions are inlined and the nodes are hash consed, so the result is a
+// DAG, stored as a flat list in which every node comes after its arguments,
+// where identical pure subexpressions appear once. It stays valid as long as
+// those tables are not modified. Only compiled code shares subexpressions:
+// the token interpreter evaluates every occurrence, both for functions that
+// are not hot yet and for bodies that do not compile, such as those calling
+// IF_ELSE. Tiered code reports the count through Context::tierProfile.
+class Expr
+{
+   protected:
+    std::string lane;
+    std::vector<size_t> roots;
+    std::vector<operand_t> buffer;
+    bool running = false;
+
+    bool run(Context& context, const operand_t* const* inputs, operand_t* out,
+             size_t n, std::vector<operand_t>& buffer);
+
+   public:
+    std::vector<Node> nodes;
+    // Nodes that were shared instead of built again.
+    size_t deduplicated = 0;
+    // The functions the expressions call or inline, by name, for as long as
+    // they are not redefined.
+    std::vector<std::string> functions;
+    // Runs every node on the definitions the interpreter calls, rather than
+    // on the SIMD kernels, so results do not depend on being compiled.
+    bool exact = false;
+
+    // Starts over with a single expression. Fails, rather than throws, on
+    // anything the batch path does not cover: high order functions,
+    // functions passed as arguments, recursion and every error the
+    // interpreter would report.
+    bool compile(const Context& context, const TokenList::const_iterator& beg,
+                 const TokenList::const_iterator& end,
+                 const std::string& lane);
+
+    // Adds another expression over the same lane variable, sharing nodes
+    // with those already compiled. Leaves the others intact on failure.
+    bool add(const Context& context, const TokenList::const_iterator& beg,
+             const TokenList::const_iterator& end);
+
+    // Starts over with the body of a custom function, parameter i being
+    // input i of evalBatch.
+    bool compile(const Context& context, const Function& f);
+
+    size_t size() const { return roots.size(); }
+    // The node expression i evaluates to.
+    size_t root(size_t i) const { return roots[i]; }
+    // Estimated heap footprint, see Context::memoryUsage.
+    size_t bytes() const;
+
+    // Evaluates every expression for n values of the lane variable, the
+    // results of expression i going to out[i * n, (i + 1) * n). Returns
+    // false where the interpreter would have thrown, e.g. on division by
+    // zero, so the caller can replay the values through it.
+    bool evalBatch(Context& context, const operand_t* lane, operand_t* out,
+                   size_t n)
+    {
+        return evalBatch(context, &lane, out, n);
+    }
+    // Same with n values of every parameter of a compiled function. The
+    // lane variable is input 0.
+    bool evalBatch(Context& context, const operand_t* const* inputs,
+                   operand_t* out, size_t n);
+};
+
+// The body of SUM, MUL and the solvers: an expression in a dummy variable,
+// run through Expr once it is hot and compiles, through the interpreter
+// otherwise, see TieringPolicy. The dummy variable lives in the context
+// under a name no input can spell, from construction to destruction.
+class LaneBody
+{
+   protected:
+    Context& context;
+    TokenList tokens;
+    std::string var;
+    operand_t* slot;
+    std::shared_ptr<Expr> expr;
+    std::string key;  // of the tier table, empty when not tiered
+    size_t held;
+
+    void attach(std::shared_ptr<Expr> code);
+
+   public:
+    LaneBody(Context& context, const TokenList::const_iterator& beg,
+             const TokenList::const_iterator& end, const std::string& var);
+    LaneBody(const LaneBody&) = delete;
+    LaneBody& operator=(const LaneBody&) = delete;
+    ~LaneBody();
+
+    // Evaluates the body for n values of the variable, checking the budget
+    // once. On failure the error has been raised on the context.
+    bool eval(const operand_t* x, operand_t* out, size_t n);
+    bool eval(operand_t x, operand_t& out) { return eval(&x, &out, 1); }
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <evaluator/EvaluatorDefs.h>
+
+namespace eval
+{
+enum class FloatStyle
+{
+    SHORTEST,  // the fewest digits that read back to the same value
+    FIXED,     // precision digits after the point
+    SCIENTIFIC,
+    GENERAL,   // precision significant digits, as printf's %g
+};
+
+// How results are written as text. Integral operands are always written
+// as integers.
+struct FormatOptions
+{
+    FloatStyle style = FloatStyle::SHORTEST;
+    int precision = 6;
+    // Rounds decimals to double first, so the shortest form is the one a
+    // double parser downstream needs, and faster to find.
+    bool asDouble = false;
+};
+
+// Writes v to [first, last) without iostreams or locales, as std::to_chars
+// does, returning the end of the text or nullptr when it does not fit.
+char* format(char* first, char* last, const operand_t& v,
+             const FormatOptions& options = FormatOptions());
+std::string toString(const operand_t& v,
+                     const FormatOptions& options = FormatOptions());
+
+// Raw results: 8 little endian bytes per value, an IEEE 754 double for
+// decimal and mixed operands and a two's complement int64 for int operands.
+constexpr size_t binarySize = 8;
+char* encode(char* out, const operand_t& v);
+
+// Buffers results and writes them to a file with fwrite, one per line in
+// text mode, back to back in binary mode.
+class ResultWriter
+{
+   public:
+    enum class Mode
+    {
+        TEXT,
+        BINARY,
+    };
+
+   protected:
+    std::FILE* file;
+    Mode mode;
+    FormatOptions options;
+    std::vector<char> buffer;
+    size_t used = 0;
+    bool failed = false;
+
+    // Room for at least n more bytes.
+    char* reserve(size_t n);
+
+   public:
+    explicit ResultWriter(std::FILE* file, Mode mode = Mode::TEXT,
+                          const FormatOptions& options = FormatOptions(),
+                          size_t bufferSize = size_t(1) << 16);
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+    ~ResultWriter() { flush(); }
+
+    void write(const operand_t& v);
+    void write(const operand_t* v, size_t n);
+    // Text as it is, e.g. a separator or an error message.
+    void write(std::string_view text);
+    // False once a write to the file has failed.
+    bool flush();
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
@@ -1,43 +1,111 @@
-#ifndef FUNCTION_H_
-#define FUNCTION_H_
-
-#include <functional>
-#include <list>
-
-#include <evaluator/EvaluatorDefs.h>
-#include <evaluator/Tokenizer.h>
-
-namespace eval
-{
-class Context;
-enum class FuncType
-{
-    CUSTOM,
-    ORDINARY,
-    HIGH_ORDER,
-};
-
-class Function
-{
-   public:
-    std::vector<std::list<size_t>> parameterTable;
-    FuncType type;
-    TokenList tkList;
-    std::function<operand_t(const TokenList&, Context&)> definition;
-
-    Function() = default;
-    Function(const Function&) = default;
-
-    Function(FuncType t, decltype(definition) def);
-    Function(const TokenList::const_iterator& beg,
-             const TokenList::const_iterator& end);
-
-    void setArguments(const TokenList& args, TokenList& tkl);
-
-    operand_t eval(Context& context,
-                   const TokenList::const_iterator& beg,
-                   const TokenList::const_iterator& end);
-};
-}  // namespace eval
-
+#ifndef FUNCTION_H_
+#define FUNCTION_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <evaluator/EvaluatorDefs.h>
+#include <evaluator/Tokenizer.h>
+
+namespace eval
+{
+class Context;
+class RationalForm;
+enum class FuncType
+{
+    CUSTOM,
+    ORDINARY,
+    HIGH_ORDER,
+};
+
+// Where each parameter of a custom function appears in its body. The
+// positions of all parameters share one array, parameter i owning
+// positions[offsets[i]] to positions[offsets[i + 1]].
+class ParameterTable
+{
+   protected:
+    std::vector<uint32_t> offsets{0};
+    std::vector<uint32_t> positions;
+
+   public:
+    struct Positions
+    {
+        const uint32_t *first, *last;
+        const uint32_t* begin() const { return first; }
+        const uint32_t* end() const { return last; }
+    };
+
+    // The number of parameters.
+    size_t size() const { return offsets.size() - 1; }
+    Positions operator[](size_t i) const
+    {
+        return {positions.data() + offsets[i],
+                positions.data() + offsets[i + 1]};
+    }
+    // parameterOf[k] is the parameter token k of the body stands for, or
+    // count when it is not one.
+    void assign(size_t count, const std::vector<size_t>& parameterOf);
+    size_t bytes() const
+    {
+        return (offsets.capacity() + positions.capacity()) * sizeof(uint32_t);
+    }
+};
+
+class Function
+{
+   public:
+    ParameterTable parameterTable;
+    FuncType type;
+    TokenList tkList;
+    std::function<operand_t(const TokenList&, Context&)> definition;
+    // Optional vectorized form of an ORDINARY function, out[i] = f(args[0][i],
+    // args[1][i], ...). Used by the batch path unless strict math is on.
+    std::function<void(const operand_t* const* args, operand_t* out, size_t n,
+                       Context& context)>
+        batchDefinition;
+    // Partial derivatives of an ORDINARY function, d[i] = df/dargs[i]. Only
+    // functions that have it can be differentiated through.
+    std::function<void(const TokenList& args, operand_t* d)> derivative;
+    // Whether equal arguments always give equal results, so that calls can
+    // be shared.
+    bool pure = true;
+    // How many arguments an ORDINARY function takes, all of them operands
+    // unless it takesSymbols. Context::call checks them before running the
+    // definition.
+    size_t minArgs = 0, maxArgs = static_cast<size_t>(-1);
+    bool takesSymbols = false;
+    // The coefficient form of a CUSTOM function whose body is a polynomial
+    // or rational function of its parameters, which calls evaluate instead
+    // of the body, see Polynomial.h.
+    std::shared_ptr<const RationalForm> form;
+
+    Function() = default;
+    Function(const Function&) = default;
+
+    Function(FuncType t, decltype(definition) def,
+             decltype(batchDefinition) batch = nullptr);
+    Function(const TokenList::const_iterator& beg,
+             const TokenList::const_iterator& end);
+
+    void setArguments(const TokenList& args, TokenList& tkl) const;
+
+    bool accepts(size_t argc) const
+    {
+        return argc >= minArgs && argc <= maxArgs;
+    }
+
+    operand_t eval(Context& context,
+                   const TokenList::const_iterator& beg,
+                   const TokenList::const_iterator& end) const;
+
+    // Same as eval, reporting errors through the result, see
+    // Context::tryExec.
+    Expected<operand_t> tryEval(Context& context,
+                                const TokenList::const_iterator& beg,
+                                const TokenList::const_iterator& end) const;
+};
+}  // namespace eval
+
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef MATH_KERNELS_H_
+#define MATH_KERNELS_H_
+
+#include <cstddef>
+
+namespace eval
+{
+namespace simd
+{
+// Instruction sets the kernels are compiled for. The best one supported by
+// both the CPU and the OS is picked on first use via CPUID/XGETBV.
+enum class ISA
+{
+    SCALAR,
+    SSE2,    // 2 lanes
+    AVX2,    // 4 lanes, FMA
+    AVX512,  // 8 lanes, FMA
+};
+
+ISA detectISA();
+ISA activeISA();
+// Forces a narrower instruction set, e.g. for benchmarking; requests wider
+// than detectISA() are clamped.
+void setISA(ISA isa);
+const char* isaName(ISA isa);
+
+// Element-wise double precision kernels, y[i] = f(x[i]). Maximum errors
+// measured against a long double reference, in units of the last place of
+// the double result:
+//
+//   sin, cos    1 ulp    |x| < 1.6e6, larger arguments use libm
+//   exp         1 ulp    subnormal results may round twice
+//   ln          1 ulp
+//   lg          2 ulp
+//   atan        1 ulp
+//   erf         2 ulp
+//   gamma       3 ulp    0 < x <= 171, other arguments use libm
+//   pow         2 ulp    x > 0, |y * ln(x)| < 708, other arguments use libm
+//
+// NaN and infinite arguments are always delegated to libm, so special values
+// match std::sin etc. exactly. The arrays may alias.
+void sin(const double* x, double* y, size_t n);
+void cos(const double* x, double* y, size_t n);
+void exp(const double* x, double* y, size_t n);
+void ln(const double* x, double* y, size_t n);
+void lg(const double* x, double* y, size_t n);
+void atan(const double* x, double* y, size_t n);
+void erf(const double* x, double* y, size_t n);
+void gamma(const double* x, double* y, size_t n);
+void pow(const double* x, const double* y, double* z, size_t n);
+}  // namespace simd
+}  // namespace eval
+
+#endif
\ No newline at end of file
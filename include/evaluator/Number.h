@@ -0,0 +1,247 @@
+#ifndef NUMBER_H_
+#define NUMBER_H_
+
+// Included by EvaluatorDefs.h when EVAL_MIXED_OPERAND is defined.
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+
+namespace eval
+{
+namespace detail
+{
+constexpr int64_t int64Max = std::numeric_limits<int64_t>::max();
+constexpr int64_t int64Min = std::numeric_limits<int64_t>::min();
+
+// Each returns true, leaving r unspecified, when the result does not fit.
+inline bool addOverflow(int64_t a, int64_t b, int64_t& r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_add_overflow(a, b, &r);
+#else
+    if ((b > 0 && a > int64Max - b) || (b < 0 && a < int64Min - b))
+        return true;
+    r = a + b;
+    return false;
+#endif
+}
+
+inline bool subOverflow(int64_t a, int64_t b, int64_t& r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_sub_overflow(a, b, &r);
+#else
+    if ((b < 0 && a > int64Max + b) || (b > 0 && a < int64Min + b))
+        return true;
+    r = a - b;
+    return false;
+#endif
+}
+
+inline bool mulOverflow(int64_t a, int64_t b, int64_t& r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_mul_overflow(a, b, &r);
+#else
+    if (a && b)
+    {
+        if ((a == -1 && b == int64Min) || (b == -1 && a == int64Min))
+            return true;
+        if (a > 0 ? (b > 0 ? a > int64Max / b : b < int64Min / a)
+                  : (b > 0 ? a < int64Min / b : a < int64Max / b))
+            return true;
+    }
+    r = a * b;
+    return false;
+#endif
+}
+}  // namespace detail
+
+// Operand of EVAL_MIXED_OPERAND. Integer literals, comparisons and the
+// results of floor and ceil are exact 64 bit integers, and stay so through
+// +, -, *, exact division and ^ by a non-negative integer. Any other result,
+// or one that overflows, is a decimal_t. A Number converts to decimal_t, so
+// the math functions take it as they are.
+class Number
+{
+    template <typename T>
+    using IfInt = std::enable_if_t<std::is_integral_v<T>, int>;
+    template <typename T>
+    using IfFloat = std::enable_if_t<std::is_floating_point_v<T>, int>;
+    template <typename T>
+    using IfArith = std::enable_if_t<std::is_arithmetic_v<T>, int>;
+
+   public:
+    bool integral;
+    int64_t i;    // when integral
+    decimal_t d;  // otherwise
+
+    constexpr Number() : integral(true), i(0), d(0) {}
+    template <typename T, IfInt<T> = 0>
+    constexpr Number(T v) : integral(true), i(static_cast<int64_t>(v)), d(0)
+    {
+        if constexpr (std::is_unsigned_v<T> && sizeof(T) >= sizeof(int64_t))
+            if (v > static_cast<T>(detail::int64Max))
+            {
+                integral = false;
+                d = static_cast<decimal_t>(v);
+            }
+    }
+    template <typename T, IfFloat<T> = 0>
+    constexpr Number(T v)
+        : integral(false), i(0), d(static_cast<decimal_t>(v))
+    {
+    }
+
+    // v as an integer when it is integral and in range, as for floor.
+    static Number integer(decimal_t v)
+    {
+        if (v >= -9223372036854775808.0L && v < 9223372036854775808.0L &&
+            v == std::trunc(v))
+            return Number(static_cast<int64_t>(v));
+        return Number(v);
+    }
+
+    constexpr operator decimal_t() const
+    {
+        return integral ? static_cast<decimal_t>(i) : d;
+    }
+
+    friend Number operator-(const Number& a)
+    {
+        if (a.integral && a.i != detail::int64Min) return Number(-a.i);
+        return Number(-static_cast<decimal_t>(a));
+    }
+
+    friend Number operator+(const Number& a, const Number& b)
+    {
+        int64_t r;
+        if (a.integral && b.integral && !detail::addOverflow(a.i, b.i, r))
+            return Number(r);
+        return Number(static_cast<decimal_t>(a) + static_cast<decimal_t>(b));
+    }
+    friend Number operator-(const Number& a, const Number& b)
+    {
+        int64_t r;
+        if (a.integral && b.integral && !detail::subOverflow(a.i, b.i, r))
+            return Number(r);
+        return Number(static_cast<decimal_t>(a) - static_cast<decimal_t>(b));
+    }
+    friend Number operator*(const Number& a, const Number& b)
+    {
+        int64_t r;
+        if (a.integral && b.integral && !detail::mulOverflow(a.i, b.i, r))
+            return Number(r);
+        return Number(static_cast<decimal_t>(a) * static_cast<decimal_t>(b));
+    }
+    friend Number operator/(const Number& a, const Number& b)
+    {
+        if (a.integral && b.integral && b.i &&
+            !(a.i == detail::int64Min && b.i == -1) && a.i % b.i == 0)
+            return Number(a.i / b.i);
+        return Number(static_cast<decimal_t>(a) / static_cast<decimal_t>(b));
+    }
+
+    friend bool operator==(const Number& a, const Number& b)
+    {
+        if (a.integral && b.integral) return a.i == b.i;
+        return static_cast<decimal_t>(a) == static_cast<decimal_t>(b);
+    }
+    friend bool operator<(const Number& a, const Number& b)
+    {
+        if (a.integral && b.integral) return a.i < b.i;
+        return static_cast<decimal_t>(a) < static_cast<decimal_t>(b);
+    }
+    friend bool operator!=(const Number& a, const Number& b)
+    {
+        return !(a == b);
+    }
+    friend bool operator>(const Number& a, const Number& b) { return b < a; }
+    friend bool operator<=(const Number& a, const Number& b)
+    {
+        return !(b < a);
+    }
+    friend bool operator>=(const Number& a, const Number& b)
+    {
+        return !(a < b);
+    }
+
+    // Mixed with built-in arithmetic types, which would otherwise be
+    // ambiguous with the built-in operators on decimal_t.
+#define EVAL_NUMBER_MIXED_OP(R, op)                                  \
+    template <typename T, IfArith<T> = 0>                            \
+    friend R operator op(const Number& a, T b)                       \
+    {                                                                \
+        return a op Number(b);                                       \
+    }                                                                \
+    template <typename T, IfArith<T> = 0>                            \
+    friend R operator op(T a, const Number& b)                       \
+    {                                                                \
+        return Number(a) op b;                                       \
+    }
+    EVAL_NUMBER_MIXED_OP(Number, +)
+    EVAL_NUMBER_MIXED_OP(Number, -)
+    EVAL_NUMBER_MIXED_OP(Number, *)
+    EVAL_NUMBER_MIXED_OP(Number, /)
+    EVAL_NUMBER_MIXED_OP(bool, ==)
+    EVAL_NUMBER_MIXED_OP(bool, !=)
+    EVAL_NUMBER_MIXED_OP(bool, <)
+    EVAL_NUMBER_MIXED_OP(bool, >)
+    EVAL_NUMBER_MIXED_OP(bool, <=)
+    EVAL_NUMBER_MIXED_OP(bool, >=)
+#undef EVAL_NUMBER_MIXED_OP
+
+    Number& operator+=(const Number& b) { return *this = *this + b; }
+    Number& operator-=(const Number& b) { return *this = *this - b; }
+    Number& operator*=(const Number& b) { return *this = *this * b; }
+    Number& operator/=(const Number& b) { return *this = *this / b; }
+
+    friend std::ostream& operator<<(std::ostream& os, const Number& a)
+    {
+        if (a.integral) return os << a.i;
+        return os << a.d;
+    }
+};
+
+// Integer powers by squaring, falling back to std::pow on overflow, for
+// negative exponents and for decimal operands.
+inline Number pow(const Number& a, const Number& b)
+{
+    if (a.integral && b.integral && b.i >= 0)
+    {
+        int64_t r = 1, base = a.i, e = b.i;
+        bool overflow = false;
+        while (e && !overflow)
+        {
+            if (e & 1) overflow = detail::mulOverflow(r, base, r);
+            e >>= 1;
+            if (e && !overflow) overflow = detail::mulOverflow(base, base, base);
+        }
+        if (!overflow) return Number(r);
+    }
+    return Number(std::pow(static_cast<decimal_t>(a), static_cast<decimal_t>(b)));
+}
+}  // namespace eval
+
+namespace std
+{
+template <>
+struct numeric_limits<eval::Number> : numeric_limits<eval::decimal_t>
+{
+};
+
+// Consistent with ==, which compares an integer and a decimal by value.
+template <>
+struct hash<eval::Number>
+{
+    size_t operator()(const eval::Number& a) const
+    {
+        return hash<eval::decimal_t>()(static_cast<eval::decimal_t>(a));
+    }
+};
+}  // namespace std
+
+#endif
\ No newline at end of file
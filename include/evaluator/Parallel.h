@@ -0,0 +1,27 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <cstdint>
+
+namespace eval
+{
+// Fork-join evaluation of independent operands: both sides of an operator,
+// or the arguments of a call, run as tasks on a process-wide work stealing
+// pool when they are pure, reach a custom or high order function and some
+// thread of the pool is idle. Each task evaluates in a fork, so the context
+// must not be changed by another thread meanwhile, as for any evaluation.
+// Results and errors are the same as in sequential order.
+struct ParallelPolicy
+{
+    bool enabled = false;
+    // Of the pool, counting the thread that evaluates, fixed by the first
+    // parallel evaluation of the process. Zero for the hardware threads.
+    unsigned int threads = 0;
+    // Operations a task should take at least. Tasks found smaller stop
+    // further ones from being spawned as deep in the expression, tasks far
+    // larger let them go one level deeper.
+    uint64_t grain = 4096;
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
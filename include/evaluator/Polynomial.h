@@ -0,0 +1,173 @@
+#ifndef POLYNOMIAL_H_
+#define POLYNOMIAL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <evaluator/EvaluatorDefs.h>
+
+namespace eval
+{
+class Context;
+class Function;
+
+struct Monomial
+{
+    operand_t coefficient;
+    std::vector<unsigned int> exponents;  // one per variable
+};
+
+// A polynomial in a number of variables, in coefficient form: its terms
+// have nonzero coefficients and come in decreasing order of their exponents,
+// compared first variable first.
+class Polynomial
+{
+   public:
+    size_t variables = 0;
+    std::vector<Monomial> terms;
+
+    // Highest exponent of variable v.
+    unsigned int degree(size_t v) const;
+    bool constant() const;
+    // The only variable with a positive exponent, variables when there is
+    // none or more than one.
+    size_t single() const;
+    // Coefficients of a polynomial in variable v alone, lowest power first.
+    std::vector<operand_t> coefficients(size_t v) const;
+
+    // Univariate polynomials of at least this degree are evaluated with
+    // Estrin's scheme, whose products of a level are independent. Lower
+    // degrees, and polynomials in several variables, use Horner's scheme
+    // nested variable by variable, skipping absent powers with square and
+    // multiply chains.
+    static constexpr unsigned int estrinDegree = 8;
+
+    // Evaluates the scheme at x, one value per variable, through ops,
+    // which provides Value constant(const operand_t&), Value add(Value,
+    // Value) and Value mul(Value, Value).
+    template <typename Ops>
+    typename Ops::Value evaluate(Ops& ops,
+                                 const typename Ops::Value* x) const;
+
+   protected:
+    // x ^ k for k > 0 by square and multiply.
+    template <typename Ops>
+    static typename Ops::Value power(Ops& ops, typename Ops::Value x,
+                                     unsigned int k);
+    template <typename Ops>
+    typename Ops::Value horner(Ops& ops, const typename Ops::Value* x,
+                               size_t first, size_t last, size_t v) const;
+    template <typename Ops>
+    typename Ops::Value estrin(Ops& ops, const typename Ops::Value& x,
+                               size_t v) const;
+};
+
+// The body of a custom function, recognized by DefFunc as a polynomial or a
+// quotient of polynomials in its parameters, constants being literals.
+// Calls evaluate the coefficient form instead of the body, interpreted and
+// compiled alike, so ^ by an integer is a chain of products rather than a
+// call of pow. A call fails with a division by zero when the denominator
+// is zero.
+class RationalForm
+{
+   public:
+    Polynomial numerator;
+    Polynomial denominator;  // the constant 1 for a polynomial
+    // Additions, multiplications and divisions of a call.
+    size_t operations = 0;
+
+    bool polynomial() const { return denominator.terms.empty(); }
+    size_t bytes() const;
+    Expected<operand_t> eval(const operand_t* x) const;
+    // Same scheme through ops, which also provides Value div(Value, Value).
+    template <typename Ops>
+    typename Ops::Value evaluate(Ops& ops, const typename Ops::Value* x) const
+    {
+        auto n = numerator.evaluate(ops, x);
+        if (polynomial()) return n;
+        return ops.div(n, denominator.evaluate(ops, x));
+    }
+
+    // nullptr when the body of f is neither, reaches another function or a
+    // variable, or has a degree above 64.
+    static std::shared_ptr<const RationalForm> recognize(
+        const Context& context, const Function& f);
+};
+
+template <typename Ops>
+typename Ops::Value Polynomial::power(Ops& ops, typename Ops::Value x,
+                                      unsigned int k)
+{
+    typename Ops::Value r = x;
+    bool started = false;
+    while (true)
+    {
+        if (k & 1)
+        {
+            r = started ? ops.mul(r, x) : x;
+            started = true;
+        }
+        k >>= 1;
+        if (!k) return r;
+        x = ops.mul(x, x);
+    }
+}
+
+template <typename Ops>
+typename Ops::Value Polynomial::evaluate(Ops& ops,
+                                         const typename Ops::Value* x) const
+{
+    if (terms.empty()) return ops.constant(operand_zero);
+    size_t v = single();
+    if (v < variables && degree(v) >= estrinDegree) return estrin(ops, x[v], v);
+    return horner(ops, x, 0, terms.size(), 0);
+}
+
+// Terms [first, last) share their exponents of the variables before v.
+template <typename Ops>
+typename Ops::Value Polynomial::horner(Ops& ops, const typename Ops::Value* x,
+                                       size_t first, size_t last,
+                                       size_t v) const
+{
+    if (v == variables) return ops.constant(terms[first].coefficient);
+    typename Ops::Value r{};
+    unsigned int previous = 0;
+    for (size_t i = first; i < last;)
+    {
+        unsigned int e = terms[i].exponents[v];
+        size_t j = i;
+        while (j < last && terms[j].exponents[v] == e) ++j;
+        auto c = horner(ops, x, i, j, v + 1);
+        r = i == first ? c
+                       : ops.add(ops.mul(r, power(ops, x[v], previous - e)),
+                                 c);
+        previous = e;
+        i = j;
+    }
+    return previous ? ops.mul(r, power(ops, x[v], previous)) : r;
+}
+
+template <typename Ops>
+typename Ops::Value Polynomial::estrin(Ops& ops, const typename Ops::Value& x,
+                                       size_t v) const
+{
+    std::vector<typename Ops::Value> level;
+    for (const auto& c : coefficients(v)) level.push_back(ops.constant(c));
+    auto p = x;
+    while (level.size() > 1)
+    {
+        // c[2i] + c[2i + 1] * p, p squaring from one level to the next.
+        size_t half = (level.size() + 1) / 2;
+        for (size_t i = 0; i < half; ++i)
+            level[i] = 2 * i + 1 < level.size()
+                           ? ops.add(level[2 * i], ops.mul(level[2 * i + 1], p))
+                           : level[2 * i];
+        level.resize(half);
+        if (half > 1) p = ops.mul(p, p);
+    }
+    return level[0];
+}
+}  // namespace eval
+
+#endif
\ No newline at end of file
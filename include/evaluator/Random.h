@@ -0,0 +1,82 @@
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace eval
+{
+// Counter-based generator: the i-th number of a stream is a hash of the
+// stream key and i, so there is no sequential state to share. Streams split
+// off a generator are independent of it and of each other, and numbers come
+// out the same whether they are drawn one at a time or filled in bulk.
+class Random
+{
+   protected:
+    uint64_t key;
+    uint64_t counter;
+    // Streams handed out by split.
+    mutable std::atomic<uint64_t> splits;
+
+   public:
+    explicit Random(uint64_t seed = 0) : counter(0), splits(0) { reseed(seed); }
+    Random(const Random& other)
+        : key(other.key), counter(other.counter), splits(other.splits.load())
+    {
+    }
+    Random& operator=(const Random& other)
+    {
+        key = other.key;
+        counter = other.counter;
+        splits.store(other.splits.load());
+        return *this;
+    }
+
+    // SplitMix64 finalizer, a bijection with full avalanche.
+    static uint64_t mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // Restarts at the first number of the stream of seed.
+    void reseed(uint64_t seed)
+    {
+        key = mix(seed + 0x9e3779b97f4a7c15ULL);
+        counter = 0;
+        splits.store(0);
+    }
+
+    // Number i of the stream, whatever has been drawn so far.
+    uint64_t at(uint64_t i) const { return mix(mix(i + key) + key); }
+    uint64_t next() { return at(counter++); }
+    // The next n numbers, with no dependency between them, so the loop
+    // vectorizes where the target has 64 bit multiplies.
+    void fill(uint64_t* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) out[i] = at(counter + i);
+        counter += n;
+    }
+    void skip(uint64_t n) { counter += n; }
+    uint64_t position() const { return counter; }
+
+    // Stream number index of this generator. Parallel work that draws from
+    // stream(i) for its i-th piece gets the same numbers on any number of
+    // threads.
+    Random stream(uint64_t index) const
+    {
+        Random r;
+        r.key = mix(key ^ mix(index + 0x632be59bd9b4e019ULL));
+        return r;
+    }
+    // The next unused stream, thread safe.
+    Random split() const
+    {
+        return stream(splits.fetch_add(1, std::memory_order_relaxed));
+    }
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
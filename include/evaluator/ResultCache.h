@@ -0,0 +1,67 @@
+#ifndef RESULT_CACHE_H_
+#define RESULT_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <evaluator/EvaluatorDefs.h>
+
+namespace eval
+{
+struct CacheStats
+{
+    uint64_t hits = 0, misses = 0;
+    size_t entries = 0;
+    size_t bytes = 0;  // keys, dependency lists and bookkeeping
+
+    double hitRate() const
+    {
+        return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0;
+    }
+};
+
+// Least recently used map from normalized expressions to their results.
+// Every entry remembers the version of each symbol the result depends on and
+// is dropped once one of them has changed.
+class ResultCache
+{
+   public:
+    using Dependencies = std::vector<std::pair<std::string, uint64_t>>;
+
+   protected:
+    struct Entry
+    {
+        std::string key;
+        operand_t value;
+        Dependencies deps;
+        size_t bytes;
+    };
+
+    size_t capacity = 0;
+    std::list<Entry> entries;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    CacheStats counters;
+
+   public:
+    // At most capacity entries, 0 disables the cache and drops its content.
+    void setCapacity(size_t n);
+    size_t getCapacity() const { return capacity; }
+    bool enabled() const { return capacity != 0; }
+
+    // version(name) must give the current version of a symbol.
+    bool find(const std::string& key,
+              const std::function<uint64_t(const std::string&)>& version,
+              operand_t& value);
+    void insert(const std::string& key, operand_t value, Dependencies deps);
+    void clear();
+
+    const CacheStats& stats() const { return counters; }
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
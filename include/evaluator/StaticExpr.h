@@ -0,0 +1,1067 @@
+#ifndef STATIC_EXPR_H_
+#define STATIC_EXPR_H_
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+#include <evaluator/EvaluatorDefs.h>
+#include <evaluator/Tokenizer.h>
+
+// Expressions known at build time, parsed by the compiler. EVAL_EXPR turns a
+// string literal into a callable that evaluates it as Context would, with
+// the same tokens, main operators, short circuits, literal rounding and
+// importMath functions, but as straight-line code with no context:
+//
+//     auto pdf = EVAL_EXPR("pdf(x, mu, s) = 1 / ((2*pi)^0.5 * s) * "
+//                          "e^(-(x-mu)^2/(2*s^2))");
+//     operand_t y = pdf(0.5, 0, 1);
+//
+// The parameters are those of a definition, in their order, or else the
+// variables of the expression in order of first appearance; pi and e are
+// the constants of importMath unless a parameter is named so. The functions
+// that can be called are those of importMath other than rand, D and the
+// loops, solvers and array functions, whose names are undefined symbols here.
+// A literal that does not parse fails to compile with the message of its
+// error, the instantiation of StaticCheck naming the index of the token it
+// was found at.
+#define EVAL_EXPR(literal)                                                   \
+    ([] {                                                                    \
+        struct Source                                                        \
+        {                                                                    \
+            static constexpr std::string_view text() { return literal; }    \
+        };                                                                   \
+        return ::eval::StaticExpr<Source>();                                \
+    }())
+
+namespace eval
+{
+namespace detail
+{
+constexpr size_t maxStaticTokens = 512;
+constexpr size_t maxStaticArgs = 64;
+constexpr size_t maxStaticParameters = 32;
+constexpr unsigned int maxStaticDepth = 256;
+constexpr size_t staticNone = static_cast<size_t>(-1);
+
+enum class StaticFunc
+{
+    NONE,
+    EQ,
+    NEQ,
+    LEQ,
+    LT,
+    GEQ,
+    GT,
+    LN,
+    LG,
+    LOG,
+    SIN,
+    COS,
+    TAN,
+    ASIN,
+    ACOS,
+    ATAN,
+    GAMMA,
+    FLOOR,
+    CEIL,
+    EXP,
+    ERF,
+    ABS,
+    MAX,
+    MIN,
+    IF_ELSE,
+};
+
+struct StaticFuncInfo
+{
+    std::string_view name;
+    StaticFunc func;
+    size_t arity;  // 0 for one or more
+};
+
+// The importMath functions of the operand mode, see Context::defineMath.
+constexpr StaticFuncInfo staticFuncs[] = {
+    {"eq", StaticFunc::EQ, 2},
+    {"neq", StaticFunc::NEQ, 2},
+    {"leq", StaticFunc::LEQ, 2},
+    {"lt", StaticFunc::LT, 2},
+    {"geq", StaticFunc::GEQ, 2},
+    {"gt", StaticFunc::GT, 2},
+#ifdef EVAL_DECIMAL_OPERAND
+    {"ln", StaticFunc::LN, 1},
+    {"lg", StaticFunc::LG, 1},
+    {"log", StaticFunc::LOG, 2},
+    {"sin", StaticFunc::SIN, 1},
+    {"cos", StaticFunc::COS, 1},
+    {"tan", StaticFunc::TAN, 1},
+    {"asin", StaticFunc::ASIN, 1},
+    {"acos", StaticFunc::ACOS, 1},
+    {"atan", StaticFunc::ATAN, 1},
+    {"gamma", StaticFunc::GAMMA, 1},
+    {"floor", StaticFunc::FLOOR, 1},
+    {"ceil", StaticFunc::CEIL, 1},
+    {"exp", StaticFunc::EXP, 1},
+    {"erf", StaticFunc::ERF, 1},
+#endif
+    {"abs", StaticFunc::ABS, 1},
+    {"max", StaticFunc::MAX, 0},
+    {"min", StaticFunc::MIN, 0},
+    {"IF_ELSE", StaticFunc::IF_ELSE, 3},
+};
+
+constexpr const StaticFuncInfo* findStaticFunc(std::string_view name)
+{
+    for (const auto& f : staticFuncs)
+        if (f.name == name) return &f;
+    return nullptr;
+}
+
+// Names of importMath that cannot be called here, and are not free
+// variables either.
+constexpr std::string_view staticReserved[] = {
+    "rand", "D", "SUM", "MUL", "ROOT", "MINIMIZE", "INTEGRATE", "LIMIT",
+    "SERIES", "PRODUCT", "vec", "linspace", "range", "at", "len", "sum",
+    "prod", "mean", "dot"};
+
+constexpr bool isStaticReserved(std::string_view name)
+{
+    for (auto r : staticReserved)
+        if (r == name) return true;
+    return false;
+}
+
+// Unsigned integer of 32 bit limbs, least significant first, large enough
+// for the literals of the widest decimal_t.
+class StaticBigInt
+{
+   public:
+    static constexpr size_t capacity = 640;
+    uint32_t limbs[capacity] = {};
+    size_t size = 0;
+
+    constexpr bool zero() const { return size == 0; }
+    constexpr size_t bits() const
+    {
+        if (!size) return 0;
+        size_t n = (size - 1) * 32;
+        for (uint32_t top = limbs[size - 1]; top; top >>= 1) ++n;
+        return n;
+    }
+    constexpr bool bit(size_t i) const
+    {
+        return i / 32 < size && (limbs[i / 32] >> (i % 32)) & 1;
+    }
+    // Whether a bit below i is set.
+    constexpr bool anyBelow(size_t i) const
+    {
+        for (size_t k = 0; k < size && k * 32 < i; ++k)
+        {
+            uint32_t mask = i - k * 32 >= 32
+                                ? ~uint32_t(0)
+                                : (uint32_t(1) << (i - k * 32)) - 1;
+            if (limbs[k] & mask) return true;
+        }
+        return false;
+    }
+    constexpr void setBit(size_t i)
+    {
+        while (size <= i / 32) limbs[size++] = 0;
+        limbs[i / 32] |= uint32_t(1) << (i % 32);
+    }
+    // *this = *this * m + a, false past the capacity.
+    constexpr bool mulAdd(uint32_t m, uint32_t a)
+    {
+        uint64_t carry = a;
+        for (size_t k = 0; k < size; ++k)
+        {
+            uint64_t v = uint64_t(limbs[k]) * m + carry;
+            limbs[k] = static_cast<uint32_t>(v);
+            carry = v >> 32;
+        }
+        if (!carry) return true;
+        if (size == capacity) return false;
+        limbs[size++] = static_cast<uint32_t>(carry);
+        return true;
+    }
+    constexpr bool shiftLeft(size_t n)
+    {
+        if (!size || !n) return true;
+        size_t words = n / 32, rest = n % 32;
+        if (size + words + 1 > capacity) return false;
+        for (size_t k = size + words + 1; k-- > 0;)
+        {
+            uint32_t hi = k >= words && k - words < size ? limbs[k - words] : 0;
+            uint32_t lo =
+                k >= words + 1 && k - words - 1 < size ? limbs[k - words - 1] : 0;
+            limbs[k] = rest ? (hi << rest) | (lo >> (32 - rest)) : hi;
+        }
+        size += words + 1;
+        while (size && !limbs[size - 1]) --size;
+        return true;
+    }
+    constexpr void shiftRightOne()
+    {
+        for (size_t k = 0; k < size; ++k)
+            limbs[k] = (limbs[k] >> 1) |
+                       (k + 1 < size ? limbs[k + 1] << 31 : uint32_t(0));
+        while (size && !limbs[size - 1]) --size;
+    }
+    constexpr bool less(const StaticBigInt& b) const
+    {
+        if (size != b.size) return size < b.size;
+        for (size_t k = size; k-- > 0;)
+            if (limbs[k] != b.limbs[k]) return limbs[k] < b.limbs[k];
+        return false;
+    }
+    // b not above *this.
+    constexpr void subtract(const StaticBigInt& b)
+    {
+        int64_t borrow = 0;
+        for (size_t k = 0; k < size; ++k)
+        {
+            int64_t v = int64_t(limbs[k]) - (k < b.size ? b.limbs[k] : 0) -
+                        borrow;
+            borrow = v < 0;
+            limbs[k] = static_cast<uint32_t>(v + (borrow << 32));
+        }
+        while (size && !limbs[size - 1]) --size;
+    }
+};
+
+#ifdef EVAL_DECIMAL_OPERAND
+// digits * 10 ^ exponent rounded to nearest, ties to even, subnormals
+// included, as strtold rounds the literals of TokenList. Fails on overflow.
+constexpr bool roundDecimal(std::string_view digits, int64_t exponent,
+                            decimal_t& value)
+{
+    using limits = std::numeric_limits<decimal_t>;
+    constexpr int mantissa = limits::digits;
+    constexpr int64_t minExponent = limits::min_exponent - 1;
+    constexpr int64_t maxExponent = limits::max_exponent - 1;
+    size_t first = 0, last = digits.size();
+    while (first < last && digits[first] == '0') ++first;
+    while (last > first && digits[last - 1] == '0')
+    {
+        --last;
+        ++exponent;
+    }
+    value = 0;
+    if (first == last) return true;
+    int64_t magnitude = static_cast<int64_t>(last - first) + exponent;
+    if (magnitude > limits::max_exponent10 + 1) return false;
+    if (magnitude < limits::min_exponent10 - limits::digits10 - 3) return true;
+
+    // Digits and a power of 10 both exact in decimal_t take a single,
+    // correctly rounded operation: 5 ^ k stays below 2 ^ mantissa.
+    constexpr int64_t exactPower = mantissa * 43 / 100;
+    if (last - first <= static_cast<size_t>(limits::digits10) &&
+        -exactPower <= exponent && exponent <= exactPower)
+    {
+        decimal_t d = 0, p = 1;
+        for (size_t i = first; i < last; ++i) d = d * 10 + (digits[i] - '0');
+        for (int64_t k = exponent < 0 ? -exponent : exponent; k; --k) p *= 10;
+        value = exponent < 0 ? d / p : d * p;
+        return true;
+    }
+
+    // The value as wide * 2 ^ scale, sticky for a remainder below it.
+    StaticBigInt wide, divisor;
+    int64_t scale = 0;
+    bool sticky = false;
+    for (size_t i = first; i < last; ++i)
+        if (!wide.mulAdd(10, static_cast<uint32_t>(digits[i] - '0')))
+            return false;
+    // 10 ^ k = 5 ^ k * 2 ^ k, the power of 2 going to scale.
+    auto power = [](StaticBigInt& n, int64_t k)
+    {
+        for (; k >= 13; k -= 13)
+            if (!n.mulAdd(1220703125u, 0)) return false;
+        for (; k > 0; --k)
+            if (!n.mulAdd(5, 0)) return false;
+        return true;
+    };
+    scale = exponent;
+    if (exponent >= 0)
+    {
+        if (!power(wide, exponent)) return false;
+    }
+    else
+    {
+        divisor.limbs[0] = 1;
+        divisor.size = 1;
+        if (!power(divisor, -exponent)) return false;
+        int64_t shift = mantissa + 2 + static_cast<int64_t>(divisor.bits()) -
+                        static_cast<int64_t>(wide.bits());
+        if (shift < 0) shift = 0;
+        if (!wide.shiftLeft(static_cast<size_t>(shift))) return false;
+        scale -= shift;
+        // Long division, bit by bit from the top of the quotient.
+        StaticBigInt quotient;
+        size_t top = wide.bits() - divisor.bits();
+        if (!divisor.shiftLeft(top)) return false;
+        for (size_t i = top + 1; i-- > 0;)
+        {
+            if (!wide.less(divisor))
+            {
+                wide.subtract(divisor);
+                quotient.setBit(i);
+            }
+            divisor.shiftRightOne();
+        }
+        sticky = !wide.zero();
+        wide = quotient;
+    }
+
+    int64_t length = static_cast<int64_t>(wide.bits());
+    int64_t leading = scale + length - 1;
+    int64_t keep = mantissa;
+    if (leading < minExponent) keep -= minExponent - leading;
+    if (keep < 0) return true;
+    int64_t drop = length - keep;
+    uint64_t m = 0;
+    if (drop <= 0)
+    {
+        for (int64_t i = length; i-- > 0;) m = m << 1 | wide.bit(size_t(i));
+    }
+    else
+    {
+        for (int64_t i = length; i-- > drop;) m = m << 1 | wide.bit(size_t(i));
+        bool half = wide.bit(size_t(drop - 1));
+        bool rest = sticky || wide.anyBelow(size_t(drop - 1));
+        scale += drop;
+        if (half && (rest || (m & 1)))
+        {
+            ++m;
+            // A carry out of 64 bits.
+            if (!m)
+            {
+                m = uint64_t(1) << 63;
+                ++scale;
+            }
+        }
+    }
+    if (!m) return true;
+    int64_t bits = 0;
+    for (uint64_t t = m; t; t >>= 1) ++bits;
+    if (scale + bits - 1 > maxExponent) return false;
+    value = static_cast<decimal_t>(m);
+    for (; scale >= 32; scale -= 32) value *= decimal_t(4294967296.0);
+    for (; scale > 0; --scale) value *= 2;
+    for (; scale <= -32; scale += 32) value /= decimal_t(4294967296.0);
+    for (; scale < 0; ++scale) value /= 2;
+    return true;
+}
+#endif
+
+enum class StaticNodeType
+{
+    CONST,
+    PARAM,
+    NEG,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    POW,
+    CALL,
+};
+
+struct StaticNode
+{
+    StaticNodeType type = StaticNodeType::CONST;
+    StaticFunc func = StaticFunc::NONE;
+    operand_t value = operand_zero;
+    size_t param = 0;
+    // The operands, or for a call the first argument in StaticProgram::args
+    // and the count.
+    size_t args[2] = {};
+    size_t position = 0;  // of the operator token
+};
+
+// The parse of a literal, nodes after their operands.
+struct StaticProgram
+{
+    StaticNode nodes[maxStaticTokens] = {};
+    size_t nodeCount = 0;
+    size_t args[maxStaticTokens] = {};
+    size_t argCount = 0;
+    std::string_view parameters[maxStaticParameters] = {};
+    size_t parameterCount = 0;
+    size_t root = 0;
+    bool ok = true;
+    EVAL_EXCEPTION error = EVAL_INVALID_EXPR;
+    size_t position = noPosition;
+};
+
+// TokenList::tryParse and Context::evalExpr, at compile time.
+class StaticParser
+{
+   public:
+    StaticProgram program;
+
+    constexpr explicit StaticParser(std::string_view text) : text(text) {}
+
+    constexpr void parse()
+    {
+        if (!tokenize() || !match()) return;
+        size_t body = 0;
+        if (!define(body)) return;
+        for (size_t i = body; i < count; ++i)
+            if (tokens[i].type == TokenType::EQ)
+            {
+                fail(EVAL_INVALID_EXPR, i);
+                return;
+            }
+        program.root = build(body, count, 0);
+    }
+
+   protected:
+    struct Tok
+    {
+        TokenType type = TokenType::NONE;
+        std::string_view text;
+        operand_t value = operand_zero;
+        size_t match = 0;  // of a parenthesis
+    };
+
+    std::string_view text;
+    Tok tokens[maxStaticTokens] = {};
+    size_t count = 0;
+    bool defined = false;
+
+    constexpr size_t fail(EVAL_EXCEPTION error, size_t position)
+    {
+        if (program.ok)
+        {
+            program.ok = false;
+            program.error = error;
+            program.position = position;
+        }
+        return staticNone;
+    }
+
+    constexpr char at(size_t i) const { return i < text.size() ? text[i] : 0; }
+
+    // The operand at i, as TokenList::parseOperand reads it.
+    constexpr bool operand(size_t& i, Tok& t)
+    {
+        size_t start = i;
+#ifdef EVAL_DECIMAL_OPERAND
+        if (TokenList::isDigitNonZero(at(i)))
+            while (TokenList::isDigit(at(i))) ++i;
+        else
+            ++i;
+        size_t point = i, fraction = i;
+        if (at(i) == '.')
+        {
+            fraction = ++i;
+            while (TokenList::isDigit(at(i))) ++i;
+        }
+        size_t digitsEnd = i;
+        int64_t exponent = 0;
+        if (at(i) == 'e' || at(i) == 'E')
+        {
+            ++i;
+            bool negative = at(i) == '-';
+            if (at(i) == '+' || at(i) == '-') ++i;
+            if (!TokenList::isDigit(at(i)))
+            {
+                fail(EVAL_PARSE_FAILED, count);
+                return false;
+            }
+            for (; TokenList::isDigit(at(i)); ++i)
+                if (exponent < 1000000) exponent = exponent * 10 + (at(i) - '0');
+            if (negative) exponent = -exponent;
+        }
+        // The digits without the point.
+        char digits[maxStaticTokens] = {};
+        size_t n = 0;
+        for (size_t k = start; k < digitsEnd; ++k)
+        {
+            if (k == point) continue;
+            if (n == maxStaticTokens)
+            {
+                fail(EVAL_OPERAND_OVERFLOW, count);
+                return false;
+            }
+            digits[n++] = text[k];
+        }
+        exponent -= static_cast<int64_t>(digitsEnd - fraction);
+        decimal_t d = 0;
+        if (!roundDecimal(std::string_view(digits, n), exponent, d))
+        {
+            fail(EVAL_OPERAND_OVERFLOW, count);
+            return false;
+        }
+        t.value = d;
+#ifdef EVAL_MIXED_OPERAND
+        // Integer literals that fit are exact, as in TokenList.
+        if (i - start <= 19 && digitsEnd == i && point == i)
+        {
+            uint64_t v = 0;
+            for (size_t k = start; k < i; ++k)
+                v = v * 10 + static_cast<uint64_t>(text[k] - '0');
+            t.value = v;
+        }
+#endif
+#else
+        int64_t v = 0;
+        for (; TokenList::isDigit(at(i)); ++i)
+        {
+            v = v * 10 + (at(i) - '0');
+            if (v > std::numeric_limits<int_t>::max())
+            {
+                fail(EVAL_OPERAND_OVERFLOW, count);
+                return false;
+            }
+        }
+        t.value = static_cast<operand_t>(v);
+#endif
+        t.type = TokenType::OPERAND;
+        t.text = text.substr(start, i - start);
+        return true;
+    }
+
+    constexpr bool tokenize()
+    {
+        size_t i = 0;
+        while (TokenList::isSpace(at(i))) ++i;
+        while (i < text.size())
+        {
+            if (count == maxStaticTokens)
+            {
+                fail(EVAL_PARSE_FAILED, count);
+                return false;
+            }
+            Tok& t = tokens[count];
+            char c = at(i);
+            if (TokenList::isDigit(c))
+            {
+                if (!operand(i, t)) return false;
+            }
+            else if (TokenList::operatorType(c) != TokenType::NONE)
+            {
+                t.type = TokenList::operatorType(c);
+                t.text = text.substr(i++, 1);
+            }
+            else if (TokenList::isSymbolStart(c))
+            {
+                size_t start = i;
+                while (TokenList::isSymbol(at(i))) ++i;
+                t.type = TokenType::SYMBOL;
+                t.text = text.substr(start, i - start);
+            }
+            else
+            {
+                fail(EVAL_PARSE_FAILED, count);
+                return false;
+            }
+            ++count;
+            while (TokenList::isSpace(at(i))) ++i;
+        }
+        return true;
+    }
+
+    // Matches the parentheses as TokenList::buildIndex does.
+    constexpr bool match()
+    {
+        size_t open[maxStaticTokens] = {};
+        size_t depth = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (tokens[i].type == TokenType::LPAREN)
+                open[depth++] = i;
+            else if (tokens[i].type == TokenType::RPAREN)
+            {
+                if (!depth)
+                {
+                    fail(EVAL_PAREN_MISMATCH, i);
+                    return false;
+                }
+                tokens[open[--depth]].match = i;
+                tokens[i].match = open[depth];
+            }
+        }
+        if (depth)
+        {
+            fail(EVAL_PAREN_MISMATCH, open[depth - 1]);
+            return false;
+        }
+        return true;
+    }
+
+    // The parameters of "f(a, b) = body", found as Context::tryDefFunc does.
+    constexpr bool define(size_t& body)
+    {
+        if (count < 6 || tokens[0].type != TokenType::SYMBOL ||
+            tokens[1].type != TokenType::LPAREN)
+            return true;
+        size_t rParen = 0;
+        for (size_t i = 3; i + 1 < count && !rParen; ++i)
+            if (tokens[i].type == TokenType::RPAREN &&
+                tokens[i + 1].type == TokenType::EQ)
+                rParen = i;
+        if (!rParen) return true;
+        for (size_t i = 2; i < rParen; i += 2)
+        {
+            if (tokens[i].type != TokenType::SYMBOL)
+                return fail(EVAL_UNEXPECTED_TOKEN_TYPE, i), false;
+            if (parameter(tokens[i].text) != program.parameterCount)
+                return fail(EVAL_REPEATED_PARAMETER_NAME, i), false;
+            if (!addParameter(tokens[i].text, i)) return false;
+            if (i + 1 < rParen && tokens[i + 1].type != TokenType::COMMA)
+                return fail(EVAL_UNEXPECTED_TOKEN_TYPE, i + 1), false;
+        }
+        defined = true;
+        body = rParen + 2;
+        return true;
+    }
+
+    constexpr size_t parameter(std::string_view name) const
+    {
+        for (size_t i = 0; i < program.parameterCount; ++i)
+            if (program.parameters[i] == name) return i;
+        return program.parameterCount;
+    }
+
+    constexpr bool addParameter(std::string_view name, size_t position)
+    {
+        if (program.parameterCount == maxStaticParameters)
+            return fail(EVAL_WRONG_NUMBER_OF_ARGS, position), false;
+        program.parameters[program.parameterCount++] = name;
+        return true;
+    }
+
+    constexpr size_t push(const StaticNode& node)
+    {
+        program.nodes[program.nodeCount] = node;
+        return program.nodeCount++;
+    }
+
+    constexpr bool isNeg(size_t beg, size_t i) const
+    {
+        if (tokens[i].type != TokenType::SUB) return false;
+        if (i == beg) return true;
+        TokenType pre = tokens[i - 1].type;
+        return pre != TokenType::OPERAND && pre != TokenType::SYMBOL &&
+               pre != TokenType::RPAREN;
+    }
+
+    // See findMainOperator.
+    constexpr size_t mainOperator(size_t beg, size_t end,
+                                  size_t& unmatched) const
+    {
+        unmatched = end;
+        if (tokens[beg].type == TokenType::SUB)
+        {
+            int inParen = 0;
+            size_t main = end;
+            for (size_t i = beg + 1; i != end; ++i)
+            {
+                TokenType ty = tokens[i].type;
+                if (ty == TokenType::LPAREN)
+                    ++inParen;
+                else if (ty == TokenType::RPAREN)
+                    --inParen;
+                else if (!inParen &&
+                         (ty == TokenType::ADD || ty == TokenType::SUB))
+                    main = i;
+            }
+            if (main != end) return main;
+            if (inParen) unmatched = beg;
+            return beg;
+        }
+        int minPre = 4;
+        size_t main = end;
+        for (size_t i = beg; i != end; ++i)
+        {
+            if (tokens[i].type == TokenType::LPAREN)
+            {
+                if (tokens[i].match >= end)
+                {
+                    unmatched = i;
+                    return end;
+                }
+                i = tokens[i].match;
+                continue;
+            }
+            int pre = getOperatorPrecedence(tokens[i].type);
+            if (pre && !isNeg(beg, i) && pre <= minPre)
+            {
+                minPre = pre;
+                main = i;
+            }
+        }
+        return main;
+    }
+
+    // See findArgSep.
+    constexpr size_t argSep(size_t beg, size_t end) const
+    {
+        for (size_t i = beg; i != end; ++i)
+        {
+            if (tokens[i].type == TokenType::LPAREN)
+                i = tokens[i].match < end ? tokens[i].match : end - 1;
+            else if (tokens[i].type == TokenType::RPAREN ||
+                     tokens[i].type == TokenType::COMMA)
+                return i;
+        }
+        return end;
+    }
+
+    constexpr size_t symbol(size_t i)
+    {
+        std::string_view name = tokens[i].text;
+        size_t p = parameter(name);
+        StaticNode node;
+        if (p != program.parameterCount)
+        {
+            node.type = StaticNodeType::PARAM;
+            node.param = p;
+            return push(node);
+        }
+#ifdef EVAL_DECIMAL_OPERAND
+        // As in Context::defineMath.
+        if (name == "pi" || name == "e")
+        {
+            node.value = name == "pi" ? 3.14159265358979323846264338328
+                                      : 2.71828182845904523536028747135;
+            return push(node);
+        }
+#endif
+        if (defined || findStaticFunc(name) || isStaticReserved(name))
+            return fail(EVAL_UNDEFINED_SYMBOL, i);
+        if (!addParameter(name, i)) return staticNone;
+        node.type = StaticNodeType::PARAM;
+        node.param = program.parameterCount - 1;
+        return push(node);
+    }
+
+    constexpr size_t build(size_t beg, size_t end, unsigned int depth)
+    {
+        if (beg >= end) return fail(EVAL_INVALID_EXPR, beg);
+        if (depth > maxStaticDepth) return fail(EVAL_STACK_OVERFLOW, beg);
+        const Tok& first = tokens[beg];
+        if (beg + 1 == end)
+        {
+            if (first.type == TokenType::OPERAND)
+            {
+                StaticNode node;
+                node.value = first.value;
+                return push(node);
+            }
+            if (first.type != TokenType::SYMBOL)
+                return fail(EVAL_INVALID_EXPR, beg);
+            return symbol(beg);
+        }
+
+        size_t unmatched = end;
+        size_t main = mainOperator(beg, end, unmatched);
+        if (unmatched != end) return fail(EVAL_PAREN_MISMATCH, unmatched);
+        StaticNode node;
+        node.position = main;
+        if (main == beg && first.type == TokenType::SUB)
+        {
+            node.type = StaticNodeType::NEG;
+            node.args[0] = build(beg + 1, end, depth + 1);
+            if (!program.ok) return staticNone;
+            return push(node);
+        }
+        if (main != end)
+        {
+            switch (tokens[main].type)
+            {
+                case TokenType::ADD:
+                    node.type = StaticNodeType::ADD;
+                    break;
+                case TokenType::SUB:
+                    node.type = StaticNodeType::SUB;
+                    break;
+                case TokenType::MUL:
+                    node.type = StaticNodeType::MUL;
+                    break;
+                case TokenType::DIV:
+                    node.type = StaticNodeType::DIV;
+                    break;
+                default:
+                    node.type = StaticNodeType::POW;
+                    break;
+            }
+            node.args[0] = build(beg, main, depth + 1);
+            node.args[1] = build(main + 1, end, depth + 1);
+            if (!program.ok) return staticNone;
+            return push(node);
+        }
+        if (first.type == TokenType::LPAREN)
+        {
+            if (tokens[end - 1].type != TokenType::RPAREN)
+                return fail(EVAL_PAREN_MISMATCH, beg);
+            return build(beg + 1, end - 1, depth + 1);
+        }
+        if (first.type != TokenType::SYMBOL)
+            return fail(EVAL_UNEXPECTED_TOKEN_TYPE, beg);
+        return call(beg, end, depth);
+    }
+
+    // name(a, b, ...), arguments split as Function::tryEval does.
+    constexpr size_t call(size_t beg, size_t end, unsigned int depth)
+    {
+        const StaticFuncInfo* f = findStaticFunc(tokens[beg].text);
+        if (!f || parameter(tokens[beg].text) != program.parameterCount)
+            return fail(EVAL_UNDEFINED_SYMBOL, beg);
+        if (tokens[beg + 1].type != TokenType::LPAREN ||
+            tokens[beg + 1].match != end - 1)
+            return fail(EVAL_INVALID_EXPR, beg);
+        size_t args[maxStaticArgs] = {};
+        size_t n = 0;
+        for (size_t start = beg + 2, i = start; i != end; ++i)
+        {
+            i = argSep(start, end);
+            if (n == maxStaticArgs)
+                return fail(EVAL_WRONG_NUMBER_OF_ARGS, beg);
+            args[n++] = build(start, i, depth + 1);
+            if (!program.ok) return staticNone;
+            start = i + 1;
+        }
+        if (f->arity ? n != f->arity : !n)
+            return fail(EVAL_WRONG_NUMBER_OF_ARGS, beg);
+        StaticNode node;
+        node.type = StaticNodeType::CALL;
+        node.func = f->func;
+        node.args[0] = program.argCount;
+        node.args[1] = n;
+        node.position = beg;
+        for (size_t k = 0; k < n; ++k) program.args[program.argCount++] = args[k];
+        return push(node);
+    }
+};
+
+constexpr StaticProgram parseStatic(std::string_view text)
+{
+    StaticParser parser(text);
+    parser.parse();
+    return parser.program;
+}
+
+template <size_t N>
+constexpr std::array<std::string_view, N> staticParameters(
+    const StaticProgram& program)
+{
+    std::array<std::string_view, N> names{};
+    for (size_t i = 0; i < N; ++i) names[i] = program.parameters[i];
+    return names;
+}
+
+// The importMath functions, written as in Context::defineMath so that the
+// math functions resolve to the same overloads.
+template <StaticFunc F>
+operand_t applyStatic(const operand_t* a, size_t n)
+{
+    if constexpr (F == StaticFunc::EQ) return a[0] == a[1];
+    if constexpr (F == StaticFunc::NEQ) return a[0] != a[1];
+    if constexpr (F == StaticFunc::LEQ) return a[0] <= a[1];
+    if constexpr (F == StaticFunc::LT) return a[0] < a[1];
+    if constexpr (F == StaticFunc::GEQ) return a[0] >= a[1];
+    if constexpr (F == StaticFunc::GT) return a[0] > a[1];
+#ifdef EVAL_DECIMAL_OPERAND
+    if constexpr (F == StaticFunc::LN) return log(a[0]);
+    if constexpr (F == StaticFunc::LG) return log10(a[0]);
+    if constexpr (F == StaticFunc::LOG) return log(a[1]) / log(a[0]);
+    if constexpr (F == StaticFunc::SIN) return sin(a[0]);
+    if constexpr (F == StaticFunc::COS) return cos(a[0]);
+    if constexpr (F == StaticFunc::TAN) return tan(a[0]);
+    if constexpr (F == StaticFunc::ASIN) return asin(a[0]);
+    if constexpr (F == StaticFunc::ACOS) return acos(a[0]);
+    if constexpr (F == StaticFunc::ATAN) return atan(a[0]);
+    if constexpr (F == StaticFunc::GAMMA) return tgamma(a[0]);
+#ifdef EVAL_MIXED_OPERAND
+    if constexpr (F == StaticFunc::FLOOR) return Number::integer(floor(a[0]));
+    if constexpr (F == StaticFunc::CEIL) return Number::integer(ceil(a[0]));
+#else
+    if constexpr (F == StaticFunc::FLOOR) return floor(a[0]);
+    if constexpr (F == StaticFunc::CEIL) return ceil(a[0]);
+#endif
+    if constexpr (F == StaticFunc::EXP) return exp(a[0]);
+    if constexpr (F == StaticFunc::ERF) return erf(a[0]);
+#endif
+#if defined(EVAL_MIXED_OPERAND)
+    if constexpr (F == StaticFunc::ABS) return a[0] < 0 ? -a[0] : a[0];
+#elif defined(EVAL_DECIMAL_OPERAND)
+    if constexpr (F == StaticFunc::ABS) return fabs(a[0]);
+#else
+    if constexpr (F == StaticFunc::ABS) return abs(a[0]);
+#endif
+    if constexpr (F == StaticFunc::MAX || F == StaticFunc::MIN)
+    {
+        operand_t m = a[0];
+        for (size_t i = 0; i < n; ++i)
+            if (F == StaticFunc::MAX ? a[i] > m : a[i] < m) m = a[i];
+        return m;
+    }
+    (void)n;
+    return operand_zero;
+}
+
+template <bool ok, EVAL_EXCEPTION error, size_t token>
+struct StaticCheck
+{
+    static constexpr bool value = true;
+};
+
+// Fails to compile with the message of the error at token.
+template <EVAL_EXCEPTION error, size_t token>
+struct StaticCheck<false, error, token>
+{
+    static_assert(error != EVAL_INVALID_EXPR, "invalid expression");
+    static_assert(error != EVAL_UNDEFINED_SYMBOL, "undefined symbol");
+    static_assert(error != EVAL_PAREN_MISMATCH, "parentheses mismatched");
+    static_assert(error != EVAL_STACK_OVERFLOW, "stack overflow");
+    static_assert(error != EVAL_REPEATED_PARAMETER_NAME,
+                  "repeated parameter name");
+    static_assert(error != EVAL_WRONG_NUMBER_OF_ARGS,
+                  "wrong number of arguments");
+    static_assert(error != EVAL_UNEXPECTED_TOKEN_TYPE,
+                  "unexpected token type");
+    static_assert(error != EVAL_PARSE_FAILED, "parse failed");
+    static_assert(error != EVAL_OPERAND_OVERFLOW, "operand overflow");
+    static constexpr bool value = true;
+};
+}  // namespace detail
+
+// The callable of EVAL_EXPR, Source::text() being the literal. Every node of
+// the parse instantiates its own evaluation, so a call compiles to the
+// operations of the expression and nothing else. Division by zero fails as
+// in Context, at the index of the "/" token.
+template <typename Source>
+class StaticExpr
+{
+   public:
+    static constexpr detail::StaticProgram program =
+        detail::parseStatic(Source::text());
+    static_assert(detail::StaticCheck<program.ok, program.error,
+                                      program.position>::value,
+                  "EVAL_EXPR");
+
+    static constexpr size_t arity = program.parameterCount;
+    // The names of the parameters, by index.
+    static constexpr std::array<std::string_view, arity> parameters =
+        detail::staticParameters<arity>(program);
+
+    // arity when there is no parameter of that name.
+    static constexpr size_t indexOf(std::string_view name)
+    {
+        for (size_t i = 0; i < arity; ++i)
+            if (parameters[i] == name) return i;
+        return arity;
+    }
+
+    // x holds the value of every parameter, by index.
+    Expected<operand_t> tryEval(const operand_t* x) const
+    {
+        size_t failedAt = noPosition;
+        operand_t r = run<program.root>(x, failedAt);
+        if (failedAt != noPosition)
+            return Expected<operand_t>::failure(EVAL_DIV_BY_ZERO, failedAt);
+        return r;
+    }
+
+    template <typename... Args>
+    Expected<operand_t> tryCall(const Args&... args) const
+    {
+        static_assert(!program.ok || sizeof...(Args) == arity,
+                      "wrong number of arguments");
+        const operand_t x[sizeof...(Args) + 1] = {
+            static_cast<operand_t>(args)...};
+        return tryEval(x);
+    }
+
+    template <typename... Args>
+    operand_t operator()(const Args&... args) const
+    {
+        auto r = tryCall(args...);
+        EVAL_THROW(!r, r.error);
+        return r.value;
+    }
+
+   protected:
+    template <size_t I>
+    static operand_t run(const operand_t* x, size_t& failedAt)
+    {
+        using Type = detail::StaticNodeType;
+        constexpr detail::StaticNode node = program.nodes[I];
+        constexpr size_t a = node.args[0], b = node.args[1];
+        if constexpr (node.type == Type::CONST)
+            return node.value;
+        else if constexpr (node.type == Type::PARAM)
+            return x[node.param];
+        else if constexpr (node.type == Type::NEG)
+            return -run<a>(x, failedAt);
+        else if constexpr (node.type == Type::ADD)
+        {
+            operand_t l = run<a>(x, failedAt);
+            return l + run<b>(x, failedAt);
+        }
+        else if constexpr (node.type == Type::SUB)
+        {
+            operand_t l = run<a>(x, failedAt);
+            return l - run<b>(x, failedAt);
+        }
+        else if constexpr (node.type == Type::MUL)
+        {
+            operand_t l = run<a>(x, failedAt);
+            if (l == operand_zero) return operand_zero;
+            return l * run<b>(x, failedAt);
+        }
+        else if constexpr (node.type == Type::DIV)
+        {
+            operand_t denominator = run<b>(x, failedAt);
+            if (denominator == operand_zero)
+            {
+                if (failedAt == noPosition) failedAt = node.position;
+                return operand_zero;
+            }
+            return run<a>(x, failedAt) / denominator;
+        }
+        else if constexpr (node.type == Type::POW)
+        {
+            operand_t l = run<a>(x, failedAt);
+            operand_t r = run<b>(x, failedAt);
+#ifdef EVAL_MIXED_OPERAND
+            return pow(l, r);
+#else
+            return static_cast<operand_t>(std::pow(l, r));
+#endif
+        }
+        else
+            return call<I>(x, failedAt, std::make_index_sequence<b>());
+    }
+
+    template <size_t I, size_t... K>
+    static operand_t call(const operand_t* x, size_t& failedAt,
+                          std::index_sequence<K...>)
+    {
+        constexpr detail::StaticNode node = program.nodes[I];
+        constexpr size_t first = node.args[0];
+        if constexpr (node.func == detail::StaticFunc::IF_ELSE)
+        {
+            // Only the branch taken is evaluated.
+            operand_t c = run<program.args[first]>(x, failedAt);
+            return c != operand_zero ? run<program.args[first + 1]>(x, failedAt)
+                                     : run<program.args[first + 2]>(x, failedAt);
+        }
+        else
+        {
+            const operand_t args[] = {
+                run<program.args[first + K]>(x, failedAt)...};
+            return detail::applyStatic<node.func>(args, sizeof...(K));
+        }
+    }
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef TIERING_H_
+#define TIERING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace eval
+{
+class Expr;
+
+// Custom functions and the bodies of SUM, MUL and the solvers start out in
+// the token interpreter. Once they have run often enough they are compiled
+// to an Expr, which every later run reuses until a function it reaches is
+// redefined. Zero thresholds compile on first use.
+struct TieringPolicy
+{
+    bool enabled = true;
+    uint64_t functionThreshold = 32;  // calls of a custom function
+    uint64_t loopThreshold = 64;      // evaluations of a loop body, all runs
+};
+
+// What tiering did for a custom function or a loop body.
+struct TierProfile
+{
+    uint64_t runs = 0;  // calls, or evaluations of the body
+    uint64_t compiledRuns = 0;
+    uint64_t promotions = 0;
+    // Compiled forms dropped because a function they reach was redefined.
+    uint64_t deoptimizations = 0;
+    // Promotions that did not compile, e.g. of a function calling SUM.
+    // They are retried after another threshold of runs.
+    uint64_t failures = 0;
+    bool promoted = false;
+    size_t nodes = 0;  // of the compiled form
+    // Nodes of the compiled form that repeated subexpressions share instead
+    // of computing again, see Expr.
+    size_t deduplicated = 0;
+};
+
+// Profiles and compiled forms of one context. Compiled forms refer to the
+// functions of the context that compiled them, so copies and forks start
+// with an empty table.
+class TierTable
+{
+   public:
+    struct Entry
+    {
+        TierProfile profile;
+        std::shared_ptr<Expr> code;
+        // The functions the code reaches, with their versions when it was
+        // compiled, and the last version of the context they were checked
+        // at.
+        std::vector<std::pair<std::string, uint64_t>> dependencies;
+        uint64_t checked = 0;
+        uint64_t coldSince = 0;  // runs when it was last made cold
+        std::string text;        // of a loop body
+    };
+
+    std::unordered_map<std::string, Entry> functions;
+    // By normalized body. Bodies of function calls have the arguments in
+    // their text, so the loops that never got hot are dropped at the start
+    // of an exec once there are maxLoops of them.
+    std::unordered_map<std::string, Entry> loops;
+    static constexpr size_t maxLoops = 1024;
+
+    TierTable() = default;
+    TierTable(const TierTable&) {}
+    TierTable& operator=(const TierTable&)
+    {
+        functions.clear();
+        loops.clear();
+        return *this;
+    }
+};
+}  // namespace eval
+
+#endif
\ No newline at end of file
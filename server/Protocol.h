@@ -0,0 +1,89 @@
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+
+#include <unistd.h>
+
+// Every message is a frame: a 4 byte little endian payload length followed
+// by the payload.
+//   request:  u32 id, expression or definition text
+//   response: u32 id, u8 status, text
+// Status 0 means the text is the value; otherwise it is EVAL_EXCEPTION + 1
+// and the text is the error message. Ids are chosen by the client and only
+// serve to match responses, which may come back in any order.
+namespace protocol
+{
+constexpr uint32_t maxFrame = 1 << 20;
+
+inline void putU32(std::string &s, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        s.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+inline uint32_t getU32(const char *p)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i]))
+             << (8 * i);
+    return v;
+}
+
+inline bool readFull(int fd, char *buf, size_t n)
+{
+    while (n)
+    {
+        ssize_t r = ::read(fd, buf, n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        buf += r;
+        n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+inline bool writeFull(int fd, const char *buf, size_t n)
+{
+    while (n)
+    {
+        ssize_t r = ::write(fd, buf, n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        buf += r;
+        n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+inline bool readFrame(int fd, std::string &payload)
+{
+    char header[4];
+    if (!readFull(fd, header, 4))
+        return false;
+    uint32_t len = getU32(header);
+    if (len > maxFrame)
+        return false;
+    payload.resize(len);
+    return readFull(fd, &payload[0], len);
+}
+
+// The caller serializes writes to the same descriptor.
+inline bool writeFrame(int fd, const std::string &payload)
+{
+    std::string frame;
+    frame.reserve(payload.size() + 4);
+    putU32(frame, static_cast<uint32_t>(payload.size()));
+    frame += payload;
+    return writeFull(fd, frame.data(), frame.size());
+}
+} // namespace protocol
+
+#endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Protocol.h"
+
+using Clock = std::chrono::steady_clock;
+
+int connectUnix(const std::string &path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || path.size() >= sizeof(addr.sun_path))
+        return -1;
+    std::strcpy(addr.sun_path, path.c_str());
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void usage()
+{
+    std::cout << "usage: evaluator_loadgen --socket PATH [--requests N] "
+                 "[--depth D] [EXPR]...\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::string socketPath;
+    size_t total = 10000, depth = 64;
+    std::vector<std::string> exprs;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--socket" && hasValue)
+            socketPath = argv[++i];
+        else if (arg == "--requests" && hasValue)
+            total = std::stoul(argv[++i]);
+        else if (arg == "--depth" && hasValue)
+            depth = std::max<size_t>(1, std::stoul(argv[++i]));
+        else if (arg.substr(0, 2) == "--")
+        {
+            usage();
+            return 1;
+        }
+        else
+            exprs.push_back(arg);
+    }
+    if (socketPath.empty())
+    {
+        usage();
+        return 1;
+    }
+    if (exprs.empty())
+        exprs.push_back("1+2*3");
+
+    int fd = connectUnix(socketPath);
+    if (fd < 0)
+    {
+        std::cerr << "failed to connect to " << socketPath << '\n';
+        return 1;
+    }
+
+    // At most depth requests are in flight; the receiver opens the window.
+    std::vector<Clock::time_point> sent(total);
+    std::vector<double> latency(total);
+    std::vector<char> answered(total);
+    std::mutex windowMutex;
+    std::condition_variable windowCv;
+    size_t inFlight = 0, errors = 0;
+
+    auto begin = Clock::now();
+    std::thread receiver(
+        [&]
+        {
+            std::string payload;
+            for (size_t n = 0; n < total; ++n)
+            {
+                if (!protocol::readFrame(fd, payload) || payload.size() < 5)
+                {
+                    std::cerr << "connection closed after " << n
+                              << " responses\n";
+                    std::exit(1);
+                }
+                uint32_t id = protocol::getU32(payload.data());
+                if (id >= total || answered[id])
+                {
+                    std::cerr << "unexpected response id " << id << '\n';
+                    std::exit(1);
+                }
+                answered[id] = 1;
+                if (payload[4])
+                    ++errors;
+                latency[id] = std::chrono::duration<double, std::micro>(
+                                  Clock::now() - sent[id])
+                                  .count();
+                std::lock_guard<std::mutex> lock(windowMutex);
+                --inFlight;
+                windowCv.notify_one();
+            }
+        });
+
+    std::string payload;
+    for (size_t id = 0; id < total; ++id)
+    {
+        {
+            std::unique_lock<std::mutex> lock(windowMutex);
+            windowCv.wait(lock, [&] { return inFlight < depth; });
+            ++inFlight;
+        }
+        payload.clear();
+        protocol::putU32(payload, static_cast<uint32_t>(id));
+        payload += exprs[id % exprs.size()];
+        sent[id] = Clock::now();
+        protocol::writeFrame(fd, payload);
+    }
+    receiver.join();
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    ::close(fd);
+
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&](double p)
+    {
+        return total ? latency[std::min(total - 1,
+                                        static_cast<size_t>(p * total))]
+                     : 0.0;
+    };
+    std::cout << total << " requests, depth " << depth << ", " << errors
+              << " errors\n"
+              << "throughput " << static_cast<size_t>(total / seconds)
+              << " req/s\n"
+              << "latency us  p50 " << percentile(0.5) << "  p99 "
+              << percentile(0.99) << "  p999 " << percentile(0.999) << '\n';
+    return 0;
+}
\ No newline at end of file
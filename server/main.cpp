@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <evaluator/Context.h>
+#include <evaluator/Format.h>
+
+#include "Protocol.h"
+
+struct Connection
+{
+    int in, out;
+    bool owned;
+    std::mutex writeMutex;
+    // Set once a write failed: the peer is gone, so the connection is shut
+    // down and the replies still queued for it are dropped.
+    std::atomic<bool> broken{false};
+
+    Connection(int i, int o, bool own) : in(i), out(o), owned(own) {}
+    ~Connection()
+    {
+        if (owned)
+            ::close(in);
+    }
+
+    void reply(uint32_t id, uint8_t status, const std::string &text)
+    {
+        std::string payload;
+        protocol::putU32(payload, id);
+        payload.push_back(static_cast<char>(status));
+        payload += text;
+        std::lock_guard<std::mutex> lock(writeMutex);
+        if (broken || protocol::writeFrame(out, payload))
+            return;
+        broken = true;
+        if (owned)
+            ::shutdown(in, SHUT_RDWR);
+    }
+};
+
+struct Request
+{
+    std::shared_ptr<Connection> conn;
+    uint32_t id;
+};
+
+// Requests waiting for the same evaluation.
+struct Group
+{
+    std::string text;
+    std::vector<Request> requests;
+};
+
+class Server
+{
+   protected:
+    // Definitions shared by all requests. Workers evaluate on their own
+    // copy, taken once, to which they then apply the names each definition
+    // changed, in order.
+    eval::Context master;
+    std::shared_mutex masterMutex;
+    std::vector<std::string> defined;
+
+    // Identical deterministic expressions waiting at the same time are
+    // grouped and evaluated once.
+    std::mutex queueMutex;
+    std::condition_variable queueCv;
+    std::unordered_map<std::string, Group> groups;
+    std::deque<std::string> order;
+    uint64_t unique = 0;
+    bool stopping = false;
+
+    std::vector<std::thread> workers;
+
+    // Copies what master now holds under name, so that the copy does not
+    // evaluate the definition again, which could draw rand.
+    void update(eval::Context &local, const std::string &name)
+    {
+        auto copy = [&name](auto &to, const auto &from)
+        {
+            auto ite = from.find(name);
+            if (ite == from.end())
+                to.erase(name);
+            else
+                to[name] = ite->second;
+        };
+        copy(local.varTable, master.varTable);
+        copy(local.funcTable, master.funcTable);
+        copy(local.arrayTable, master.arrayTable);
+        local.touch(name);
+    }
+
+    void work()
+    {
+        eval::Context local;
+        bool copied = false;
+        size_t seen = 0;
+        while (true)
+        {
+            Group group;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCv.wait(lock,
+                             [this] { return stopping || !order.empty(); });
+                if (order.empty())
+                    return;
+                auto ite = groups.find(order.front());
+                group = std::move(ite->second);
+                groups.erase(ite);
+                order.pop_front();
+            }
+            auto &requests = group.requests;
+            requests.erase(std::remove_if(requests.begin(), requests.end(),
+                                          [](const Request &req)
+                                          { return req.conn->broken.load(); }),
+                           requests.end());
+            if (requests.empty())
+                continue;
+            {
+                std::shared_lock<std::shared_mutex> lock(masterMutex);
+                if (!copied)
+                {
+                    // Each worker draws rand from a stream of its own.
+                    local = master;
+                    local.random = master.random.split();
+                    seen = defined.size();
+                    copied = true;
+                }
+                for (; seen < defined.size(); ++seen)
+                    update(local, defined[seen]);
+            }
+            auto r = local.tryEval(group.text);
+            std::string text =
+                r ? eval::toString(r.value) : eval::EVAL_EXCEPTION_MSG[r.error];
+            uint8_t status = r ? 0 : static_cast<uint8_t>(r.error + 1);
+            for (auto &req : requests)
+                req.conn->reply(req.id, status, text);
+        }
+    }
+
+   public:
+    Server(const eval::Budget &budget, const std::vector<std::string> &files,
+           bool math)
+    {
+        master.budget = budget;
+        if (math)
+            master.importMath();
+        for (const auto &path : files)
+        {
+            std::ifstream is(path);
+            if (!is)
+            {
+                std::cerr << "failed to load file " << path << '\n';
+                continue;
+            }
+            std::string line;
+            while (std::getline(is, line))
+            {
+                while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+                    line.pop_back();
+                if (line == "!math")
+                    master.importMath();
+                else if (!line.empty() && line[0] != '!')
+                    master.tryExec(line);
+            }
+        }
+    }
+
+    void start(unsigned int threads)
+    {
+        for (unsigned int i = 0; i < threads; ++i)
+            workers.emplace_back(&Server::work, this);
+    }
+
+    // Answers what is queued, then stops the workers.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCv.notify_all();
+        for (auto &t : workers)
+            t.join();
+        workers.clear();
+    }
+
+    void submit(const std::shared_ptr<Connection> &conn, uint32_t id,
+                std::string text)
+    {
+        auto tkList = eval::TokenList::tryParse(text);
+        if (!tkList)
+        {
+            conn->reply(id, static_cast<uint8_t>(tkList.error + 1),
+                        eval::EVAL_EXCEPTION_MSG[tkList.error]);
+            return;
+        }
+        bool definition = false;
+        for (const auto &t : tkList.value)
+            definition = definition || t.isEq();
+        if (definition)
+        {
+            // Applied before the connection's next request is read.
+            std::unique_lock<std::shared_mutex> lock(masterMutex);
+            auto r = master.tryExec(text);
+            if (r && tkList.value[0].isSymbol())
+                defined.push_back(tkList.value[0].getSymbol());
+            lock.unlock();
+            if (r)
+                conn->reply(id, 0, "");
+            else
+                conn->reply(id, static_cast<uint8_t>(r.error + 1),
+                            eval::EVAL_EXCEPTION_MSG[r.error]);
+            return;
+        }
+
+        bool deterministic;
+        {
+            std::shared_lock<std::shared_mutex> lock(masterMutex);
+            deterministic = master.deterministic(tkList.value);
+        }
+        std::lock_guard<std::mutex> lock(queueMutex);
+        std::string key = text;
+        if (!deterministic)
+            key += '\0' + std::to_string(unique++);
+        auto ite = groups.find(key);
+        if (ite == groups.end())
+        {
+            ite = groups.emplace(key, Group{std::move(text), {}}).first;
+            order.push_back(key);
+            queueCv.notify_one();
+        }
+        ite->second.requests.push_back(Request{conn, id});
+    }
+
+    // Reads requests from conn until it closes.
+    void serve(std::shared_ptr<Connection> conn)
+    {
+        std::string payload;
+        while (!conn->broken && protocol::readFrame(conn->in, payload))
+        {
+            if (payload.size() < 4)
+                break;
+            submit(conn, protocol::getU32(payload.data()), payload.substr(4));
+        }
+    }
+};
+
+int listenUnix(const std::string &path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || path.size() >= sizeof(addr.sun_path))
+        return -1;
+    std::strcpy(addr.sun_path, path.c_str());
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        ::listen(fd, 64) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void usage()
+{
+    std::cout << "usage: evaluator_server (--socket PATH | --stdio) "
+                 "[--threads N] [--math] [--load FILE]... [--timeout MS] "
+                 "[--max-ops N]\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::string socketPath;
+    bool stdio = false, math = false;
+    unsigned int threads = std::thread::hardware_concurrency();
+    std::vector<std::string> files;
+    eval::Budget budget;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--socket" && hasValue)
+            socketPath = argv[++i];
+        else if (arg == "--stdio")
+            stdio = true;
+        else if (arg == "--threads" && hasValue)
+            threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+        else if (arg == "--math")
+            math = true;
+        else if (arg == "--load" && hasValue)
+            files.push_back(argv[++i]);
+        else if (arg == "--timeout" && hasValue)
+            budget.timeout = std::chrono::milliseconds(std::stoll(argv[++i]));
+        else if (arg == "--max-ops" && hasValue)
+            budget.maxOperations = std::stoull(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (stdio == !socketPath.empty())
+    {
+        usage();
+        return 1;
+    }
+    if (!threads)
+        threads = 1;
+    // A client that goes away with replies pending fails their writes
+    // instead of killing the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Server server(budget, files, math);
+    server.start(threads);
+
+    if (stdio)
+    {
+        server.serve(std::make_shared<Connection>(0, 1, false));
+        server.stop();
+        return 0;
+    }
+
+    int fd = listenUnix(socketPath);
+    if (fd < 0)
+    {
+        std::cerr << "failed to listen on " << socketPath << '\n';
+        return 1;
+    }
+    std::cerr << "listening on " << socketPath << " with " << threads
+              << " threads\n";
+    while (true)
+    {
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        std::thread(&Server::serve, &server,
+                    std::make_shared<Connection>(client, client, true))
+            .detach();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,582 @@
+#include <evaluator/Context.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <new>
+#include <string>
+
+namespace eval
+{
+namespace
+{
+using Args = std::vector<const Array*>;
+
+// out = op(l, r) element by element, an array of one element standing for
+// any size. out has the size of the result and may be l or r.
+template <typename Op>
+void broadcast(const Array& l, const Array& r, Array& out, Op op)
+{
+    const operand_t *a = l.data(), *b = r.data();
+    operand_t* o = out.data();
+    size_t n = out.size();
+    if (l.size() == r.size())
+        for (size_t i = 0; i < n; ++i) o[i] = op(a[i], b[i]);
+    else if (r.size() == 1)
+    {
+        operand_t y = b[0];
+        for (size_t i = 0; i < n; ++i) o[i] = op(a[i], y);
+    }
+    else
+    {
+        operand_t x = a[0];
+        for (size_t i = 0; i < n; ++i) o[i] = op(x, b[i]);
+    }
+}
+
+operand_t power(operand_t a, operand_t b)
+{
+#ifdef EVAL_MIXED_OPERAND
+    return pow(a, b);
+#else
+    return static_cast<operand_t>(std::pow(a, b));
+#endif
+}
+
+// The element count n stands for, checked against the memory budget before
+// anything is allocated.
+bool count(Context& context, operand_t n, size_t& size)
+{
+    decimal_t v = static_cast<decimal_t>(n);
+    if (!(v >= 0) || v != std::floor(v))
+    {
+        context.raise(EVAL_INVALID_EXPR);
+        return false;
+    }
+    size_t limit = std::numeric_limits<size_t>::max() / sizeof(operand_t);
+    if (context.budget.maxMemory)
+        limit = context.budget.maxMemory / sizeof(operand_t);
+    if (v > static_cast<decimal_t>(limit))
+    {
+        context.raise(EVAL_MEMORY_LIMIT);
+        return false;
+    }
+    size = static_cast<size_t>(v);
+    return true;
+}
+
+// The scalar arguments of a constructor.
+bool scalars(const Args& args, Context& context, size_t required,
+             size_t optional)
+{
+    if (args.size() < required || args.size() > required + optional)
+    {
+        context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+        return false;
+    }
+    for (auto a : args)
+        if (a->size() != 1)
+        {
+            context.raise(EVAL_NOT_SCALAR);
+            return false;
+        }
+    return true;
+}
+
+// vec(a, ...): the arguments one after the other.
+Array vec(const Args& args, Context&)
+{
+    size_t n = 0;
+    for (auto a : args) n += a->size();
+    Array out;
+    out.reserve(n);
+    for (auto a : args) out.insert(out.end(), a->begin(), a->end());
+    return out;
+}
+
+// linspace(a, b, n): n evenly spaced values from a to b, both included.
+Array linspace(const Args& args, Context& context)
+{
+    size_t n;
+    if (!scalars(args, context, 3, 0) || !count(context, (*args[2])[0], n))
+        return {};
+    operand_t a = (*args[0])[0], b = (*args[1])[0];
+    Array out(n);
+    if (n == 1) out[0] = a;
+    if (n < 2) return out;
+    operand_t step = (b - a) / static_cast<operand_t>(n - 1);
+    for (size_t i = 0; i < n; ++i) out[i] = a + step * static_cast<operand_t>(i);
+    out[n - 1] = b;
+    return out;
+}
+
+// range(a, b[, step]): a, a + step, ... up to b, excluded, as for SUM.
+Array range(const Args& args, Context& context)
+{
+    if (!scalars(args, context, 2, 1)) return {};
+    operand_t a = (*args[0])[0], b = (*args[1])[0];
+    operand_t step = args.size() > 2 ? (*args[2])[0] : operand_one;
+    if (step == operand_zero)
+    {
+        context.raise(EVAL_INFINITE_LOOP);
+        return {};
+    }
+    decimal_t steps = std::ceil(static_cast<decimal_t>(b - a) /
+                                static_cast<decimal_t>(step));
+    size_t n;
+    if (!count(context, std::max<decimal_t>(steps, 0), n)) return {};
+    Array out(n);
+    for (size_t i = 0; i < n; ++i)
+        out[i] = a + step * static_cast<operand_t>(i);
+    return out;
+}
+
+// at(v, i): the element of v at index i, counting from 0, or the elements
+// at each index of an array i.
+Array at(const Args& args, Context& context)
+{
+    if (args.size() != 2)
+    {
+        context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+        return {};
+    }
+    const Array &v = *args[0], &index = *args[1];
+    Array out(index.size());
+    for (size_t k = 0; k < out.size(); ++k)
+    {
+        decimal_t i = static_cast<decimal_t>(index[k]);
+        if (!(i >= 0) || i != std::floor(i) ||
+            i >= static_cast<decimal_t>(v.size()))
+        {
+            context.raise(EVAL_INDEX_OUT_OF_RANGE);
+            return {};
+        }
+        out[k] = v[static_cast<size_t>(i)];
+    }
+    return out;
+}
+
+// Reductions run over the elements of all their arguments.
+Array sum(const Args& args, Context&)
+{
+    operand_t s = operand_zero;
+    for (auto a : args)
+        for (auto x : *a) s += x;
+    return {s};
+}
+
+Array prod(const Args& args, Context&)
+{
+    operand_t p = operand_one;
+    for (auto a : args)
+        for (auto x : *a) p *= x;
+    return {p};
+}
+
+Array len(const Args& args, Context&)
+{
+    size_t n = 0;
+    for (auto a : args) n += a->size();
+    return {static_cast<operand_t>(n)};
+}
+
+Array mean(const Args& args, Context& context)
+{
+    size_t n = 0;
+    for (auto a : args) n += a->size();
+    if (!n)
+    {
+        context.raise(EVAL_DIV_BY_ZERO);
+        return {};
+    }
+    return {sum(args, context)[0] / static_cast<operand_t>(n)};
+}
+
+template <bool greater>
+Array extremum(const Args& args, Context& context)
+{
+    const operand_t* m = nullptr;
+    for (auto a : args)
+        for (const auto& x : *a)
+            if (!m || (greater ? x > *m : x < *m)) m = &x;
+    if (!m)
+    {
+        context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+        return {};
+    }
+    return {*m};
+}
+
+// dot(u, v): the sum of the products of the elements of u and v.
+Array dot(const Args& args, Context& context)
+{
+    if (args.size() != 2)
+    {
+        context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+        return {};
+    }
+    const Array &u = *args[0], &v = *args[1];
+    if (u.size() != v.size())
+    {
+        context.raise(EVAL_SIZE_MISMATCH);
+        return {};
+    }
+    operand_t s = operand_zero;
+    for (size_t i = 0; i < u.size(); ++i) s += u[i] * v[i];
+    return {s};
+}
+}  // namespace
+
+Expected<Array> Context::tryEvalArray(const TokenList::const_iterator& beg,
+                                      const TokenList::const_iterator& end)
+{
+    if (beg >= end)
+        return Expected<Array>::failure(fail(EVAL_INVALID_EXPR, beg));
+    if (depth > maxRecursionDepth)
+        return Expected<Array>::failure(fail(EVAL_STACK_OVERFLOW, beg));
+    ++stats.operations;
+    ++depth;
+    auto r = evalArrayOperation(beg, end);
+    --depth;
+    return r;
+}
+
+bool Context::involvesArrays(const TokenList::const_iterator& beg,
+                             const TokenList::const_iterator& end) const
+{
+    // Custom functions can read array variables in their bodies.
+    std::vector<std::pair<TokenList::const_iterator, TokenList::const_iterator>>
+        pending{{beg, end}};
+    std::unordered_map<std::string, bool> seen;
+    while (!pending.empty())
+    {
+        auto range = pending.back();
+        pending.pop_back();
+        for (auto ite = range.first; ite != range.second; ++ite)
+        {
+            if (!ite->isSymbol() || !seen.emplace(ite->getSymbol(), true).second)
+                continue;
+            const std::string& name = ite->getSymbol();
+            if (findArray(name)) return true;
+            const Function* f = findFunc(name);
+            if (!f && findArrayFunc(name)) return true;
+            if (f && f->type == FuncType::CUSTOM)
+                pending.emplace_back(f->tkList.begin(), f->tkList.end());
+        }
+    }
+    return false;
+}
+
+Expected<Array> Context::evalArrayOperation(
+    const TokenList::const_iterator& beg, const TokenList::const_iterator& end)
+{
+    using Result = Expected<Array>;
+#define EVAL_TRY(var, expr) \
+    auto var = expr;        \
+    if (!var) return var
+    // Each element costs an operation, as it would evaluated one at a time.
+#define EVAL_COUNT(n, ite)                                             \
+    do                                                                 \
+    {                                                                  \
+        EVAL_EXCEPTION code;                                           \
+        stats.operations += (n);                                       \
+        if (overBudget(code)) return Result::failure(fail(code, ite)); \
+    } while (0)
+
+    // An array variable in [b, e), read in place rather than copied.
+    auto variable = [this](const TokenList::const_iterator& b,
+                           const TokenList::const_iterator& e) -> const Array*
+    {
+        if (b + 1 != e || !b->isSymbol()) return nullptr;
+        for (const Context* c = this; c; c = c->parent)
+        {
+            if (c->varTable.count(b->getSymbol())) return nullptr;
+            auto a = c->arrayTable.find(b->getSymbol());
+            if (a != c->arrayTable.end()) return &a->second;
+        }
+        return nullptr;
+    };
+
+    if (beg + 1 == end)  // "1", "x"
+    {
+        if (beg->isOperand()) return Result(Array{beg->getOperand()});
+        if (!beg->isSymbol())
+            return Result::failure(fail(EVAL_INVALID_EXPR, beg));
+        const std::string& name = beg->getSymbol();
+        for (const Context* c = this; c; c = c->parent)
+        {
+            auto v = c->varTable.find(name);
+            if (v != c->varTable.end()) return Result(Array{v->second});
+            auto a = c->arrayTable.find(name);
+            if (a != c->arrayTable.end()) return Result(a->second);
+        }
+        if (const operand_t* v = findVar(name)) return Result(Array{*v});  // pi
+        return Result::failure(fail(EVAL_UNDEFINED_SYMBOL, beg));
+    }
+    auto split = splitOperation(beg, end);
+    if (!split) return Result::failure(split);
+    auto op = split.value;
+    if (op == beg && beg->isSub())
+    {
+        EVAL_TRY(r, tryEvalArray(beg + 1, end));
+        for (auto& x : r.value) x = -x;
+        EVAL_COUNT(r.value.size(), beg);
+        return r;
+    }
+    if (op != end)
+    {
+        // The result goes to an intermediate operand of its size when there
+        // is one.
+        Array lt, rt, out;
+        const Array *l = variable(beg, op), *r = variable(op + 1, end);
+        if (op->type == TokenType::DIV)  // the denominator first, as for scalars
+        {
+            if (!r)
+            {
+                EVAL_TRY(v, tryEvalArray(op + 1, end));
+                rt = std::move(v.value);
+                r = &rt;
+            }
+            for (auto x : *r)
+                if (x == operand_zero)
+                    return Result::failure(fail(EVAL_DIV_BY_ZERO, op));
+        }
+        if (!l)
+        {
+            EVAL_TRY(v, tryEvalArray(beg, op));
+            lt = std::move(v.value);
+            l = &lt;
+        }
+        if (!r)
+        {
+            EVAL_TRY(v, tryEvalArray(op + 1, end));
+            rt = std::move(v.value);
+            r = &rt;
+        }
+        size_t n = l->size() == 1 ? r->size() : l->size();
+        if ((l->size() != n && l->size() != 1) ||
+            (r->size() != n && r->size() != 1))
+            return Result::failure(fail(EVAL_SIZE_MISMATCH, op));
+        Array* dst = &out;
+        if (l == &lt && lt.size() == n)
+            dst = &lt;
+        else if (r == &rt && rt.size() == n)
+            dst = &rt;
+        else
+            out.resize(n);
+        switch (op->type)
+        {
+            case TokenType::ADD:
+                broadcast(*l, *r, *dst,
+                          [](operand_t a, operand_t b) { return a + b; });
+                break;
+            case TokenType::SUB:
+                broadcast(*l, *r, *dst,
+                          [](operand_t a, operand_t b) { return a - b; });
+                break;
+            case TokenType::MUL:
+                broadcast(*l, *r, *dst,
+                          [](operand_t a, operand_t b) { return a * b; });
+                break;
+            case TokenType::DIV:
+                broadcast(*l, *r, *dst,
+                          [](operand_t a, operand_t b) { return a / b; });
+                break;
+            case TokenType::POW:
+                broadcast(*l, *r, *dst, power);
+                break;
+            default:
+                return Result::failure(fail(EVAL_INVALID_EXPR, op));
+        }
+        EVAL_COUNT(n, op);
+        return Result(std::move(*dst));
+    }
+    if (beg->isLParen())  // "(v+1)"
+    {
+        if (!(end - 1)->isRParen())
+            return Result::failure(fail(EVAL_PAREN_MISMATCH, beg));
+        return tryEvalArray(beg + 1, end - 1);
+    }
+
+    if (!beg->isSymbol())
+        return Result::failure(fail(EVAL_UNEXPECTED_TOKEN_TYPE, beg));
+    const std::string& name = beg->getSymbol();
+    const Function* f = findFunc(name);
+    const ArrayFunction* af = findArrayFunc(name);
+    if (!f && !af) return Result::failure(fail(EVAL_UNDEFINED_SYMBOL, beg));
+    if (!(end - 1)->isRParen())
+        return Result::failure(fail(EVAL_PAREN_MISMATCH, end - 1));
+    if (f && f->type == FuncType::HIGH_ORDER)
+    {
+        auto r = f->tryEval(*this, beg, end);
+        if (!r && r.position == noPosition)
+            r.position = fail(r.error, beg).position;
+        if (!r) return Result::failure(r);
+        return Result(Array{r.value});
+    }
+
+    EVAL_EXCEPTION code;
+    if (overBudget(code)) return Result::failure(fail(code, beg));
+    ++stats.calls;
+
+    // Every argument as an array, except for the name of a function passed
+    // to a custom function. Array variables are not copied, other than into
+    // the arguments of a custom function.
+    bool custom = f && f->type == FuncType::CUSTOM;
+    std::deque<Array> temps;
+    Args args;
+    TokenList symbols;
+    auto start = beg + 2;
+    for (auto ite = beg + 2; ite != end; ++ite)
+    {
+        ite = findArgSep(start, end);
+        const Array* a = custom ? nullptr : variable(start, ite);
+        if (custom && ite - start == 1 && start->isSymbol() &&
+            !findVar(start->getSymbol()) && !findArray(start->getSymbol()) &&
+            findFunc(start->getSymbol()))
+        {
+            temps.emplace_back();
+            args.push_back(&temps.back());
+            symbols.push_back(*start);
+        }
+        else
+        {
+            if (!a)
+            {
+                EVAL_TRY(r, tryEvalArray(start, ite));
+                temps.push_back(std::move(r.value));
+                a = &temps.back();
+            }
+            args.push_back(a);
+            symbols.emplace_back();
+        }
+        start = ite + 1;
+    }
+
+    if (af && (!f || f->type == FuncType::ORDINARY))
+    {
+        // Reductions shadow the builtins of the same name, max and min.
+        Array out;
+        bool thrown = false;
+        code = EVAL_INVALID_EXPR;
+        ++foreign;
+        try
+        {
+            out = (*af)(args, *this);
+        }
+        catch (const EvalException& e)
+        {
+            thrown = true;
+            code = e.code;
+        }
+        catch (const std::bad_alloc&)
+        {
+            thrown = true;
+            code = EVAL_MEMORY_LIMIT;
+        }
+        --foreign;
+        if (raised)
+        {
+            raised = false;
+            return Result::failure(fail(raisedError, beg));
+        }
+        if (thrown) return Result::failure(fail(code, beg));
+        size_t n = out.size();
+        for (auto a : args) n += a->size();
+        EVAL_COUNT(n, beg);
+        return Result(std::move(out));
+    }
+
+    if (f->type == FuncType::ORDINARY)
+    {
+        if (!f->accepts(args.size()))
+            return Result::failure(fail(EVAL_WRONG_NUMBER_OF_ARGS, beg));
+        size_t n = 1;
+        for (auto a : args)
+            if (a->size() != 1)
+            {
+                if (n != 1 && a->size() != n)
+                    return Result::failure(fail(EVAL_SIZE_MISMATCH, beg));
+                n = a->size();
+            }
+        Array out(n);
+        if (f->batchDefinition && !strictMath && !args.empty())
+        {
+            std::vector<const operand_t*> columns;
+            for (auto a : args)
+            {
+                if (a->size() != n) a = &temps.emplace_back(n, (*a)[0]);
+                columns.push_back(a->data());
+            }
+            f->batchDefinition(columns.data(), out.data(), n, *this);
+            stats.calls += n - 1;
+            EVAL_COUNT(n, beg);
+            return Result(std::move(out));
+        }
+        TokenList tkl;
+        tkl.resize(args.size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < args.size(); ++j)
+                tkl[j] = Token((*args[j])[args[j]->size() == 1 ? 0 : i]);
+            auto r = call(*f, tkl);
+            if (!r) return Result::failure(fail(r.error, beg));
+            out[i] = r.value;
+            if (i && overBudget(code)) return Result::failure(fail(code, beg));
+        }
+        stats.calls += n - 1;
+        EVAL_COUNT(n, beg);
+        return Result(std::move(out));
+    }
+
+    // A custom function reads its array arguments from temporary variables,
+    // named so that no input can refer to them.
+    if (args.size() != f->parameterTable.size())
+        return Result::failure(fail(EVAL_WRONG_NUMBER_OF_ARGS, beg));
+    std::vector<std::string> bound;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (symbols[i].isSymbol()) continue;
+        if (args[i]->size() == 1)
+        {
+            symbols[i] = Token((*args[i])[0]);
+            continue;
+        }
+        std::string temp =
+            '#' + std::to_string(depth) + '.' + std::to_string(i);
+        arrayTable[temp] = std::move(temps[i]);
+        symbols[i] = Token(temp);
+        bound.push_back(std::move(temp));
+    }
+    size_t held = (f->tkList.size() + symbols.size()) * sizeof(Token);
+    allocate(held);
+    TokenList body(f->tkList);
+    f->setArguments(symbols, body);
+    ++foreign;
+    auto r = tryEvalArray(body.begin(), body.end());
+    --foreign;
+    release(held);
+    for (const auto& temp : bound) arrayTable.erase(temp);
+    if (!r && r.position == noPosition)
+        r.position = fail(r.error, beg).position;
+    return r;
+#undef EVAL_COUNT
+#undef EVAL_TRY
+}
+
+void Context::importArrays()
+{
+    arrayFuncTable["vec"] = vec;
+    arrayFuncTable["linspace"] = linspace;
+    arrayFuncTable["range"] = range;
+    arrayFuncTable["at"] = at;
+    arrayFuncTable["len"] = len;
+    arrayFuncTable["sum"] = sum;
+    arrayFuncTable["prod"] = prod;
+    arrayFuncTable["mean"] = mean;
+    arrayFuncTable["max"] = extremum<true>;
+    arrayFuncTable["min"] = extremum<false>;
+    arrayFuncTable["dot"] = dot;
+}
+}  // namespace eval
\ No newline at end of file
@@ -0,0 +1,469 @@
+#include <evaluator/Context.h>
+
+#include <cmath>
+
+namespace eval
+{
+namespace
+{
+constexpr size_t npos = static_cast<size_t>(-1);
+
+// Forward mode: a value and its derivative along one direction.
+struct Dual
+{
+    operand_t v, d;
+};
+
+struct Forward
+{
+    using value_type = Dual;
+
+    Dual constant(operand_t v) { return {v, operand_zero}; }
+    static bool active(const Dual& a) { return a.d != operand_zero; }
+
+    Dual apply(operand_t v, size_t n, const Dual* const* args,
+               const operand_t* partials)
+    {
+        operand_t d = operand_zero;
+        for (size_t i = 0; i < n; ++i)
+            if (active(*args[i])) d += partials[i] * args[i]->d;
+        return {v, d};
+    }
+};
+
+// Reverse mode: a value and the tape entry recording how it was computed,
+// npos for values that do not depend on the inputs.
+struct Var
+{
+    operand_t v;
+    size_t idx;
+};
+
+struct Reverse
+{
+    using value_type = Var;
+
+    struct Entry
+    {
+        size_t first, count;  // edges[first, first + count)
+    };
+    std::vector<Entry> tape;
+    std::vector<std::pair<size_t, operand_t>> edges;
+
+    Var constant(operand_t v) { return {v, npos}; }
+    static bool active(const Var& a) { return a.idx != npos; }
+
+    Var input(operand_t v)
+    {
+        tape.push_back(Entry{edges.size(), 0});
+        return {v, tape.size() - 1};
+    }
+
+    Var apply(operand_t v, size_t n, const Var* const* args,
+              const operand_t* partials)
+    {
+        size_t first = edges.size();
+        for (size_t i = 0; i < n; ++i)
+            if (active(*args[i]) && partials[i] != operand_zero)
+                edges.emplace_back(args[i]->idx, partials[i]);
+        if (edges.size() == first) return constant(v);
+        tape.push_back(Entry{first, edges.size() - first});
+        return {v, tape.size() - 1};
+    }
+
+    std::vector<operand_t> adjoints(const Var& out)
+    {
+        std::vector<operand_t> adj(tape.size(), operand_zero);
+        if (!active(out)) return adj;
+        adj[out.idx] = operand_one;
+        for (size_t k = tape.size(); k-- > 0;)
+        {
+            if (adj[k] == operand_zero) continue;
+            for (size_t e = 0; e < tape[k].count; ++e)
+            {
+                const auto& edge = edges[tape[k].first + e];
+                adj[edge.first] += edge.second * adj[k];
+            }
+        }
+        return adj;
+    }
+};
+
+// Mirrors Context::evalExpr and Function::eval, carrying derivatives along
+// with the values. Arguments of custom functions are bound through frames
+// instead of being substituted into a copy of the body, and the dummy
+// variables of SUM and MUL live in locals instead of varTable.
+template <typename P>
+class Differentiator
+{
+   public:
+    using T = typename P::value_type;
+
+    // An argument: a value, or a function passed by name.
+    struct Arg
+    {
+        T value;
+        std::string name;
+    };
+
+    struct Frame
+    {
+        const TokenList* tokens;
+        std::vector<size_t> slots;  // token offset -> argument index
+        std::vector<Arg> args;
+
+        const Arg* find(const TokenList::const_iterator& ite) const
+        {
+            if (!tokens) return nullptr;
+            size_t i = slots[ite - tokens->begin()];
+            return i == npos ? nullptr : &args[i];
+        }
+    };
+
+    Context& context;
+    P& policy;
+    unsigned int depth = 0;
+    std::vector<std::pair<std::string, T>> locals;
+    // The first error met. Evaluation then unwinds, every value being a
+    // placeholder.
+    bool failed = false;
+    EVAL_EXCEPTION error = EVAL_INVALID_EXPR;
+
+    Differentiator(Context& c, P& p) : context(c), policy(p) {}
+
+    T fail(EVAL_EXCEPTION e)
+    {
+        if (!failed)
+        {
+            failed = true;
+            error = e;
+        }
+        return policy.constant(operand_zero);
+    }
+
+    T op(operand_t v, const T& a, operand_t da)
+    {
+        const T* args[]{&a};
+        return policy.apply(v, 1, args, &da);
+    }
+
+    T op(operand_t v, const T& a, operand_t da, const T& b, operand_t db)
+    {
+        const T* args[]{&a, &b};
+        operand_t partials[]{da, db};
+        return policy.apply(v, 2, args, partials);
+    }
+
+    T symbol(const std::string& name)
+    {
+        for (auto ite = locals.rbegin(); ite != locals.rend(); ++ite)
+            if (ite->first == name) return ite->second;
+        const operand_t* v = context.findVar(name);
+        if (!v) return fail(EVAL_UNDEFINED_SYMBOL);
+        return policy.constant(*v);
+    }
+
+    T eval(const TokenList::const_iterator& beg,
+           const TokenList::const_iterator& end, const Frame& frame)
+    {
+        if (failed) return fail(error);
+        if (beg >= end) return fail(EVAL_INVALID_EXPR);
+        if (beg + 1 == end)
+        {
+            if (auto arg = frame.find(beg))
+            {
+                if (!arg->name.empty()) return fail(EVAL_UNDEFINED_SYMBOL);
+                return arg->value;
+            }
+            if (beg->isOperand()) return policy.constant(beg->getOperand());
+            if (!beg->isSymbol()) return fail(EVAL_INVALID_EXPR);
+            return symbol(beg->getSymbol());
+        }
+
+        TokenList::const_iterator unmatched;
+        auto mainOperatorIte = findMainOperator(beg, end, unmatched);
+        if (unmatched != end) return fail(EVAL_PAREN_MISMATCH);
+        if (mainOperatorIte == beg && beg->isSub())
+        {
+            T a = eval(beg + 1, end, frame);
+            return op(-a.v, a, -operand_one);
+        }
+        if (mainOperatorIte != end)
+            return binary(beg, mainOperatorIte, end, frame);
+        if (beg->isLParen())
+        {
+            if (!(end - 1)->isRParen()) return fail(EVAL_PAREN_MISMATCH);
+            return eval(beg + 1, end - 1, frame);
+        }
+        return call(beg, end, frame);
+    }
+
+    T binary(const TokenList::const_iterator& beg,
+             const TokenList::const_iterator& opIte,
+             const TokenList::const_iterator& end, const Frame& frame)
+    {
+        switch (opIte->type)
+        {
+        case TokenType::ADD:
+        {
+            T a = eval(beg, opIte, frame), b = eval(opIte + 1, end, frame);
+            return op(a.v + b.v, a, operand_one, b, operand_one);
+        }
+        case TokenType::SUB:
+        {
+            T a = eval(beg, opIte, frame), b = eval(opIte + 1, end, frame);
+            return op(a.v - b.v, a, operand_one, b, -operand_one);
+        }
+        case TokenType::MUL:
+        {
+            // Keeps the interpreter's short circuit, which recursive
+            // definitions rely on to terminate, as long as it is exact.
+            T a = eval(beg, opIte, frame);
+            if (a.v == operand_zero && !P::active(a))
+                return policy.constant(operand_zero);
+            T b = eval(opIte + 1, end, frame);
+            return op(a.v * b.v, a, b.v, b, a.v);
+        }
+        case TokenType::DIV:
+        {
+            T b = eval(opIte + 1, end, frame);
+            if (failed) return fail(error);
+            if (b.v == operand_zero) return fail(EVAL_DIV_BY_ZERO);
+            T a = eval(beg, opIte, frame);
+            operand_t q = a.v / b.v;
+            return op(q, a, operand_one / b.v, b, -q / b.v);
+        }
+        case TokenType::POW:
+        {
+            T a = eval(beg, opIte, frame), b = eval(opIte + 1, end, frame);
+            operand_t p = std::pow(a.v, b.v);
+            operand_t da = P::active(a)
+                               ? b.v * std::pow(a.v, b.v - operand_one)
+                               : operand_zero;
+            operand_t db =
+                P::active(b) ? p * std::log(a.v) : operand_zero;
+            return op(p, a, da, b, db);
+        }
+        default:
+            return fail(EVAL_INVALID_EXPR);
+        }
+    }
+
+    T call(const TokenList::const_iterator& beg,
+           const TokenList::const_iterator& end, const Frame& frame)
+    {
+        std::string name;
+        if (auto arg = frame.find(beg))
+        {
+            if (arg->name.empty()) return fail(EVAL_UNEXPECTED_TOKEN_TYPE);
+            name = arg->name;
+        }
+        else if (beg->isSymbol())
+            name = beg->getSymbol();
+        else
+            return fail(EVAL_UNEXPECTED_TOKEN_TYPE);
+        const Function* fp = context.findFunc(name);
+        if (!fp) return fail(EVAL_UNDEFINED_SYMBOL);
+        if (!(beg + 1)->isLParen() || !(end - 1)->isRParen())
+            return fail(EVAL_PAREN_MISMATCH);
+        const Function& f = *fp;
+
+        if (f.type == FuncType::HIGH_ORDER)
+        {
+            if (name == "SUM" || name == "MUL")
+                return fold(beg + 2, end - 1, frame, name == "SUM");
+            if (name == "IF_ELSE") return ifElse(beg + 2, end - 1, frame);
+            return fail(EVAL_NOT_DIFFERENTIABLE);
+        }
+
+        std::vector<Arg> args;
+        auto start = beg + 2;
+        for (auto ite = beg + 2; ite != end; ++ite)
+        {
+            ite = findArgSep(start, end);
+            if (ite - start == 1 && start->isSymbol() && !frame.find(start))
+                args.push_back(argument(start->getSymbol()));
+            else if (ite - start == 1 && frame.find(start))
+                args.push_back(*frame.find(start));
+            else
+                args.push_back(Arg{eval(start, ite, frame), {}});
+            start = ite + 1;
+        }
+        if (failed) return fail(error);
+        return invoke(f, std::move(args));
+    }
+
+    // A bare symbol passed as an argument, see Function::eval.
+    Arg argument(const std::string& symbol)
+    {
+        for (auto ite = locals.rbegin(); ite != locals.rend(); ++ite)
+            if (ite->first == symbol) return Arg{ite->second, {}};
+        const operand_t* v = context.findVar(symbol);
+        if (v) return Arg{policy.constant(*v), {}};
+        if (!context.findFunc(symbol))
+            return Arg{fail(EVAL_UNDEFINED_SYMBOL), {}};
+        return Arg{policy.constant(operand_zero), symbol};
+    }
+
+    T invoke(const Function& f, std::vector<Arg> args)
+    {
+        if (f.type == FuncType::ORDINARY)
+        {
+            TokenList tkl;
+            std::vector<const T*> values;
+            bool active = false;
+            for (const auto& a : args)
+            {
+                if (a.name.empty())
+                    tkl.push_back(Token(a.value.v));
+                else
+                    tkl.push_back(Token(a.name));
+                values.push_back(&a.value);
+                active = active || P::active(a.value);
+            }
+            auto r = context.call(f, tkl);
+            if (!r) return fail(r.error);
+            if (!active) return policy.constant(r.value);
+            if (!f.derivative) return fail(EVAL_NOT_DIFFERENTIABLE);
+            std::vector<operand_t> partials(args.size(), operand_zero);
+            f.derivative(tkl, partials.data());
+            return policy.apply(r.value, args.size(), values.data(),
+                                partials.data());
+        }
+        if (f.type != FuncType::CUSTOM) return fail(EVAL_NOT_DIFFERENTIABLE);
+        if (args.size() != f.parameterTable.size())
+            return fail(EVAL_WRONG_NUMBER_OF_ARGS);
+        if (depth > maxRecursionDepth) return fail(EVAL_STACK_OVERFLOW);
+        EVAL_EXCEPTION code;
+        if (context.overBudget(code)) return fail(code);
+        ++context.stats.calls;
+
+        Frame callee{&f.tkList, std::vector<size_t>(f.tkList.size(), npos),
+                     std::move(args)};
+        for (size_t i = 0; i < f.parameterTable.size(); ++i)
+            for (auto idx : f.parameterTable[i]) callee.slots[idx] = i;
+        ++depth;
+        T r = eval(f.tkList.begin(), f.tkList.end(), callee);
+        --depth;
+        return r;
+    }
+
+    // SUM and MUL, see foldLoop. The bounds only choose the terms, so they
+    // are taken as constants.
+    T fold(const TokenList::const_iterator& beg,
+           const TokenList::const_iterator& end, const Frame& frame, bool sum)
+    {
+        auto ite = findArgSep(beg, end);
+        auto exprEnd = ite;
+        if (ite == end || ite + 1 == end || frame.find(ite + 1) ||
+            !(ite + 1)->isSymbol())
+            return fail(EVAL_UNEXPECTED_TOKEN_TYPE);
+        std::string dummyVar = (++ite)->getSymbol();
+        ++ite;
+        if (ite == end || !ite->isComma())
+            return fail(EVAL_WRONG_NUMBER_OF_ARGS);
+
+        auto begIte = ++ite;
+        ite = findArgSep(begIte, end);
+        operand_t from = eval(begIte, ite, frame).v;
+        if (ite == end) return fail(EVAL_WRONG_NUMBER_OF_ARGS);
+
+        auto endIte = ++ite;
+        ite = findArgSep(endIte, end);
+        operand_t to = eval(endIte, ite, frame).v;
+
+        operand_t step = operand_one;
+        if (ite != end)
+        {
+            auto stepIte = ++ite;
+            ite = findArgSep(stepIte, end);
+            if (ite != end) return fail(EVAL_WRONG_NUMBER_OF_ARGS);
+            step = eval(stepIte, ite, frame).v;
+            if (failed) return fail(error);
+            if (step == operand_zero) return fail(EVAL_INFINITE_LOOP);
+        }
+        if (failed) return fail(error);
+
+        T s = policy.constant(sum ? operand_zero : operand_one);
+        locals.emplace_back(dummyVar, policy.constant(from));
+        for (operand_t x = from;
+             !failed && (step > operand_zero ? x < to : x > to); x += step)
+        {
+            locals.back().second = policy.constant(x);
+            T t = eval(beg, exprEnd, frame);
+            s = sum ? op(s.v + t.v, s, operand_one, t, operand_one)
+                    : op(s.v * t.v, s, t.v, t, s.v);
+        }
+        locals.pop_back();
+        return s;
+    }
+
+    T ifElse(const TokenList::const_iterator& beg,
+             const TokenList::const_iterator& end, const Frame& frame)
+    {
+        auto ite = findArgSep(beg, end);
+        operand_t cond = eval(beg, ite, frame).v;
+        if (ite == end) return fail(EVAL_WRONG_NUMBER_OF_ARGS);
+        auto trueIte = ++ite;
+        auto trueEndIte = findArgSep(trueIte, end);
+        if (trueEndIte == end) return fail(EVAL_WRONG_NUMBER_OF_ARGS);
+        if (failed) return fail(error);
+        return cond != operand_zero ? eval(trueIte, trueEndIte, frame)
+                                    : eval(trueEndIte + 1, end, frame);
+    }
+};
+}  // namespace
+
+Expected<operand_t> Context::tryDerivative(const std::string& name,
+                                           const std::vector<operand_t>& args,
+                                           size_t index)
+{
+    const Function* f = findFunc(name);
+    if (!f) return Expected<operand_t>::failure(EVAL_UNDEFINED_SYMBOL);
+    if (index >= args.size())
+        return Expected<operand_t>::failure(EVAL_WRONG_NUMBER_OF_ARGS);
+    Forward policy;
+    Differentiator<Forward> diff(*this, policy);
+    std::vector<Differentiator<Forward>::Arg> inputs;
+    for (size_t i = 0; i < args.size(); ++i)
+        inputs.push_back({Dual{args[i], i == index ? operand_one : operand_zero},
+                          {}});
+    operand_t d = diff.invoke(*f, std::move(inputs)).d;
+    if (diff.failed) return Expected<operand_t>::failure(diff.error);
+    return d;
+}
+
+Expected<std::pair<operand_t, std::vector<operand_t>>> Context::tryGradient(
+    const std::string& name, const std::vector<operand_t>& args)
+{
+    using Result = Expected<std::pair<operand_t, std::vector<operand_t>>>;
+    const Function* f = findFunc(name);
+    if (!f) return Result::failure(EVAL_UNDEFINED_SYMBOL);
+    Reverse policy;
+    Differentiator<Reverse> diff(*this, policy);
+    std::vector<Differentiator<Reverse>::Arg> inputs;
+    for (auto a : args) inputs.push_back({policy.input(a), {}});
+    Var out = diff.invoke(*f, std::move(inputs));
+    if (diff.failed) return Result::failure(diff.error);
+    auto adj = policy.adjoints(out);
+    adj.resize(args.size());
+    return std::make_pair(out.v, adj);
+}
+
+operand_t Context::derivative(const std::string& name,
+                              const std::vector<operand_t>& args,
+                              size_t index)
+{
+    auto r = tryDerivative(name, args, index);
+    EVAL_THROW(!r, r.error);
+    return r.value;
+}
+
+std::pair<operand_t, std::vector<operand_t>> Context::gradient(
+    const std::string& name, const std::vector<operand_t>& args)
+{
+    auto r = tryGradient(name, args);
+    EVAL_THROW(!r, r.error);
+    return r.value;
+}
+}  // namespace eval
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include <evaluator/Builtins.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#include <evaluator/Context.h>
+
+namespace eval
+{
+namespace
+{
+// Every name importMath can define, in any operand mode. A name may be a
+// function and an array function at once, as max and min are.
+constexpr std::string_view names[] = {
+    "pi", "e",
+    "eq", "neq", "leq", "lt", "geq", "gt", "ln", "lg", "log", "sin", "cos",
+    "tan", "asin", "acos", "atan", "gamma", "floor", "ceil", "exp", "erf",
+    "abs", "rand", "max", "min", "SUM", "MUL", "IF_ELSE", "D",
+    "ROOT", "MINIMIZE", "INTEGRATE", "LIMIT", "SERIES", "PRODUCT",
+    "vec", "linspace", "range", "at", "len", "sum", "prod", "mean", "dot"};
+constexpr size_t nameCount = std::size(names);
+
+constexpr size_t slotBits = 8;
+constexpr size_t slotCount = size_t(1) << slotBits;
+constexpr uint8_t noSlot = 0xff;
+static_assert(nameCount < noSlot, "too many builtins for the slot table");
+
+constexpr uint32_t hash(std::string_view s, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : s) h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    return (h * 2654435761u) >> (32 - slotBits);
+}
+
+constexpr bool collisionFree(uint32_t seed)
+{
+    bool used[slotCount] = {};
+    for (auto n : names)
+    {
+        auto h = hash(n, seed);
+        if (used[h]) return false;
+        used[h] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findSeed()
+{
+    uint32_t seed = 0;
+    while (!collisionFree(seed)) ++seed;
+    return seed;
+}
+
+constexpr uint32_t seed = findSeed();
+
+struct SlotTable
+{
+    uint8_t index[slotCount];
+};
+
+constexpr SlotTable buildSlots()
+{
+    SlotTable t = {};
+    for (auto& i : t.index) i = noSlot;
+    for (size_t i = 0; i < nameCount; ++i)
+        t.index[hash(names[i], seed)] = static_cast<uint8_t>(i);
+    return t;
+}
+
+constexpr SlotTable slots = buildSlots();
+
+constexpr size_t indexOf(std::string_view name)
+{
+    auto i = slots.index[hash(name, seed)];
+    return i != noSlot && names[i] == name ? i : nameCount;
+}
+
+static_assert(indexOf("sin") < nameCount && indexOf("IF_ELSE") < nameCount &&
+                  indexOf("sinh") == nameCount,
+              "builtin name lookup");
+}  // namespace
+
+const Builtins& Builtins::math()
+{
+    static const Builtins table = []
+    {
+        // The definitions are written against a context's tables, see
+        // Context::defineMath.
+        Context staged;
+        staged.varTable.clear();
+        staged.defineMath();
+        return Builtins(std::move(staged.varTable),
+                        std::move(staged.funcTable),
+                        std::move(staged.arrayFuncTable));
+    }();
+    return table;
+}
+
+Builtins::Builtins(
+    std::unordered_map<std::string, operand_t> varTable,
+    std::unordered_map<std::string, Function> funcTable,
+    std::unordered_map<std::string, ArrayFunction> arrayFuncTable)
+    : entries(nameCount)
+{
+    auto entry = [this](const std::string& name) -> Entry&
+    {
+        size_t i = indexOf(name);
+        if (i == nameCount)
+            throw std::logic_error("builtin " + name +
+                                   " is missing from the name list");
+        return entries[i];
+    };
+    for (auto& v : varTable)
+    {
+        auto& e = entry(v.first);
+        e.hasVar = true;
+        e.var = v.second;
+        vars.push_back(v.first);
+    }
+    for (auto& f : funcTable)
+    {
+        auto& e = entry(f.first);
+        e.hasFunc = true;
+        e.func = std::move(f.second);
+        funcs.push_back(f.first);
+    }
+    for (auto& f : arrayFuncTable)
+    {
+        auto& e = entry(f.first);
+        e.hasArrayFunc = true;
+        e.arrayFunc = std::move(f.second);
+        arrayFuncs.push_back(f.first);
+    }
+    for (auto* list : {&vars, &funcs, &arrayFuncs})
+        std::sort(list->begin(), list->end());
+}
+
+const Builtins::Entry* Builtins::find(const std::string& name) const
+{
+    size_t i = indexOf(name);
+    return i == nameCount ? nullptr : &entries[i];
+}
+
+const operand_t* Builtins::findVar(const std::string& name) const
+{
+    auto e = find(name);
+    return e && e->hasVar ? &e->var : nullptr;
+}
+
+const Function* Builtins::findFunc(const std::string& name) const
+{
+    auto e = find(name);
+    return e && e->hasFunc ? &e->func : nullptr;
+}
+
+const ArrayFunction* Builtins::findArrayFunc(const std::string& name) const
+{
+    auto e = find(name);
+    return e && e->hasArrayFunc ? &e->arrayFunc : nullptr;
+}
+}  // namespace eval
\ No newline at end of file
@@ -1,452 +1,1239 @@
-#include <evaluator/Context.h>
-
-#include <cmath>
-#include <cstdlib>
-#include <ctime>
-#define EVAL_RETURN(x) \
-    do                 \
-    {                  \
-        auto tmp = x;  \
-        --depth;       \
-        return tmp;    \
-    } while (0)
-
-namespace eval
-{
-Context::Context() : depth(0)
-{
-    varTable["ANS"] = operand_zero;
-    srand(static_cast<unsigned int>(time(NULL)));
-}
-
-std::pair<ExprType, operand_t> Context::exec(const std::string &input)
-{
-    depth = 0;
-    auto tkList = TokenList(input);
-    if (tkList.size() > 2 && tkList[0].isSymbol() &&
-        tkList[1].isEq()) // Assigning value to variable
-    {
-        varTable[tkList.begin()->getSymbol()] =
-            evalExpr(tkList.begin() + 2, tkList.end());
-        return {ExprType::VAR_ASSIGN, operand_zero};
-    }
-    if (DefFunc(tkList))
-    {
-        return {ExprType::FUNC_DEF, operand_zero};
-    }
-    return {ExprType::EXPR,
-            varTable["ANS"] = evalExpr(tkList.begin(), tkList.end())};
-}
-
-operand_t Context::evalExpr(const TokenList::const_iterator &beg,
-                            const TokenList::const_iterator &end)
-{
-    EVAL_THROW(beg >= end, EVAL_INVALID_EXPR);
-    EVAL_THROW(depth > maxRecursionDepth, EVAL_STACK_OVERFLOW);
-    ++depth;
-    if (beg + 1 == end) // "1", "x"
-    {
-        if (beg->isOperand())
-            EVAL_RETURN(beg->getOperand());
-        EVAL_THROW(!beg->isSymbol(), EVAL_INVALID_EXPR);
-        auto vIte = varTable.find(beg->getSymbol());
-        EVAL_THROW(vIte == varTable.end(), EVAL_UNDEFINED_SYMBOL);
-        EVAL_RETURN(vIte->second);
-    }
-    int minPre = 4;
-    TokenList::const_iterator mainOperatorIte = end;
-
-    if (beg->isSub()) // "-x", "-(1)", "-(x+1)+3"
-    {
-        int inParen = 0;
-
-        for (auto ite = beg + 1; ite != end; ++ite)
-        {
-            if (ite->isLParen())
-                ++inParen;
-            else if (ite->isRParen())
-                --inParen;
-            else if (!inParen && (ite->isAdd() || ite->isSub()))
-                mainOperatorIte = ite;
-        }
-        if (mainOperatorIte == end)
-        {
-            EVAL_THROW(inParen, EVAL_PAREN_MISMATCH);
-            EVAL_RETURN(-evalExpr(beg + 1, end));
-        }
-        minPre = 1;
-    }
-
-    if (minPre == 4)
-    {
-        for (auto ite = beg; ite != end; ++ite)
-        {
-            if (ite->isLParen())
-            {
-                ite = findParen(ite, end);
-                EVAL_THROW(ite == end, EVAL_PAREN_MISMATCH);
-                continue;
-            }
-            if (ite->isOperator() && !isNeg(beg, ite))
-            {
-                int pre = getOperatorPrecedence(ite->type);
-                if (pre <= minPre)
-                {
-                    minPre = pre;
-                    mainOperatorIte = ite;
-                }
-            }
-        }
-    }
-    if (minPre != 4)
-    {
-        switch (mainOperatorIte->type)
-        {
-        case TokenType::ADD:
-            EVAL_RETURN(evalExpr(beg, mainOperatorIte) +
-                        evalExpr(mainOperatorIte + 1, end));
-        case TokenType::SUB:
-            EVAL_RETURN(evalExpr(beg, mainOperatorIte) -
-                        evalExpr(mainOperatorIte + 1, end));
-        case TokenType::MUL:
-        {
-            auto l = evalExpr(beg, mainOperatorIte);
-            if (l == operand_zero)
-                EVAL_RETURN(operand_zero);
-            EVAL_RETURN(l * evalExpr(mainOperatorIte + 1, end));
-        }
-        case TokenType::DIV:
-        {
-            auto denominator = evalExpr(mainOperatorIte + 1, end);
-            EVAL_THROW(denominator == operand_zero, EVAL_DIV_BY_ZERO);
-            EVAL_RETURN(evalExpr(beg, mainOperatorIte) / denominator);
-        }
-        case TokenType::POW:
-            EVAL_RETURN(std::pow(evalExpr(beg, mainOperatorIte),
-                                 evalExpr(mainOperatorIte + 1, end)));
-        default:
-            EVAL_THROW(1, EVAL_INVALID_EXPR);
-        }
-    }
-    if (beg->isLParen()) // "(1+2)", "(1+2)*3"
-    {
-        EVAL_THROW(!(end - 1)->isRParen(), EVAL_PAREN_MISMATCH);
-        EVAL_RETURN(evalExpr(beg + 1, end - 1));
-    }
-
-    auto fIte = funcTable.find(beg->getSymbol());
-    EVAL_THROW(fIte == funcTable.end(), EVAL_UNDEFINED_SYMBOL);
-    EVAL_THROW(!(end - 1)->isRParen(), EVAL_PAREN_MISMATCH);
-    EVAL_RETURN(fIte->second.eval(*this, beg, end));
-}
-
-bool Context::DefFunc(const TokenList &tkl)
-{
-    if (tkl.size() < 6)
-        return false; // f(x)=x
-    if ((!tkl[0].isSymbol()) || (!(tkl[1].isLParen())))
-        return false;
-    bool foundEq = false;
-    TokenList::const_iterator rParenIte;
-    for (auto ite = tkl.begin() + 3; ite != tkl.end() - 1; ++ite)
-        if (ite->isRParen() && (ite + 1)->isEq())
-        {
-            foundEq = true;
-            rParenIte = ite;
-            break;
-        }
-    if (!foundEq)
-        return false;
-    std::unordered_map<std::string, size_t> parameterMap;
-
-    size_t idx = 0;
-    for (auto ite = tkl.begin() + 2; ite != rParenIte; ++ite)
-    {
-        if (!ite->isSymbol())
-            return false;
-        EVAL_THROW(parameterMap.find(ite->getSymbol()) != parameterMap.end(),
-                   EVAL_REPEATED_PARAMETER_NAME);
-        parameterMap[ite->getSymbol()] = idx++;
-        if (++ite == rParenIte)
-            break;
-        if (!ite->isComma())
-            return false;
-    }
-    Function f(rParenIte + 2, tkl.end());
-    f.parameterTable.resize(parameterMap.size());
-    for (auto ite = f.tkList.begin(); ite != f.tkList.end(); ++ite)
-    {
-        if (ite->isSymbol())
-        {
-            auto i = parameterMap.find(ite->getSymbol());
-            if (parameterMap.end() != i)
-                f.parameterTable[i->second].push_back(ite - f.tkList.begin());
-        }
-    }
-    funcTable[tkl.begin()->getSymbol()] = f;
-    return true;
-}
-
-void Context::importMath()
-{
-#ifdef EVAL_DECIMAL_OPERAND
-    varTable["pi"] = 3.14159265358979323846264338328;
-    varTable["e"] = 2.71828182845904523536028747135;
-#endif
-
-    funcTable["eq"] =
-        Function(FuncType::ORDINARY,
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return tkl[0].getOperand() == tkl[1].getOperand(); });
-
-    funcTable["neq"] =
-        Function(FuncType::ORDINARY,
-
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return tkl[0].getOperand() != tkl[1].getOperand(); });
-
-    funcTable["leq"] =
-        Function(FuncType::ORDINARY,
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return tkl[0].getOperand() <= tkl[1].getOperand(); });
-
-    funcTable["lt"] =
-        Function(FuncType::ORDINARY,
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return tkl[0].getOperand() < tkl[1].getOperand(); });
-
-    funcTable["geq"] =
-        Function(FuncType::ORDINARY,
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return tkl[0].getOperand() >= tkl[1].getOperand(); });
-
-    funcTable["gt"] =
-        Function(FuncType::ORDINARY,
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return tkl[0].getOperand() > tkl[1].getOperand(); });
-
-#ifdef EVAL_DECIMAL_OPERAND
-    funcTable["ln"] = Function(FuncType::ORDINARY,
-                               [](const TokenList &tkl, Context &) -> operand_t
-                               { return log(tkl[0].getOperand()); });
-
-    funcTable["lg"] = Function(FuncType::ORDINARY,
-                               [](const TokenList &tkl, Context &) -> operand_t
-                               { return log10(tkl[0].getOperand()); });
-
-    funcTable["log"] = Function(
-        FuncType::ORDINARY,
-        [](const TokenList &tkl, Context &) -> operand_t
-        { return log(tkl[1].getOperand()) / log(tkl[0].getOperand()); });
-
-    funcTable["sin"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                { return sin(tkl[0].getOperand()); });
-    funcTable["cos"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                { return cos(tkl[0].getOperand()); });
-    funcTable["tan"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                { return tan(tkl[0].getOperand()); });
-
-    funcTable["asin"] = Function(FuncType::ORDINARY,
-                                 [](const TokenList &tkl, Context &) -> operand_t
-                                 { return asin(tkl[0].getOperand()); });
-    funcTable["acos"] = Function(FuncType::ORDINARY,
-                                 [](const TokenList &tkl, Context &) -> operand_t
-                                 { return acos(tkl[0].getOperand()); });
-    funcTable["atan"] = Function(FuncType::ORDINARY,
-                                 [](const TokenList &tkl, Context &) -> operand_t
-                                 { return atan(tkl[0].getOperand()); });
-
-    funcTable["gamma"] =
-        Function(FuncType::ORDINARY,
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return tgamma(tkl[0].getOperand()); });
-
-    funcTable["floor"] =
-        Function(FuncType::ORDINARY,
-                 [](const TokenList &tkl, Context &) -> operand_t
-                 { return floor(tkl[0].getOperand()); });
-    funcTable["ceil"] = Function(FuncType::ORDINARY,
-                                 [](const TokenList &tkl, Context &) -> operand_t
-                                 { return ceil(tkl[0].getOperand()); });
-    funcTable["exp"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                { return exp(tkl[0].getOperand()); });
-    funcTable["erf"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                { return erf(tkl[0].getOperand()); });
-#endif
-
-    funcTable["abs"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                {
-#ifdef EVAL_DECIMAL_OPERAND
-                                    return fabs(tkl[0].getOperand());
-#else
-            return abs(tkl[0].getOperand());
-#endif
-                                });
-
-    funcTable["rand"] = Function(FuncType::ORDINARY,
-                                 [](const TokenList &tkl, Context &) -> operand_t
-                                 {
-                                     auto a = tkl[0].getOperand(),
-                                          b = tkl[1].getOperand();
-#ifdef EVAL_DECIMAL_OPERAND
-                                     return a + rand() * (b - a) / RAND_MAX;
-#else
-            return a + rand() % (b - a);
-#endif
-                                 });
-
-    funcTable["max"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                {
-                                    operand_t m = tkl[0].getOperand();
-                                    for (const auto &t : tkl)
-                                        if (t.getOperand() > m)
-                                            m = t.getOperand();
-                                    return m;
-                                });
-    funcTable["min"] = Function(FuncType::ORDINARY,
-                                [](const TokenList &tkl, Context &) -> operand_t
-                                {
-                                    operand_t m = tkl[0].getOperand();
-                                    for (const auto &t : tkl)
-                                        if (t.getOperand() < m)
-                                            m = t.getOperand();
-                                    return m;
-                                });
-
-    funcTable["SUM"] = Function(
-        FuncType::HIGH_ORDER,
-        [](const TokenList &tkl, Context &context) -> operand_t
-        {
-            auto ite = findArgSep(tkl.begin(), tkl.end());
-            TokenList exprTokens(tkl.begin(), ite);
-
-            std::string dummyVar = (++ite)->getSymbol();
-            for (auto &t : exprTokens)
-                if (t.isSymbol() && t.getSymbol() == dummyVar)
-                    t = Token("#" + t.getSymbol()); // temp variable
-            dummyVar = "#" + dummyVar;
-            ++ite;
-            EVAL_THROW(!ite->isComma(), EVAL_WRONG_NUMBER_OF_ARGS);
-
-            auto begIte = ++ite;
-            ite = findArgSep(begIte, tkl.end());
-            operand_t beg = context.evalExpr(begIte, ite);
-
-            auto endIte = ++ite;
-            ite = findArgSep(endIte, tkl.end());
-            operand_t end = context.evalExpr(endIte, ite);
-
-            operand_t step;
-            if (ite->isComma())
-            {
-                auto stepIte = ++ite;
-                ite = findArgSep(stepIte, tkl.end());
-                EVAL_THROW(!ite->isRParen(), EVAL_WRONG_NUMBER_OF_ARGS);
-                step = context.evalExpr(stepIte, ite);
-                EVAL_THROW(step == operand_zero,
-                           EVAL_INFINITE_LOOP);
-            }
-            else
-                step = operand_one;
-            operand_t s = operand_zero;
-
-            auto &dummyVarVal =
-                context.varTable.insert(std::make_pair(dummyVar, operand_zero))
-                    .first->second;
-            if (step > operand_zero)
-                for (operand_t x = beg; x < end; x += step)
-                {
-                    dummyVarVal = x;
-                    s += context.evalExpr(exprTokens.begin(),
-                                          exprTokens.end());
-                }
-            else
-                for (operand_t x = beg; x > end; x += step)
-                {
-                    dummyVarVal = x;
-                    s += context.evalExpr(exprTokens.begin(),
-                                          exprTokens.end());
-                }
-            context.varTable.erase(dummyVar);
-            return s;
-        });
-
-    funcTable["MUL"] = Function(
-        FuncType::HIGH_ORDER,
-        [](const TokenList &tkl, Context &context) -> operand_t
-        {
-            auto ite = findArgSep(tkl.begin(), tkl.end());
-            TokenList exprTokens(tkl.begin(), ite);
-
-            std::string dummyVar = (++ite)->getSymbol();
-            for (auto &t : exprTokens)
-                if (t.isSymbol() && t.getSymbol() == dummyVar)
-                    t = Token("#" + t.getSymbol()); // temp variable
-            dummyVar = "#" + dummyVar;
-            ++ite;
-            EVAL_THROW(!ite->isComma(), EVAL_WRONG_NUMBER_OF_ARGS);
-
-            auto begIte = ++ite;
-            ite = findArgSep(begIte, tkl.end());
-            operand_t beg = context.evalExpr(begIte, ite);
-
-            auto endIte = ++ite;
-            ite = findArgSep(endIte, tkl.end());
-            operand_t end = context.evalExpr(endIte, ite);
-
-            operand_t step;
-            if (ite->isComma())
-            {
-                auto stepIte = ++ite;
-                ite = findArgSep(stepIte, tkl.end());
-                EVAL_THROW(!ite->isRParen(), EVAL_WRONG_NUMBER_OF_ARGS);
-                step = context.evalExpr(stepIte, ite);
-                EVAL_THROW(step == operand_zero,
-                           EVAL_INFINITE_LOOP);
-            }
-            else
-                step = operand_one;
-            operand_t s = operand_one;
-
-            auto &dummyVarVal =
-                context.varTable.insert(std::make_pair(dummyVar, operand_zero))
-                    .first->second;
-            if (step > operand_zero)
-                for (operand_t x = beg; x < end; x += step)
-                {
-                    dummyVarVal = x;
-                    s *= context.evalExpr(exprTokens.begin(),
-                                          exprTokens.end());
-                }
-            else
-                for (operand_t x = beg; x > end; x += step)
-                {
-                    dummyVarVal = x;
-                    s *= context.evalExpr(exprTokens.begin(),
-                                          exprTokens.end());
-                }
-            context.varTable.erase(dummyVar);
-            return s;
-        });
-
-    funcTable["IF_ELSE"] = Function(
-        FuncType::HIGH_ORDER,
-        [](const TokenList &tkl, Context &context) -> operand_t
-        {
-            auto ite = findArgSep(tkl.begin(), tkl.end());
-            operand_t cond = context.evalExpr(tkl.begin(), ite);
-            auto trueIte = ++ite;
-            auto trueEndIte = findArgSep(trueIte, tkl.end());
-            return cond != operand_zero
-                       ? context.evalExpr(trueIte, trueEndIte)
-                       : context.evalExpr(trueEndIte + 1, tkl.end() - 1);
-        });
-}
+#include <evaluator/Context.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+
+#include <evaluator/Expr.h>
+#ifdef EVAL_DECIMAL_OPERAND
+#include <evaluator/MathKernels.h>
+#endif
+
+namespace eval
+{
+namespace
+{
+constexpr size_t batchSize = 128;
+
+// Exact and much cheaper than a stream: keys are built for every SUM body.
+#ifdef EVAL_DECIMAL_OPERAND
+void appendNumber(std::string &key, decimal_t value)
+{
+    char buf[64];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value,
+                             std::chars_format::hex);
+    key.append(buf, res.ptr);
+}
+#endif
+
+#if defined(EVAL_MIXED_OPERAND) || !defined(EVAL_DECIMAL_OPERAND)
+void appendNumber(std::string &key, int64_t value)
+{
+    char buf[24];
+    key.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+}
+#endif
+
+void appendOperand(std::string &key, const operand_t &value)
+{
+#ifdef EVAL_MIXED_OPERAND
+    if (value.integral)
+        appendNumber(key, value.i);
+    else
+        appendNumber(key, value.d);
+#elif defined(EVAL_DECIMAL_OPERAND)
+    appendNumber(key, value);
+#else
+    appendNumber(key, static_cast<int64_t>(value));
+#endif
+}
+
+// SUM and MUL: folds the body over the dummy variable running from beg to end
+// (exclusive) by step, batchSize values at a time.
+template <typename Op>
+operand_t foldLoop(const TokenList &tkl, Context &context, operand_t s, Op op)
+{
+    auto ite = findArgSep(tkl.begin(), tkl.end());
+    auto exprEnd = ite;
+
+    if (ite == tkl.end() || ++ite == tkl.end())
+        return context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+    if (!ite->isSymbol())
+        return context.raise(EVAL_UNEXPECTED_TOKEN_TYPE);
+    std::string dummyVar = ite->getSymbol();
+    ++ite;
+    if (ite == tkl.end() || !ite->isComma())
+        return context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+
+    auto begIte = ++ite;
+    ite = findArgSep(begIte, tkl.end());
+    auto beg = context.tryEvalExpr(begIte, ite);
+    if (!beg)
+        return context.raise(beg);
+    if (ite == tkl.end())
+        return context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+
+    auto endIte = ++ite;
+    ite = findArgSep(endIte, tkl.end());
+    auto end = context.tryEvalExpr(endIte, ite);
+    if (!end)
+        return context.raise(end);
+
+    operand_t step = operand_one;
+    if (ite != tkl.end() && ite->isComma())
+    {
+        auto stepIte = ++ite;
+        ite = findArgSep(stepIte, tkl.end());
+        if (ite == tkl.end() || !ite->isRParen())
+            return context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+        auto r = context.tryEvalExpr(stepIte, ite);
+        if (!r)
+            return context.raise(r);
+        step = r.value;
+        if (step == operand_zero)
+            return context.raise(EVAL_INFINITE_LOOP);
+    }
+
+    LaneBody body(context, tkl.begin(), exprEnd, dummyVar);
+    operand_t lanes[batchSize], terms[batchSize];
+    size_t n = 0;
+    auto flush = [&]() -> bool
+    {
+        if (!body.eval(lanes, terms, n))
+            return false;
+        for (size_t i = 0; i < n; ++i)
+            s = op(s, terms[i]);
+        n = 0;
+        return true;
+    };
+
+    bool ok = true;
+    EVAL_EXCEPTION code;
+    auto next = [&](operand_t x)
+    {
+        if (context.overBudget(code))
+        {
+            context.raise(code);
+            return false;
+        }
+        lanes[n++] = x;
+        return n < batchSize || flush();
+    };
+    if (step > operand_zero)
+        for (operand_t x = beg.value; ok && x < end.value; x += step)
+            ok = next(x);
+    else
+        for (operand_t x = beg.value; ok && x > end.value; x += step)
+            ok = next(x);
+    if (ok)
+        flush();
+    return s;
+}
+
+// Distinct for every context of the process, and for every run.
+uint64_t freshSeed()
+{
+    static std::atomic<uint64_t> next(
+        static_cast<uint64_t>(time(NULL)) ^
+        static_cast<uint64_t>(
+            std::chrono::steady_clock::now().time_since_epoch().count()));
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// A number drawn by rand from bits of the context generator: uniform in
+// [a, b), with as many random bits as decimal_t holds.
+operand_t draw(operand_t a, operand_t b, uint64_t bits)
+{
+#ifdef EVAL_DECIMAL_OPERAND
+    constexpr int digits = std::numeric_limits<decimal_t>::digits < 64
+                               ? std::numeric_limits<decimal_t>::digits
+                               : 64;
+    static const decimal_t scale = std::ldexp(decimal_t(1), -digits);
+    return a + static_cast<decimal_t>(bits >> (64 - digits)) * scale * (b - a);
+#else
+    return b > a ? a + static_cast<operand_t>(
+                           bits % static_cast<uint64_t>(b - a))
+                 : a;
+#endif
+}
+
+#ifdef EVAL_DECIMAL_OPERAND
+// Batch definition running a double precision kernel over operand lanes.
+template <void (*kernel)(const double *, double *, size_t)>
+void batchKernel(const operand_t *const *args, operand_t *out, size_t n,
+                 Context &)
+{
+    double buf[64];
+    for (size_t i = 0; i < n; i += 64)
+    {
+        size_t m = n - i < 64 ? n - i : 64;
+        for (size_t j = 0; j < m; ++j)
+            buf[j] = static_cast<double>(args[0][i + j]);
+        kernel(buf, buf, m);
+        for (size_t j = 0; j < m; ++j)
+            out[i + j] = buf[j];
+    }
+}
+
+// Digamma function, for the derivative of gamma.
+operand_t digamma(operand_t x)
+{
+    const operand_t pi = 3.14159265358979323846264338328;
+    if (x <= operand_zero && floor(x) == x)
+        return NAN;
+    if (x < operand_zero) // reflection
+        return digamma(operand_one - x) - pi / tan(pi * x);
+    operand_t r = operand_zero;
+    for (; x < 10; x += operand_one)
+        r -= operand_one / x;
+    operand_t f = operand_one / (x * x);
+    operand_t t =
+        f * (1.0L / 12 -
+             f * (1.0L / 120 -
+                  f * (1.0L / 252 -
+                       f * (1.0L / 240 -
+                            f * (1.0L / 132 -
+                                 f * (691.0L / 32760 - f / 12))))));
+    return r + log(x) - 0.5L / x - t;
+}
+#endif
+} // namespace
+
+Context::Context()
+    : depth(0), parent(nullptr), input(nullptr), foreign(0), raised(false),
+      raisedError(EVAL_INVALID_EXPR), clockTick(0), memory(0),
+      lastVersion(0), definitionCount(0), definitionBytes(0),
+      spawnDepth(maxRecursionDepth), builtins(nullptr), strictMath(false),
+      random(freshSeed())
+{
+    varTable["ANS"] = operand_zero;
+}
+
+Context::Context(const Context *parent)
+    : depth(0), parent(parent), input(nullptr), foreign(0), raised(false),
+      raisedError(EVAL_INVALID_EXPR), clockTick(0), memory(0),
+      lastVersion(parent->lastVersion), definitionCount(0),
+      definitionBytes(0), spawnDepth(maxRecursionDepth), builtins(nullptr),
+      strictMath(parent->strictMath), random(parent->random.split()),
+      budget(parent->budget), cancellation(parent->cancellation),
+      quota(parent->quota), parallel(parent->parallel),
+      tiering(parent->tiering)
+{
+}
+
+const operand_t *Context::findVar(const std::string &name) const
+{
+    for (auto c = this; c; c = c->parent)
+    {
+        auto ite = c->varTable.find(name);
+        if (ite != c->varTable.end())
+            return &ite->second;
+    }
+    for (auto c = this; c; c = c->parent)
+        if (c->builtins)
+            if (auto b = c->builtins->findVar(name))
+                return b;
+    return nullptr;
+}
+
+const Function *Context::findFunc(const std::string &name) const
+{
+    for (auto c = this; c; c = c->parent)
+    {
+        auto ite = c->funcTable.find(name);
+        if (ite != c->funcTable.end())
+            return &ite->second;
+    }
+    for (auto c = this; c; c = c->parent)
+        if (c->builtins)
+            if (auto b = c->builtins->findFunc(name))
+                return b;
+    return nullptr;
+}
+
+const Array *Context::findArray(const std::string &name) const
+{
+    for (auto c = this; c; c = c->parent)
+    {
+        auto ite = c->arrayTable.find(name);
+        if (ite != c->arrayTable.end())
+            return &ite->second;
+    }
+    return nullptr;
+}
+
+const ArrayFunction *Context::findArrayFunc(const std::string &name) const
+{
+    for (auto c = this; c; c = c->parent)
+    {
+        auto ite = c->arrayFuncTable.find(name);
+        if (ite != c->arrayFuncTable.end())
+            return &ite->second;
+    }
+    for (auto c = this; c; c = c->parent)
+        if (c->builtins)
+            if (auto b = c->builtins->findArrayFunc(name))
+                return b;
+    return nullptr;
+}
+
+std::pair<ExprType, operand_t> Context::exec(const std::string &input)
+{
+    auto r = tryExec(input);
+    EVAL_THROW(!r, r.error);
+    return r.value;
+}
+
+Expected<std::pair<ExprType, operand_t>>
+Context::tryExec(const std::string &input)
+{
+    auto tkList = TokenList::tryParse(input);
+    if (!tkList)
+        return Expected<std::pair<ExprType, operand_t>>::failure(tkList);
+    return execTokens(tkList.value);
+}
+
+Expected<operand_t> Context::tryEval(const std::string &input)
+{
+    auto tkList = TokenList::tryParse(input);
+    if (!tkList)
+        return Expected<operand_t>::failure(tkList);
+    begin(&tkList.value);
+    auto r = tryEvalExpr(tkList.value.begin(), tkList.value.end());
+    end();
+    return r;
+}
+
+Expected<operand_t> Context::tryCall(const std::string &name,
+                                     const std::vector<operand_t> &args)
+{
+    std::vector<const operand_t *> columns;
+    columns.reserve(args.size());
+    for (const auto &a : args)
+        columns.push_back(&a);
+    Expected<operand_t> r;
+    tryCall(name, columns.data(), args.size(), 1, &r);
+    return r;
+}
+
+void Context::tryCall(const std::string &name, const operand_t *const *args,
+                      size_t arity, size_t n, Expected<operand_t> *out)
+{
+    const Function *f = findFunc(name);
+    if (!f || (f->type == FuncType::CUSTOM &&
+               arity != f->parameterTable.size()))
+    {
+        auto e = f ? EVAL_WRONG_NUMBER_OF_ARGS : EVAL_UNDEFINED_SYMBOL;
+        std::fill(out, out + n, Expected<operand_t>::failure(e));
+        return;
+    }
+    if (f->type == FuncType::CUSTOM && n > 1)
+    {
+        std::vector<operand_t> values(n);
+        begin(nullptr);
+        bool compiled = tieredCall(name, *f, args, values.data(), n);
+        end();
+        if (compiled)
+        {
+            std::copy(values.begin(), values.end(), out);
+            return;
+        }
+    }
+
+    // name(a, b, ...), the arguments being replaced call by call.
+    TokenList tkl;
+    tkl.reserve(2 * arity + 2);
+    tkl.push_back(Token(name));
+    tkl.push_back(Token(TokenType::LPAREN));
+    for (size_t i = 0; i < arity; ++i)
+    {
+        if (i)
+            tkl.push_back(Token(TokenType::COMMA));
+        tkl.push_back(Token(operand_zero));
+    }
+    tkl.push_back(Token(TokenType::RPAREN));
+    tkl.buildIndex();
+    for (size_t j = 0; j < n; ++j)
+    {
+        for (size_t i = 0; i < arity; ++i)
+            tkl[2 + 2 * i].replace(Token(args[i][j]));
+        // Without an input, errors carry no position.
+        begin(nullptr);
+        out[j] = f->tryEval(*this, tkl.begin(), tkl.end());
+        end();
+    }
+}
+
+const RationalForm *Context::rationalForm(const std::string &name) const
+{
+    const Function *f = findFunc(name);
+    return f ? f->form.get() : nullptr;
+}
+
+Expected<std::pair<ExprType, operand_t>>
+Context::execTokens(const TokenList &tkList)
+{
+    using Result = Expected<std::pair<ExprType, operand_t>>;
+    begin(&tkList);
+    Result ret;
+    if (tkList.size() > 2 && tkList[0].isSymbol() &&
+        tkList[1].isEq()) // Assigning value to variable
+    {
+        const std::string &name = tkList.begin()->getSymbol();
+        if (involvesArrays(tkList.begin() + 2, tkList.end()))
+        {
+            auto a = tryEvalArray(tkList.begin() + 2, tkList.end());
+            auto q = a ? reserve(name, nullptr,
+                                 a.value.size() != 1 ? &a.value : nullptr)
+                       : Expected<bool>(true);
+            if (!q)
+                ret = Result::failure(q.error, 0);
+            else if (a && a.value.size() != 1)
+            {
+                varTable.erase(name);
+                arrayTable[name] = std::move(a.value);
+                touch(name);
+                ret = Result({ExprType::VAR_ASSIGN, operand_zero});
+            }
+            else if (a)
+            {
+                arrayTable.erase(name);
+                varTable[name] = a.value[0];
+                touch(name);
+                ret = Result({ExprType::VAR_ASSIGN, operand_zero});
+            }
+            else
+                ret = Result::failure(a);
+            end();
+            return ret;
+        }
+        auto r = tryEvalExpr(tkList.begin() + 2, tkList.end());
+        auto q = r ? reserve(name, nullptr) : Expected<bool>(true);
+        if (!q)
+            ret = Result::failure(q.error, 0);
+        else if (r)
+        {
+            arrayTable.erase(name);
+            varTable[name] = r.value;
+            touch(name);
+            ret = Result({ExprType::VAR_ASSIGN, operand_zero});
+        }
+        else
+            ret = Result::failure(r);
+        end();
+        return ret;
+    }
+    auto def = tryDefFunc(tkList);
+    if (!def || def.value)
+    {
+        ret = def ? Result({ExprType::FUNC_DEF, operand_zero})
+                  : Result::failure(def);
+        end();
+        return ret;
+    }
+
+    if (involvesArrays(tkList.begin(), tkList.end()))
+    {
+        auto a = tryEvalArray(tkList.begin(), tkList.end());
+        auto q = a ? reserve("ANS", nullptr,
+                             a.value.size() != 1 ? &a.value : nullptr)
+                   : Expected<bool>(true);
+        if (!q)
+            ret = Result::failure(q.error, 0);
+        else if (a && a.value.size() != 1)
+        {
+            varTable.erase("ANS");
+            operand_t n = static_cast<operand_t>(a.value.size());
+            arrayTable["ANS"] = std::move(a.value);
+            touch("ANS");
+            ret = Result({ExprType::ARRAY, n});
+        }
+        else if (a)
+        {
+            arrayTable.erase("ANS");
+            touch("ANS");
+            ret = Result({ExprType::EXPR, varTable["ANS"] = a.value[0]});
+        }
+        else
+            ret = Result::failure(a);
+        end();
+        return ret;
+    }
+
+    std::string key;
+    ResultCache::Dependencies deps;
+    bool cacheable = cache.enabled() && dependencies(tkList, deps);
+    operand_t value;
+    if (cacheable)
+    {
+        key = normalize(tkList);
+        if (strictMath)
+            key += '!';
+        if (cache.find(
+                key, [this](const std::string &name) { return version(name); },
+                value) &&
+            reserve("ANS", nullptr))
+        {
+            end();
+            touch("ANS");
+            arrayTable.erase("ANS");
+            return Result({ExprType::EXPR, varTable["ANS"] = value});
+        }
+    }
+    auto r = tryEvalExpr(tkList.begin(), tkList.end());
+    auto q = r ? reserve("ANS", nullptr) : Expected<bool>(true);
+    if (!q)
+        ret = Result::failure(q.error, 0);
+    else if (r)
+    {
+        if (cacheable)
+            cache.insert(key, r.value, std::move(deps));
+        touch("ANS");
+        arrayTable.erase("ANS");
+        ret = Result({ExprType::EXPR, varTable["ANS"] = r.value});
+    }
+    else
+        ret = Result::failure(r);
+    end();
+    return ret;
+}
+
+uint64_t Context::version(const std::string &name) const
+{
+    auto ite = versions.find(name);
+    if (ite != versions.end())
+        return ite->second;
+    return parent ? parent->version(name) : 0;
+}
+
+uint64_t Context::nextVersion()
+{
+    static std::atomic<uint64_t> last{0};
+    return ++last;
+}
+
+std::string Context::normalize(const TokenList &tkl)
+{
+    std::string key;
+    key.reserve(16 * tkl.size());
+    for (const auto &t : tkl)
+    {
+        if (t.isOperand())
+        {
+            key += '#';
+            appendOperand(key, t.getOperand());
+            key += ' ';
+        }
+        else if (t.isSymbol())
+            key.append(t.getSymbol()) += ' ';
+        else
+            key += t.toString();
+    }
+    return key;
+}
+
+bool Context::dependencies(const TokenList &tkl,
+                           ResultCache::Dependencies &deps) const
+{
+    // Every symbol the evaluation can look up appears in the input or in the
+    // body of a custom function reachable from it.
+    std::vector<const TokenList *> pending{&tkl};
+    std::unordered_map<std::string, bool> seen;
+    while (!pending.empty())
+    {
+        const TokenList *list = pending.back();
+        pending.pop_back();
+        for (const auto &t : *list)
+        {
+            if (!t.isSymbol() || !seen.emplace(t.getSymbol(), true).second)
+                continue;
+            const std::string &name = t.getSymbol();
+            deps.emplace_back(name, version(name));
+            const Function *f = findFunc(name);
+            if (!f)
+                continue;
+            if (!f->pure)
+                return false;
+            if (f->type == FuncType::CUSTOM)
+                pending.push_back(&f->tkList);
+        }
+    }
+    return true;
+}
+
+void Context::begin(const TokenList *tkl)
+{
+    depth = 0;
+    foreign = 0;
+    raised = false;
+    input = tkl;
+    stats = ExecStats();
+    memory = 0;
+    clockTick = 0;
+    spawnDepth = maxRecursionDepth;
+    started = std::chrono::steady_clock::now();
+    deadline = started + budget.timeout;
+    if (tiers.loops.size() >= TierTable::maxLoops)
+        for (auto ite = tiers.loops.begin(); ite != tiers.loops.end();)
+            ite = ite->second.code ? std::next(ite) : tiers.loops.erase(ite);
+}
+
+void Context::end()
+{
+    input = nullptr;
+    stats.elapsed = std::chrono::steady_clock::now() - started;
+}
+
+bool Context::overBudget(EVAL_EXCEPTION &code)
+{
+    if (cancellation && cancellation->cancelled())
+        code = EVAL_CANCELLED;
+    else if (budget.maxOperations && stats.operations > budget.maxOperations)
+        code = EVAL_OPERATION_LIMIT;
+    else if (budget.maxMemory && memory > budget.maxMemory)
+        code = EVAL_MEMORY_LIMIT;
+    else if (budget.timeout.count() && !(++clockTick & 255) &&
+             std::chrono::steady_clock::now() > deadline)
+        code = EVAL_DEADLINE_EXCEEDED;
+    else
+        return false;
+    return true;
+}
+
+void Context::allocate(size_t bytes)
+{
+    memory += bytes;
+    if (memory > stats.peakMemory)
+        stats.peakMemory = memory;
+}
+
+operand_t Context::evalExpr(const TokenList::const_iterator &beg,
+                            const TokenList::const_iterator &end)
+{
+    auto r = tryEvalExpr(beg, end);
+    EVAL_THROW(!r, r.error);
+    return r.value;
+}
+
+Expected<operand_t> Context::fail(EVAL_EXCEPTION e,
+                                  const TokenList::const_iterator &ite) const
+{
+    size_t pos = noPosition;
+    if (input && !foreign)
+        pos = static_cast<size_t>(ite - input->begin());
+    return Expected<operand_t>::failure(e, pos);
+}
+
+operand_t Context::raise(EVAL_EXCEPTION e)
+{
+    if (!raised)
+    {
+        raised = true;
+        raisedError = e;
+    }
+    return operand_zero;
+}
+
+Expected<operand_t> Context::tryEvalBody(const TokenList::const_iterator &beg,
+                                         const TokenList::const_iterator &end)
+{
+    ++foreign;
+    auto r = tryEvalExpr(beg, end);
+    --foreign;
+    return r;
+}
+
+Expected<operand_t> Context::call(const Function &f, const TokenList &args)
+{
+    // Builtins read their arguments unchecked, which would not be caught
+    // without exceptions.
+    if (f.type == FuncType::ORDINARY)
+    {
+        if (!f.accepts(args.size()))
+            return Expected<operand_t>::failure(EVAL_WRONG_NUMBER_OF_ARGS);
+        for (const auto &a : args)
+            if (!a.isOperand() && !f.takesSymbols)
+                return Expected<operand_t>::failure(EVAL_UNEXPECTED_TOKEN_TYPE);
+    }
+    ++foreign;
+    operand_t v = operand_zero;
+    bool thrown = false;
+    EVAL_EXCEPTION code = EVAL_INVALID_EXPR;
+    try
+    {
+        v = f.definition(args, *this);
+    }
+    catch (const EvalException &e)
+    {
+        thrown = true;
+        code = e.code;
+    }
+    --foreign;
+    if (raised)
+    {
+        raised = false;
+        return Expected<operand_t>::failure(raisedError);
+    }
+    if (thrown)
+        return Expected<operand_t>::failure(code);
+    return v;
+}
+
+Expected<operand_t> Context::tryEvalExpr(const TokenList::const_iterator &beg,
+                                         const TokenList::const_iterator &end)
+{
+    if (beg >= end)
+        return fail(EVAL_INVALID_EXPR, beg);
+    if (depth > maxRecursionDepth)
+        return fail(EVAL_STACK_OVERFLOW, beg);
+    ++stats.operations;
+    ++depth;
+    auto r = evalOperation(beg, end);
+    --depth;
+    return r;
+}
+
+Expected<TokenList::const_iterator>
+Context::splitOperation(const TokenList::const_iterator &beg,
+                        const TokenList::const_iterator &end) const
+{
+    using Result = Expected<TokenList::const_iterator>;
+    TokenList::const_iterator unmatched;
+    auto ite = findMainOperator(beg, end, unmatched);
+    if (unmatched != end)
+        return Result::failure(fail(EVAL_PAREN_MISMATCH, unmatched));
+    return Result(ite);
+}
+
+Expected<operand_t>
+Context::evalOperation(const TokenList::const_iterator &beg,
+                       const TokenList::const_iterator &end)
+{
+#define EVAL_TRY(var, expr) \
+    auto var = expr;        \
+    if (!var)               \
+        return var
+
+    if (beg + 1 == end) // "1", "x"
+    {
+        if (beg->isOperand())
+            return beg->getOperand();
+        if (!beg->isSymbol())
+            return fail(EVAL_INVALID_EXPR, beg);
+        const operand_t *v = findVar(beg->getSymbol());
+        if (v)
+            return *v;
+        const Array *a = findArray(beg->getSymbol());
+        if (a && a->size() == 1)
+            return (*a)[0];
+        return fail(a ? EVAL_NOT_SCALAR : EVAL_UNDEFINED_SYMBOL, beg);
+    }
+    auto split = splitOperation(beg, end);
+    if (!split)
+        return Expected<operand_t>::failure(split);
+    auto mainOperatorIte = split.value;
+    if (mainOperatorIte == beg && beg->isSub())
+    {
+        EVAL_TRY(r, tryEvalExpr(beg + 1, end));
+        return -r.value;
+    }
+    if (mainOperatorIte != end)
+    {
+        // Expensive operands may run at once, their results being taken in
+        // the order of the sequential path.
+        Range sides[] = {{beg, mainOperatorIte}, {mainOperatorIte + 1, end}};
+        Expected<operand_t> both[2];
+        bool joined = parallel.enabled && tryEvalParallel(sides, 2, both);
+        auto left = [&]
+        { return joined ? both[0] : tryEvalExpr(beg, mainOperatorIte); };
+        auto right = [&]
+        { return joined ? both[1] : tryEvalExpr(mainOperatorIte + 1, end); };
+        switch (mainOperatorIte->type)
+        {
+        case TokenType::ADD:
+        {
+            EVAL_TRY(l, left());
+            EVAL_TRY(r, right());
+            return l.value + r.value;
+        }
+        case TokenType::SUB:
+        {
+            EVAL_TRY(l, left());
+            EVAL_TRY(r, right());
+            return l.value - r.value;
+        }
+        case TokenType::MUL:
+        {
+            EVAL_TRY(l, left());
+            if (l.value == operand_zero)
+                return operand_zero;
+            EVAL_TRY(r, right());
+            return l.value * r.value;
+        }
+        case TokenType::DIV:
+        {
+            EVAL_TRY(denominator, right());
+            if (denominator.value == operand_zero)
+                return fail(EVAL_DIV_BY_ZERO, mainOperatorIte);
+            EVAL_TRY(l, left());
+            return l.value / denominator.value;
+        }
+        case TokenType::POW:
+        {
+            EVAL_TRY(l, left());
+            EVAL_TRY(r, right());
+#ifdef EVAL_MIXED_OPERAND
+            return pow(l.value, r.value);
+#else
+            return static_cast<operand_t>(std::pow(l.value, r.value));
+#endif
+        }
+        default:
+            return fail(EVAL_INVALID_EXPR, mainOperatorIte);
+        }
+    }
+    if (beg->isLParen()) // "(1+2)", "(1+2)*3"
+    {
+        if (!(end - 1)->isRParen())
+            return fail(EVAL_PAREN_MISMATCH, beg);
+        return tryEvalExpr(beg + 1, end - 1);
+    }
+
+    if (!beg->isSymbol())
+        return fail(EVAL_UNEXPECTED_TOKEN_TYPE, beg);
+    const Function *f = findFunc(beg->getSymbol());
+    if (!f && findArrayFunc(beg->getSymbol())) // "sum(linspace(0, 1, 9))"
+    {
+        auto a = tryEvalArray(beg, end);
+        if (!a)
+            return Expected<operand_t>::failure(a);
+        if (a.value.size() != 1)
+            return fail(EVAL_NOT_SCALAR, beg);
+        return a.value[0];
+    }
+    if (!f)
+        return fail(EVAL_UNDEFINED_SYMBOL, beg);
+    if (!(end - 1)->isRParen())
+        return fail(EVAL_PAREN_MISMATCH, end - 1);
+    auto r = f->tryEval(*this, beg, end);
+    if (!r && r.position == noPosition)
+        r.position = fail(r.error, beg).position;
+    return r;
+#undef EVAL_TRY
+}
+
+bool Context::DefFunc(const TokenList &tkl)
+{
+    auto r = tryDefFunc(tkl);
+    EVAL_THROW(!r, r.error);
+    return r.value;
+}
+
+Expected<bool> Context::tryDefFunc(const TokenList &tkl)
+{
+    if (tkl.size() < 6)
+        return false; // f(x)=x
+    if ((!tkl[0].isSymbol()) || (!(tkl[1].isLParen())))
+        return false;
+    bool foundEq = false;
+    TokenList::const_iterator rParenIte;
+    for (auto ite = tkl.begin() + 3; ite != tkl.end() - 1; ++ite)
+        if (ite->isRParen() && (ite + 1)->isEq())
+        {
+            foundEq = true;
+            rParenIte = ite;
+            break;
+        }
+    if (!foundEq)
+        return false;
+    std::unordered_map<std::string, size_t> parameterMap;
+
+    size_t idx = 0;
+    for (auto ite = tkl.begin() + 2; ite != rParenIte; ++ite)
+    {
+        if (!ite->isSymbol())
+            return false;
+        if (parameterMap.find(ite->getSymbol()) != parameterMap.end())
+            return Expected<bool>::failure(EVAL_REPEATED_PARAMETER_NAME,
+                                           ite - tkl.begin());
+        parameterMap[ite->getSymbol()] = idx++;
+        if (++ite == rParenIte)
+            break;
+        if (!ite->isComma())
+            return false;
+    }
+    Function f(rParenIte + 2, tkl.end());
+    std::vector<size_t> parameterOf(f.tkList.size(), parameterMap.size());
+    for (auto ite = f.tkList.begin(); ite != f.tkList.end(); ++ite)
+    {
+        if (ite->isSymbol())
+        {
+            auto i = parameterMap.find(ite->getSymbol());
+            if (parameterMap.end() != i)
+                parameterOf[ite - f.tkList.begin()] = i->second;
+        }
+    }
+    f.parameterTable.assign(parameterMap.size(), parameterOf);
+    f.form = RationalForm::recognize(*this, f);
+    auto q = reserve(tkl.begin()->getSymbol(), &f);
+    if (!q)
+        return Expected<bool>::failure(q.error, 0);
+    funcTable[tkl.begin()->getSymbol()] = std::move(f);
+    touch(tkl.begin()->getSymbol());
+    return true;
+}
+
+void Context::importMath()
+{
+    builtins = &Builtins::math();
+}
+
+void Context::defineMath()
+{
+#ifdef EVAL_DECIMAL_OPERAND
+    varTable["pi"] = 3.14159265358979323846264338328;
+    varTable["e"] = 2.71828182845904523536028747135;
+#endif
+
+    funcTable["eq"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return tkl[0].getOperand() == tkl[1].getOperand(); });
+
+    funcTable["neq"] =
+        Function(FuncType::ORDINARY,
+
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return tkl[0].getOperand() != tkl[1].getOperand(); });
+
+    funcTable["leq"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return tkl[0].getOperand() <= tkl[1].getOperand(); });
+
+    funcTable["lt"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return tkl[0].getOperand() < tkl[1].getOperand(); });
+
+    funcTable["geq"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return tkl[0].getOperand() >= tkl[1].getOperand(); });
+
+    funcTable["gt"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return tkl[0].getOperand() > tkl[1].getOperand(); });
+
+#ifdef EVAL_DECIMAL_OPERAND
+    funcTable["ln"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return log(tkl[0].getOperand()); },
+                 batchKernel<simd::ln>);
+
+    funcTable["lg"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return log10(tkl[0].getOperand()); },
+                 batchKernel<simd::lg>);
+
+    funcTable["log"] = Function(
+        FuncType::ORDINARY,
+        [](const TokenList &tkl, Context &) -> operand_t
+        { return log(tkl[1].getOperand()) / log(tkl[0].getOperand()); });
+
+    funcTable["sin"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return sin(tkl[0].getOperand()); },
+                 batchKernel<simd::sin>);
+    funcTable["cos"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return cos(tkl[0].getOperand()); },
+                 batchKernel<simd::cos>);
+    funcTable["tan"] = Function(FuncType::ORDINARY,
+                                [](const TokenList &tkl, Context &) -> operand_t
+                                { return tan(tkl[0].getOperand()); });
+
+    funcTable["asin"] = Function(FuncType::ORDINARY,
+                                 [](const TokenList &tkl, Context &) -> operand_t
+                                 { return asin(tkl[0].getOperand()); });
+    funcTable["acos"] = Function(FuncType::ORDINARY,
+                                 [](const TokenList &tkl, Context &) -> operand_t
+                                 { return acos(tkl[0].getOperand()); });
+    funcTable["atan"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return atan(tkl[0].getOperand()); },
+                 batchKernel<simd::atan>);
+
+    funcTable["gamma"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return tgamma(tkl[0].getOperand()); },
+                 batchKernel<simd::gamma>);
+
+    funcTable["floor"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 {
+#ifdef EVAL_MIXED_OPERAND
+                     return Number::integer(floor(tkl[0].getOperand()));
+#else
+                     return floor(tkl[0].getOperand());
+#endif
+                 });
+    funcTable["ceil"] = Function(FuncType::ORDINARY,
+                                 [](const TokenList &tkl, Context &) -> operand_t
+                                 {
+#ifdef EVAL_MIXED_OPERAND
+                                     return Number::integer(
+                                         ceil(tkl[0].getOperand()));
+#else
+                                     return ceil(tkl[0].getOperand());
+#endif
+                                 });
+    funcTable["exp"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return exp(tkl[0].getOperand()); },
+                 batchKernel<simd::exp>);
+    funcTable["erf"] =
+        Function(FuncType::ORDINARY,
+                 [](const TokenList &tkl, Context &) -> operand_t
+                 { return erf(tkl[0].getOperand()); },
+                 batchKernel<simd::erf>);
+#endif
+
+    funcTable["abs"] = Function(FuncType::ORDINARY,
+                                [](const TokenList &tkl, Context &) -> operand_t
+                                {
+#if defined(EVAL_MIXED_OPERAND)
+                                    auto x = tkl[0].getOperand();
+                                    return x < 0 ? -x : x;
+#elif defined(EVAL_DECIMAL_OPERAND)
+                                    return fabs(tkl[0].getOperand());
+#else
+            return abs(tkl[0].getOperand());
+#endif
+                                });
+
+    funcTable["rand"] = Function(
+        FuncType::ORDINARY,
+        [](const TokenList &tkl, Context &context) -> operand_t
+        {
+            return draw(tkl[0].getOperand(), tkl[1].getOperand(),
+                        context.random.next());
+        },
+        [](const operand_t *const *args, operand_t *out, size_t n,
+           Context &context)
+        {
+            // Same numbers as drawing one at a time.
+            uint64_t bits[64];
+            for (size_t i = 0; i < n; i += 64)
+            {
+                size_t m = n - i < 64 ? n - i : 64;
+                context.random.fill(bits, m);
+                for (size_t j = 0; j < m; ++j)
+                    out[i + j] = draw(args[0][i + j], args[1][i + j], bits[j]);
+            }
+        });
+
+    funcTable["rand"].pure = false;
+
+    funcTable["max"] = Function(FuncType::ORDINARY,
+                                [](const TokenList &tkl, Context &) -> operand_t
+                                {
+                                    operand_t m = tkl[0].getOperand();
+                                    for (const auto &t : tkl)
+                                        if (t.getOperand() > m)
+                                            m = t.getOperand();
+                                    return m;
+                                });
+    funcTable["min"] = Function(FuncType::ORDINARY,
+                                [](const TokenList &tkl, Context &) -> operand_t
+                                {
+                                    operand_t m = tkl[0].getOperand();
+                                    for (const auto &t : tkl)
+                                        if (t.getOperand() < m)
+                                            m = t.getOperand();
+                                    return m;
+                                });
+
+    funcTable["SUM"] =
+        Function(FuncType::HIGH_ORDER,
+                 [](const TokenList &tkl, Context &context) -> operand_t
+                 {
+                     return foldLoop(tkl, context, operand_zero,
+                                     [](operand_t s, operand_t t)
+                                     { return s + t; });
+                 });
+
+    funcTable["MUL"] =
+        Function(FuncType::HIGH_ORDER,
+                 [](const TokenList &tkl, Context &context) -> operand_t
+                 {
+                     return foldLoop(tkl, context, operand_one,
+                                     [](operand_t s, operand_t t)
+                                     { return s * t; });
+                 });
+
+    funcTable["IF_ELSE"] = Function(
+        FuncType::HIGH_ORDER,
+        [](const TokenList &tkl, Context &context) -> operand_t
+        {
+            auto ite = findArgSep(tkl.begin(), tkl.end());
+            auto cond = context.tryEvalExpr(tkl.begin(), ite);
+            if (!cond)
+                return context.raise(cond);
+            if (ite == tkl.end())
+                return context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+            auto trueIte = ++ite;
+            auto trueEndIte = findArgSep(trueIte, tkl.end());
+            if (trueEndIte == tkl.end())
+                return context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+            auto r = cond.value != operand_zero
+                         ? context.tryEvalExpr(trueIte, trueEndIte)
+                         : context.tryEvalExpr(trueEndIte + 1, tkl.end() - 1);
+            if (!r)
+                return context.raise(r);
+            return r.value;
+        });
+
+#ifdef EVAL_DECIMAL_OPERAND
+    funcTable["D"] = Function(
+        FuncType::ORDINARY,
+        [](const TokenList &tkl, Context &context) -> operand_t
+        {
+            if (tkl.size() < 2)
+                return context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+            if (!tkl[0].isSymbol())
+                return context.raise(EVAL_UNEXPECTED_TOKEN_TYPE);
+            std::vector<operand_t> args;
+            for (auto ite = tkl.begin() + 1; ite != tkl.end(); ++ite)
+            {
+                if (!ite->isOperand())
+                    return context.raise(EVAL_UNEXPECTED_TOKEN_TYPE);
+                args.push_back(ite->getOperand());
+            }
+            auto r = context.tryDerivative(tkl[0].getSymbol(), args);
+            if (!r)
+                return context.raise(r);
+            return r.value;
+        });
+
+    importSolvers();
+
+    // Derivative rules
+    auto constant = [](const TokenList &tkl, operand_t *d)
+    {
+        for (size_t i = 0; i < tkl.size(); ++i)
+            d[i] = operand_zero;
+    };
+    for (auto name : {"eq", "neq", "leq", "lt", "geq", "gt", "floor", "ceil",
+                      "rand"})
+        funcTable[name].derivative = constant;
+
+    funcTable["ln"].derivative = [](const TokenList &tkl, operand_t *d)
+    { d[0] = 1 / tkl[0].getOperand(); };
+    funcTable["lg"].derivative = [](const TokenList &tkl, operand_t *d)
+    { d[0] = 1 / (tkl[0].getOperand() * log(10.0L)); };
+    funcTable["log"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t a = tkl[0].getOperand(), b = tkl[1].getOperand();
+        d[0] = -log(b) / (a * log(a) * log(a));
+        d[1] = 1 / (b * log(a));
+    };
+    funcTable["sin"].derivative = [](const TokenList &tkl, operand_t *d)
+    { d[0] = cos(tkl[0].getOperand()); };
+    funcTable["cos"].derivative = [](const TokenList &tkl, operand_t *d)
+    { d[0] = -sin(tkl[0].getOperand()); };
+    funcTable["tan"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t c = cos(tkl[0].getOperand());
+        d[0] = 1 / (c * c);
+    };
+    funcTable["asin"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t x = tkl[0].getOperand();
+        d[0] = 1 / sqrt(1 - x * x);
+    };
+    funcTable["acos"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t x = tkl[0].getOperand();
+        d[0] = -1 / sqrt(1 - x * x);
+    };
+    funcTable["atan"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t x = tkl[0].getOperand();
+        d[0] = 1 / (1 + x * x);
+    };
+    funcTable["gamma"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t x = tkl[0].getOperand();
+        d[0] = tgamma(x) * digamma(x);
+    };
+    funcTable["exp"].derivative = [](const TokenList &tkl, operand_t *d)
+    { d[0] = exp(tkl[0].getOperand()); };
+    funcTable["erf"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t x = tkl[0].getOperand();
+        d[0] = 1.12837916709551257389615890312L * exp(-x * x); // 2/sqrt(pi)
+    };
+    funcTable["abs"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        operand_t x = tkl[0].getOperand();
+        d[0] = x > 0 ? 1 : x < 0 ? -1 : 0;
+    };
+    // max and min follow the argument they return
+    funcTable["max"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        size_t m = 0;
+        for (size_t i = 0; i < tkl.size(); ++i)
+        {
+            d[i] = operand_zero;
+            if (tkl[i].getOperand() > tkl[m].getOperand())
+                m = i;
+        }
+        d[m] = operand_one;
+    };
+    funcTable["min"].derivative = [](const TokenList &tkl, operand_t *d)
+    {
+        size_t m = 0;
+        for (size_t i = 0; i < tkl.size(); ++i)
+        {
+            d[i] = operand_zero;
+            if (tkl[i].getOperand() < tkl[m].getOperand())
+                m = i;
+        }
+        d[m] = operand_one;
+    };
+#endif
+
+    // The arguments of the ORDINARY builtins, checked by Context::call.
+    for (auto &f : funcTable)
+        if (f.second.type == FuncType::ORDINARY)
+            f.second.minArgs = f.second.maxArgs = 1;
+    for (auto name : {"eq", "neq", "leq", "lt", "geq", "gt", "log", "rand"})
+        if (funcTable.count(name))
+            funcTable[name].minArgs = funcTable[name].maxArgs = 2;
+    for (auto name : {"max", "min"})
+        funcTable[name].maxArgs = static_cast<size_t>(-1);
+    if (funcTable.count("D"))
+    {
+        funcTable["D"].minArgs = 2;
+        funcTable["D"].maxArgs = static_cast<size_t>(-1);
+        funcTable["D"].takesSymbols = true;
+    }
+
+    importArrays();
+}
 } // namespace eval
\ No newline at end of file
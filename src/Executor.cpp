@@ -0,0 +1,240 @@
+#include <evaluator/Executor.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace eval
+{
+Executor::Executor(const Context& library, unsigned int threads,
+                   size_t maxBatch)
+    : maxBatch(std::max<size_t>(maxBatch, 1)),
+      library(std::make_shared<const Context>(library))
+{
+    if (!threads) threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned int i = 0; i < threads; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    for (unsigned int i = 0; i < threads; ++i)
+        this->threads.emplace_back(&Executor::work, this, i);
+}
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCv.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+std::future<Executor::Result> Executor::submit(const std::string& expression)
+{
+    Task task;
+    task.text = expression;
+    auto future = task.promise.get_future();
+    push(std::move(task));
+    return future;
+}
+
+void Executor::submit(const std::string& expression, Callback done)
+{
+    Task task;
+    task.text = expression;
+    task.done = std::move(done);
+    push(std::move(task));
+}
+
+std::future<Executor::Result> Executor::call(const std::string& name,
+                                             std::vector<operand_t> args)
+{
+    Task task;
+    task.call = true;
+    task.text = name;
+    task.args = std::move(args);
+    auto future = task.promise.get_future();
+    push(std::move(task));
+    return future;
+}
+
+void Executor::call(const std::string& name, std::vector<operand_t> args,
+                    Callback done)
+{
+    Task task;
+    task.call = true;
+    task.text = name;
+    task.args = std::move(args);
+    task.done = std::move(done);
+    push(std::move(task));
+}
+
+Expected<std::pair<ExprType, operand_t>> Executor::define(
+    const std::string& input)
+{
+    std::lock_guard<std::mutex> order(defineMutex);
+    std::shared_ptr<const Context> current;
+    {
+        std::lock_guard<std::mutex> lock(libraryMutex);
+        current = library;
+    }
+    auto next = std::make_shared<Context>(*current);
+    auto r = next->tryExec(input);
+    if (!r) return r;
+    {
+        std::lock_guard<std::mutex> lock(libraryMutex);
+        library = std::move(next);
+    }
+    generation.fetch_add(1);
+    return r;
+}
+
+Executor::Stats Executor::stats() const
+{
+    Stats s;
+    s.tasks = tasks.load(std::memory_order_relaxed);
+    s.batches = batches.load(std::memory_order_relaxed);
+    s.batchedCalls = batchedCalls.load(std::memory_order_relaxed);
+    s.stolen = stolen.load(std::memory_order_relaxed);
+    return s;
+}
+
+void Executor::push(Task task)
+{
+    // Runs of maxBatch consecutive tasks share a queue, so that they can
+    // batch, and idle threads steal what the owner has not got to.
+    task.ticket = tickets.fetch_add(1);
+    size_t i = static_cast<size_t>(task.ticket / maxBatch) % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[i]->mutex);
+        queues[i]->tasks.push_back(std::move(task));
+    }
+    // Pairs with the check of take: either the sleeper sees the task or
+    // this sees the sleeper. A thread is woken for each of the first tasks
+    // and for every maxBatch more, those awake take the rest before they
+    // sleep again.
+    size_t before = queued.fetch_add(1);
+    if ((before < queues.size() || before % maxBatch == 0) && sleeping.load())
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCv.notify_one();
+    }
+}
+
+bool Executor::take(size_t self, std::vector<Task>& batch)
+{
+    while (true)
+    {
+        // The own queue from the front, then half of another one from the
+        // back.
+        for (size_t k = 0; k < queues.size() && batch.empty(); ++k)
+        {
+            auto& q = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            size_t m = std::min(k ? (q.tasks.size() + 1) / 2 : q.tasks.size(),
+                                maxBatch);
+            if (!m) continue;
+            auto first = k ? q.tasks.end() - m : q.tasks.begin();
+            std::move(first, first + m, std::back_inserter(batch));
+            q.tasks.erase(first, first + m);
+            queued.fetch_sub(m);
+            if (k) stolen.fetch_add(m, std::memory_order_relaxed);
+        }
+        if (!batch.empty()) return true;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1);
+        sleepCv.wait(lock, [this] { return stopping || queued.load(); });
+        sleeping.fetch_sub(1);
+        if (stopping && !queued.load()) return false;
+    }
+}
+
+void Executor::work(size_t self)
+{
+    std::shared_ptr<const Context> base;
+    std::unique_ptr<Context> local;
+    uint64_t seen = 0;
+    std::vector<Task> batch;
+    std::vector<bool> handled;
+    std::vector<size_t> group;
+    std::vector<operand_t> values;
+    std::vector<const operand_t*> columns;
+    std::vector<Result> results;
+    // Calls of functions that can draw rand run one by one, each on the
+    // stream of its task.
+    std::unordered_map<std::string, bool> purity;
+    auto pure = [&](const std::string& name)
+    {
+        auto ite = purity.find(name);
+        if (ite == purity.end())
+        {
+            TokenList call;
+            call.push_back(Token(name));
+            ite = purity.emplace(name, local->deterministic(call)).first;
+        }
+        return ite->second;
+    };
+
+    while (take(self, batch))
+    {
+        uint64_t current = generation.load();
+        if (!local || current != seen)
+        {
+            {
+                std::lock_guard<std::mutex> lock(libraryMutex);
+                base = library;
+            }
+            local = std::make_unique<Context>(base->fork());
+            purity.clear();
+            seen = current;
+        }
+
+        auto finish = [&batch](size_t i, const Result& r)
+        {
+            auto& t = batch[i];
+            if (t.done)
+                t.done(r);
+            else
+                t.promise.set_value(r);
+        };
+        handled.assign(batch.size(), false);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            if (handled[i]) continue;
+            const auto& t = batch[i];
+            if (!t.call || !pure(t.text))
+            {
+                local->random = base->random.stream(t.ticket);
+                finish(i, t.call ? local->tryCall(t.text, t.args)
+                                 : local->tryEval(t.text));
+                continue;
+            }
+            // Every call of the same function in the batch, as one.
+            group.clear();
+            for (size_t j = i; j < batch.size(); ++j)
+                if (!handled[j] && batch[j].call && batch[j].text == t.text &&
+                    batch[j].args.size() == t.args.size())
+                {
+                    group.push_back(j);
+                    handled[j] = true;
+                }
+            size_t arity = t.args.size(), n = group.size();
+            values.resize(arity * n);
+            columns.resize(arity);
+            for (size_t a = 0; a < arity; ++a)
+            {
+                columns[a] = values.data() + a * n;
+                for (size_t k = 0; k < n; ++k)
+                    values[a * n + k] = batch[group[k]].args[a];
+            }
+            results.resize(n);
+            local->tryCall(t.text, columns.data(), arity, n, results.data());
+            for (size_t k = 0; k < n; ++k)
+                finish(group[k], results[k]);
+            if (n > 1) batchedCalls.fetch_add(n, std::memory_order_relaxed);
+        }
+        tasks.fetch_add(batch.size(), std::memory_order_relaxed);
+        batches.fetch_add(1, std::memory_order_relaxed);
+        batch.clear();
+    }
+}
+}  // namespace eval
\ No newline at end of file
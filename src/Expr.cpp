@@ -0,0 +1,549 @@
+#include <evaluator/Expr.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+
+#include <evaluator/Context.h>
+#ifdef EVAL_DECIMAL_OPERAND
+#include <evaluator/MathKernels.h>
+#endif
+
+namespace eval
+{
+namespace
+{
+constexpr size_t npos = static_cast<size_t>(-1);
+constexpr size_t maxNodes = 4096;
+constexpr size_t maxWork = 16 * maxNodes;  // nodes built before sharing
+constexpr size_t typicalBatch = 128;       // for memory accounting
+
+struct NodeHash
+{
+    size_t operator()(const Node& node) const
+    {
+        size_t h = std::hash<int>()(static_cast<int>(node.type));
+        auto mix = [&h](size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+        mix(std::hash<operand_t>()(node.value));
+        mix(std::hash<std::string>()(node.symbol));
+        mix(std::hash<const Function*>()(node.func));
+        for (auto a : node.args) mix(a);
+        return h;
+    }
+};
+
+struct NodeEqual
+{
+    bool operator()(const Node& a, const Node& b) const
+    {
+        return a.type == b.type && a.value == b.value &&
+               std::signbit(a.value) == std::signbit(b.value) &&
+#ifdef EVAL_MIXED_OPERAND
+               a.value.integral == b.value.integral &&
+#endif
+               a.symbol == b.symbol && a.func == b.func && a.args == b.args;
+    }
+};
+
+// Parameter bindings of an inlined custom function: token offset in its
+// body -> node holding the argument.
+struct Frame
+{
+    const TokenList* tokens;
+    std::vector<size_t> slots;
+
+    size_t find(const TokenList::const_iterator& ite) const
+    {
+        return slots[ite - tokens->begin()];
+    }
+};
+
+class Compiler
+{
+   public:
+    const Context& context;
+    const std::string& lane;
+    std::vector<Node>& nodes;
+    size_t& deduplicated;
+    std::vector<std::string>& functions;
+    std::vector<const Function*> inlining;
+    // Hash consing: every pure node exists once, so a subexpression that
+    // occurs several times, in one body or across the expressions of an
+    // Expr, is computed once per batch.
+    std::unordered_map<Node, size_t, NodeHash, NodeEqual> unique;
+    size_t work = 0;
+
+    Compiler(const Context& c, const std::string& l, std::vector<Node>& n,
+             size_t& d, std::vector<std::string>& f)
+        : context(c), lane(l), nodes(n), deduplicated(d), functions(f)
+    {
+        for (size_t i = 0; i < nodes.size(); ++i)
+            if (pure(nodes[i])) unique.emplace(nodes[i], i);
+    }
+
+    static bool pure(const Node& node)
+    {
+        return node.type != NodeType::CALL || node.func->pure;
+    }
+
+    size_t push(Node node)
+    {
+        if (++work > maxWork) return npos;
+        for (auto a : node.args)
+            if (a == npos) return npos;
+        if (pure(node))
+        {
+            auto ite = unique.find(node);
+            if (ite != unique.end())
+            {
+                ++deduplicated;
+                return ite->second;
+            }
+        }
+        if (nodes.size() >= maxNodes) return npos;
+        nodes.push_back(std::move(node));
+        if (pure(nodes.back())) unique.emplace(nodes.back(), nodes.size() - 1);
+        return nodes.size() - 1;
+    }
+
+    size_t push(NodeType type, std::vector<size_t> args = {})
+    {
+        return push(Node{type, operand_zero, {}, nullptr, std::move(args)});
+    }
+
+    // Builds a RationalForm as the interpreter evaluates it.
+    struct FormOps
+    {
+        using Value = size_t;
+        Compiler& c;
+        size_t constant(const operand_t& v)
+        {
+            return c.push(Node{NodeType::CONST, v, {}, nullptr, {}});
+        }
+        size_t add(size_t a, size_t b) { return c.push(NodeType::ADD, {a, b}); }
+        size_t mul(size_t a, size_t b) { return c.push(NodeType::MUL, {a, b}); }
+        size_t div(size_t a, size_t b) { return c.push(NodeType::DIV, {a, b}); }
+    };
+
+    size_t form(const RationalForm& f, const std::vector<size_t>& args)
+    {
+        FormOps ops{*this};
+        return f.evaluate(ops, args.data());
+    }
+
+    size_t symbol(const std::string& name)
+    {
+        if (name == lane)
+            return push(Node{NodeType::LANE, operand_zero, name, nullptr, {}});
+        if (!context.findVar(name)) return npos;
+        return push(Node{NodeType::VAR, operand_zero, name, nullptr, {}});
+    }
+
+    // Mirrors Context::evalExpr.
+    size_t build(const TokenList::const_iterator& beg,
+                 const TokenList::const_iterator& end, const Frame* frame)
+    {
+        if (beg >= end) return npos;
+        if (beg + 1 == end)
+        {
+            if (frame && frame->find(beg) != npos) return frame->find(beg);
+            if (beg->isOperand())
+                return push(Node{NodeType::CONST, beg->getOperand(), {},
+                                 nullptr, {}});
+            if (!beg->isSymbol()) return npos;
+            return symbol(beg->getSymbol());
+        }
+
+        TokenList::const_iterator unmatched;
+        auto mainOperatorIte = findMainOperator(beg, end, unmatched);
+        if (unmatched != end) return npos;
+        if (mainOperatorIte == beg && beg->isSub())
+            return push(NodeType::NEG, {build(beg + 1, end, frame)});
+        if (mainOperatorIte != end)
+        {
+            NodeType type;
+            switch (mainOperatorIte->type)
+            {
+            case TokenType::ADD:
+                type = NodeType::ADD;
+                break;
+            case TokenType::SUB:
+                type = NodeType::SUB;
+                break;
+            case TokenType::MUL:
+                type = NodeType::MUL;
+                break;
+            case TokenType::DIV:
+                type = NodeType::DIV;
+                break;
+            case TokenType::POW:
+                type = NodeType::POW;
+                break;
+            default:
+                return npos;
+            }
+            size_t l = build(beg, mainOperatorIte, frame);
+            return push(type, {l, build(mainOperatorIte + 1, end, frame)});
+        }
+        if (beg->isLParen())
+        {
+            if (!(end - 1)->isRParen()) return npos;
+            return build(beg + 1, end - 1, frame);
+        }
+        return call(beg, end, frame);
+    }
+
+    size_t call(const TokenList::const_iterator& beg,
+                const TokenList::const_iterator& end, const Frame* frame)
+    {
+        if (!beg->isSymbol() || !(end - 1)->isRParen()) return npos;
+        if (frame && frame->find(beg) != npos) return npos;  // f(x), f a param
+        const Function* fp = context.findFunc(beg->getSymbol());
+        if (!fp) return npos;
+        const Function& f = *fp;
+        if (std::find(functions.begin(), functions.end(), beg->getSymbol()) ==
+            functions.end())
+            functions.push_back(beg->getSymbol());
+        if (f.type == FuncType::HIGH_ORDER) return npos;
+
+        // Mirrors Function::eval.
+        std::vector<size_t> args;
+        auto start = beg + 2;
+        for (auto ite = beg + 2; ite != end; ++ite)
+        {
+            ite = findArgSep(start, end);
+            if (ite - start == 1 && start->isSymbol() &&
+                !(frame && frame->find(start) != npos))
+            {
+                // a bare function name is passed by name, not supported here
+                args.push_back(symbol(start->getSymbol()));
+            }
+            else
+                args.push_back(build(start, ite, frame));
+            if (args.back() == npos) return npos;
+            start = ite + 1;
+        }
+
+        if (f.type == FuncType::ORDINARY)
+        {
+            if (!f.accepts(args.size())) return npos;
+            return push(
+                Node{NodeType::CALL, operand_zero, {}, &f, std::move(args)});
+        }
+
+        if (args.size() != f.parameterTable.size()) return npos;
+        if (f.form) return form(*f.form, args);
+        for (auto g : inlining)
+            if (g == &f) return npos;
+        Frame callee{&f.tkList, std::vector<size_t>(f.tkList.size(), npos)};
+        for (size_t i = 0; i < args.size(); ++i)
+            for (auto idx : f.parameterTable[i]) callee.slots[idx] = args[i];
+        inlining.push_back(&f);
+        size_t body = build(f.tkList.begin(), f.tkList.end(), &callee);
+        inlining.pop_back();
+        return body;
+    }
+};
+
+operand_t powInt(operand_t a, long long n)
+{
+    bool inv = n < 0;
+    unsigned long long k = inv ? -n : n;
+    operand_t r = operand_one;
+    while (k)
+    {
+        if (k & 1) r *= a;
+        a *= a;
+        k >>= 1;
+    }
+    return inv ? operand_one / r : r;
+}
+}  // namespace
+
+bool Expr::compile(const Context& context,
+                   const TokenList::const_iterator& beg,
+                   const TokenList::const_iterator& end,
+                   const std::string& lane)
+{
+    nodes.clear();
+    roots.clear();
+    functions.clear();
+    deduplicated = 0;
+    this->lane = lane;
+    return add(context, beg, end);
+}
+
+bool Expr::compile(const Context& context, const Function& f)
+{
+    nodes.clear();
+    roots.clear();
+    functions.clear();
+    deduplicated = 0;
+    lane.clear();
+    if (f.type != FuncType::CUSTOM) return false;
+    Compiler c(context, lane, nodes, deduplicated, functions);
+    Frame frame{&f.tkList, std::vector<size_t>(f.tkList.size(), npos)};
+    std::vector<size_t> params;
+    for (size_t i = 0; i < f.parameterTable.size(); ++i)
+    {
+        params.push_back(c.push(Node{NodeType::PARAM, static_cast<operand_t>(i),
+                                     {}, nullptr, {}}));
+        for (auto idx : f.parameterTable[i]) frame.slots[idx] = params.back();
+    }
+    c.inlining.push_back(&f);
+    size_t root = f.form ? c.form(*f.form, params)
+                         : c.build(f.tkList.begin(), f.tkList.end(), &frame);
+    if (root == npos)
+    {
+        nodes.clear();
+        functions.clear();
+        return false;
+    }
+    roots.push_back(root);
+    return true;
+}
+
+bool Expr::add(const Context& context, const TokenList::const_iterator& beg,
+               const TokenList::const_iterator& end)
+{
+    size_t size = nodes.size(), shared = deduplicated;
+    size_t reached = functions.size();
+    Compiler c(context, lane, nodes, deduplicated, functions);
+    size_t root = c.build(beg, end, nullptr);
+    if (root == npos)
+    {
+        nodes.resize(size);
+        functions.resize(reached);
+        deduplicated = shared;
+        return false;
+    }
+    roots.push_back(root);
+    return true;
+}
+
+bool Expr::evalBatch(Context& context, const operand_t* const* inputs,
+                     operand_t* out, size_t n)
+{
+    // A definition called from a node can get this Expr evaluated again.
+    if (running)
+    {
+        std::vector<operand_t> own;
+        return run(context, inputs, out, n, own);
+    }
+    running = true;
+    bool ok = run(context, inputs, out, n, buffer);
+    running = false;
+    return ok;
+}
+
+bool Expr::run(Context& context, const operand_t* const* inputs,
+               operand_t* out, size_t n, std::vector<operand_t>& buffer)
+{
+    buffer.resize(nodes.size() * n);
+    std::vector<const operand_t*> argv;
+    TokenList argTokens;
+#ifdef EVAL_DECIMAL_OPERAND
+    std::vector<double> dx, dy;
+#endif
+
+    for (size_t k = 0; k < nodes.size(); ++k)
+    {
+        const Node& node = nodes[k];
+        operand_t* r = &buffer[k * n];
+        auto arg = [&](size_t i) -> const operand_t*
+        { return &buffer[node.args[i] * n]; };
+
+        switch (node.type)
+        {
+        case NodeType::CONST:
+            for (size_t i = 0; i < n; ++i) r[i] = node.value;
+            break;
+        case NodeType::VAR:
+        {
+            const operand_t* v = context.findVar(node.symbol);
+            if (!v) return false;
+            for (size_t i = 0; i < n; ++i) r[i] = *v;
+            break;
+        }
+        case NodeType::LANE:
+            for (size_t i = 0; i < n; ++i) r[i] = inputs[0][i];
+            break;
+        case NodeType::PARAM:
+        {
+            auto p = inputs[static_cast<size_t>(node.value)];
+            for (size_t i = 0; i < n; ++i) r[i] = p[i];
+            break;
+        }
+        case NodeType::NEG:
+        {
+            auto a = arg(0);
+            for (size_t i = 0; i < n; ++i) r[i] = -a[i];
+            break;
+        }
+        case NodeType::ADD:
+        {
+            auto a = arg(0), b = arg(1);
+            for (size_t i = 0; i < n; ++i) r[i] = a[i] + b[i];
+            break;
+        }
+        case NodeType::SUB:
+        {
+            auto a = arg(0), b = arg(1);
+            for (size_t i = 0; i < n; ++i) r[i] = a[i] - b[i];
+            break;
+        }
+        case NodeType::MUL:
+        {
+            auto a = arg(0), b = arg(1);
+            for (size_t i = 0; i < n; ++i)
+                r[i] = a[i] == operand_zero ? operand_zero : a[i] * b[i];
+            break;
+        }
+        case NodeType::DIV:
+        {
+            auto a = arg(0), b = arg(1);
+            for (size_t i = 0; i < n; ++i)
+                if (b[i] == operand_zero) return false;
+            for (size_t i = 0; i < n; ++i) r[i] = a[i] / b[i];
+            break;
+        }
+        case NodeType::POW:
+        {
+            auto a = arg(0), b = arg(1);
+            const Node& e = nodes[node.args[1]];
+            bool fast = !exact && !context.strictMath;
+            if (fast && e.type == NodeType::CONST &&
+                e.value >= -64 && e.value <= 64 &&
+                e.value == static_cast<long long>(e.value))
+            {
+                for (size_t i = 0; i < n; ++i)
+                    r[i] = powInt(a[i], static_cast<long long>(e.value));
+                break;
+            }
+#ifdef EVAL_DECIMAL_OPERAND
+            bool integers = false;
+#ifdef EVAL_MIXED_OPERAND
+            // Integer powers of integers stay exact.
+            for (size_t i = 0; i < n; ++i)
+                integers = integers || (a[i].integral && b[i].integral);
+#endif
+            if (fast && !integers)
+            {
+                dx.assign(a, a + n);
+                dy.assign(b, b + n);
+                simd::pow(dx.data(), dy.data(), dx.data(), n);
+                for (size_t i = 0; i < n; ++i) r[i] = dx[i];
+                break;
+            }
+#endif
+#ifdef EVAL_MIXED_OPERAND
+            for (size_t i = 0; i < n; ++i) r[i] = pow(a[i], b[i]);
+#else
+            for (size_t i = 0; i < n; ++i) r[i] = std::pow(a[i], b[i]);
+#endif
+            break;
+        }
+        case NodeType::CALL:
+        {
+            argv.clear();
+            for (size_t j = 0; j < node.args.size(); ++j) argv.push_back(arg(j));
+            if (!exact && !context.strictMath && node.func->batchDefinition)
+            {
+                node.func->batchDefinition(argv.data(), r, n, context);
+                break;
+            }
+            argTokens.assign(argv.size(), Token(operand_zero));
+            for (size_t i = 0; i < n; ++i)
+            {
+                for (size_t j = 0; j < argv.size(); ++j)
+                    argTokens[j].value.emplace<1>(argv[j][i]);
+                if (!exact)
+                {
+                    r[i] = node.func->definition(argTokens, context);
+                    continue;
+                }
+                // Errors are left for the interpreter to report.
+                auto v = context.call(*node.func, argTokens);
+                if (!v) return false;
+                r[i] = v.value;
+            }
+            break;
+        }
+        }
+    }
+    for (size_t i = 0; i < roots.size(); ++i)
+        std::copy(&buffer[roots[i] * n], &buffer[roots[i] * n] + n,
+                  out + i * n);
+    return true;
+}
+
+LaneBody::LaneBody(Context& context, const TokenList::const_iterator& beg,
+                   const TokenList::const_iterator& end,
+                   const std::string& var)
+    : context(context), tokens(beg, end), var("#" + var), held(0)
+{
+    for (auto& t : tokens)
+        if (t.isSymbol() && t.getSymbol() == var) t.replace(Token(this->var));
+    slot = &context.varTable.insert(std::make_pair(this->var, operand_zero))
+                .first->second;
+    if (context.tiering.enabled)
+        key = Context::normalize(tokens);
+    else
+    {
+        auto code = std::make_shared<Expr>();
+        if (code->compile(context, tokens.begin(), tokens.end(), this->var))
+            attach(std::move(code));
+    }
+    if (!expr) attach(nullptr);
+}
+
+LaneBody::~LaneBody()
+{
+    context.release(held);
+    context.varTable.erase(var);
+}
+
+void LaneBody::attach(std::shared_ptr<Expr> code)
+{
+    context.release(held);
+    expr = std::move(code);
+    held = tokens.size() * sizeof(Token);
+    if (expr)
+        held += expr->nodes.size() *
+                (sizeof(Node) + typicalBatch * sizeof(operand_t));
+    context.allocate(held);
+}
+
+bool LaneBody::eval(const operand_t* x, operand_t* out, size_t n)
+{
+    EVAL_EXCEPTION code;
+    if (context.overBudget(code))
+    {
+        context.raise(code);
+        return false;
+    }
+    if (!key.empty())
+    {
+        auto hot = context.tieredLoop(key, tokens, var, n);
+        if (hot != expr) attach(std::move(hot));
+    }
+    if (expr)
+    {
+        context.stats.operations += expr->nodes.size() * n;
+        if (expr->evalBatch(context, x, out, n)) return true;
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        *slot = x[i];
+        auto r = context.tryEvalExpr(tokens.begin(), tokens.end());
+        if (!r)
+        {
+            context.raise(r);
+            return false;
+        }
+        out[i] = r.value;
+    }
+    return true;
+}
+}  // namespace eval
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include <evaluator/Format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace eval
+{
+namespace
+{
+// Enough for any shortest form. Fixed forms of large long doubles run to
+// thousands of digits.
+constexpr size_t inlineSize = 64;
+
+template <typename T>
+char* formatDecimal(char* first, char* last, T v, const FormatOptions& options)
+{
+    std::to_chars_result r;
+    switch (options.style)
+    {
+        case FloatStyle::SHORTEST:
+            r = std::to_chars(first, last, v);
+            break;
+        case FloatStyle::FIXED:
+            r = std::to_chars(first, last, v, std::chars_format::fixed,
+                              options.precision);
+            break;
+        case FloatStyle::SCIENTIFIC:
+            r = std::to_chars(first, last, v, std::chars_format::scientific,
+                              options.precision);
+            break;
+        default:
+            r = std::to_chars(first, last, v, std::chars_format::general,
+                              options.precision);
+            break;
+    }
+    return r.ec == std::errc() ? r.ptr : nullptr;
+}
+
+template <typename T>
+char* formatInteger(char* first, char* last, T v)
+{
+    auto r = std::to_chars(first, last, v);
+    return r.ec == std::errc() ? r.ptr : nullptr;
+}
+
+void putLittleEndian(char* out, uint64_t bits)
+{
+    for (size_t k = 0; k < binarySize; ++k)
+        out[k] = static_cast<char>(bits >> (8 * k));
+}
+}  // namespace
+
+char* format(char* first, char* last, const operand_t& v,
+             const FormatOptions& options)
+{
+#if defined(EVAL_MIXED_OPERAND)
+    if (v.integral) return formatInteger(first, last, v.i);
+    if (options.asDouble)
+        return formatDecimal(first, last, static_cast<double>(v.d), options);
+    return formatDecimal(first, last, v.d, options);
+#elif defined(EVAL_DECIMAL_OPERAND)
+    if (options.asDouble)
+        return formatDecimal(first, last, static_cast<double>(v), options);
+    return formatDecimal(first, last, v, options);
+#else
+    (void)options;
+    return formatInteger(first, last, v);
+#endif
+}
+
+std::string toString(const operand_t& v, const FormatOptions& options)
+{
+    char buf[inlineSize];
+    if (auto end = format(buf, buf + sizeof(buf), v, options))
+        return std::string(buf, end);
+    std::string s(inlineSize, '\0');
+    char* end;
+    do
+    {
+        s.resize(2 * s.size());
+        end = format(&s[0], &s[0] + s.size(), v, options);
+    } while (!end);
+    s.resize(end - s.data());
+    return s;
+}
+
+char* encode(char* out, const operand_t& v)
+{
+#if defined(EVAL_DECIMAL_OPERAND)
+    double d = static_cast<double>(static_cast<decimal_t>(v));
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+#else
+    uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(v));
+#endif
+    putLittleEndian(out, bits);
+    return out + binarySize;
+}
+
+ResultWriter::ResultWriter(std::FILE* file, Mode mode,
+                           const FormatOptions& options, size_t bufferSize)
+    : file(file), mode(mode), options(options),
+      buffer(std::max(bufferSize, 2 * inlineSize))
+{
+}
+
+char* ResultWriter::reserve(size_t n)
+{
+    if (buffer.size() - used < n)
+    {
+        flush();
+        if (buffer.size() < n) buffer.resize(n);
+    }
+    return buffer.data() + used;
+}
+
+void ResultWriter::write(const operand_t& v)
+{
+    if (mode == Mode::BINARY)
+    {
+        used = encode(reserve(binarySize), v) - buffer.data();
+        return;
+    }
+    char* p = reserve(inlineSize);
+    if (char* end = format(p, buffer.data() + buffer.size(), v, options))
+        used = end - buffer.data();
+    else
+        write(toString(v, options));
+    *reserve(1) = '\n';
+    ++used;
+}
+
+void ResultWriter::write(const operand_t* v, size_t n)
+{
+    if (mode == Mode::BINARY)
+        for (size_t i = 0; i < n; ++i)
+            used = encode(reserve(binarySize), v[i]) - buffer.data();
+    else
+        for (size_t i = 0; i < n; ++i) write(v[i]);
+}
+
+void ResultWriter::write(std::string_view text)
+{
+    std::memcpy(reserve(text.size()), text.data(), text.size());
+    used += text.size();
+}
+
+bool ResultWriter::flush()
+{
+    if (used && std::fwrite(buffer.data(), 1, used, file) != used)
+        failed = true;
+    used = 0;
+    return !failed;
+}
+}  // namespace eval
\ No newline at end of file
@@ -1,64 +1,145 @@
-#include <evaluator/Function.h>
-
-#include <evaluator/Context.h>
-namespace eval
-{
-Function::Function(FuncType t, decltype(definition) def)
-    : type(t), definition(def)
-{
-}
-
-Function::Function(const TokenList::const_iterator& beg,
-                   const TokenList::const_iterator& end)
-    : type(FuncType::CUSTOM), tkList(beg, end)
-{
-}
-
-void Function::setArguments(const TokenList& args, TokenList& tkl)
-{
-    EVAL_THROW(type == FuncType::CUSTOM && args.size() != parameterTable.size(),
-               EVAL_WRONG_NUMBER_OF_ARGS);
-    for (size_t i = 0; i < args.size(); ++i)
-        for (auto& idx : parameterTable[i]) tkl[idx] = args[i];
-}
-
-operand_t Function::eval(Context& context,
-                         const TokenList::const_iterator& beg,
-                         const TokenList::const_iterator& end)
-{
-    if (type == FuncType::HIGH_ORDER)
-        return definition(TokenList(beg + 2, end), context);
-
-    TokenList args;
-    args.reserve(parameterTable.size() + 1);
-
-    auto start = beg + 2;
-    for (auto ite = beg + 2; ite != end; ++ite)
-    {
-        ite = findArgSep(start, end);
-        auto len = ite - start;
-        if (len == 1 && start->isSymbol())
-        {
-            std::string symbol = start->getSymbol();
-            auto vIte = context.varTable.find(symbol);
-            if (vIte != context.varTable.end())
-                args.push_back(Token(vIte->second));
-            else
-            {
-                auto fIte = context.funcTable.find(symbol);
-                EVAL_THROW(fIte == context.funcTable.end(),
-                           EVAL_UNDEFINED_SYMBOL);
-                args.push_back(Token(symbol));
-            }
-        }
-        else
-            args.push_back(Token(context.evalExpr(start, ite)));
-        start = ite + 1;
-    }
-
-    if (type == FuncType::ORDINARY) return definition(args, context);
-    TokenList cpy(tkList);
-    setArguments(args, cpy);
-    return context.evalExpr(cpy.begin(), cpy.end());
-}
+#include <evaluator/Function.h>
+
+#include <evaluator/Context.h>
+namespace eval
+{
+namespace
+{
+// Arguments of a call that evaluates a RationalForm without allocating.
+constexpr size_t inlineArgs = 8;
+}  // namespace
+
+void ParameterTable::assign(size_t count,
+                            const std::vector<size_t>& parameterOf)
+{
+    offsets.assign(count + 1, 0);
+    for (auto p : parameterOf)
+        if (p < count) ++offsets[p + 1];
+    for (size_t i = 0; i < count; ++i) offsets[i + 1] += offsets[i];
+    positions.resize(offsets[count]);
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t k = 0; k < parameterOf.size(); ++k)
+        if (parameterOf[k] < count)
+            positions[next[parameterOf[k]]++] = static_cast<uint32_t>(k);
+}
+
+Function::Function(FuncType t, decltype(definition) def,
+                   decltype(batchDefinition) batch)
+    : type(t), definition(def), batchDefinition(batch)
+{
+}
+
+Function::Function(const TokenList::const_iterator& beg,
+                   const TokenList::const_iterator& end)
+    : type(FuncType::CUSTOM), tkList(beg, end)
+{
+}
+
+void Function::setArguments(const TokenList& args, TokenList& tkl) const
+{
+    EVAL_THROW(type == FuncType::CUSTOM && args.size() != parameterTable.size(),
+               EVAL_WRONG_NUMBER_OF_ARGS);
+    for (size_t i = 0; i < args.size(); ++i)
+        for (auto& idx : parameterTable[i]) tkl[idx].replace(args[i]);
+}
+
+operand_t Function::eval(Context& context,
+                         const TokenList::const_iterator& beg,
+                         const TokenList::const_iterator& end) const
+{
+    auto r = tryEval(context, beg, end);
+    EVAL_THROW(!r, r.error);
+    return r.value;
+}
+
+Expected<operand_t> Function::tryEval(Context& context,
+                                      const TokenList::const_iterator& beg,
+                                      const TokenList::const_iterator& end) const
+{
+    EVAL_EXCEPTION code;
+    if (context.overBudget(code)) return context.fail(code, beg);
+    ++context.stats.calls;
+
+    if (type == FuncType::HIGH_ORDER)
+        return context.call(*this, TokenList(beg + 2, end));
+
+    TokenList args;
+    args.reserve(parameterTable.size() + 1);
+
+    // Expensive arguments may run at once, see ParallelPolicy.
+    std::vector<Expected<operand_t>> joined;
+    if (context.parallel.enabled)
+    {
+        std::vector<Context::Range> ranges;
+        for (auto start = beg + 2, ite = start; ite != end; ++ite)
+        {
+            ite = findArgSep(start, end);
+            ranges.emplace_back(start, ite);
+            start = ite + 1;
+        }
+        joined.resize(ranges.size());
+        if (!context.tryEvalParallel(ranges.data(), ranges.size(),
+                                     joined.data()))
+            joined.clear();
+    }
+
+    auto start = beg + 2;
+    for (auto ite = beg + 2; ite != end; ++ite)
+    {
+        ite = findArgSep(start, end);
+        auto len = ite - start;
+        if (len == 1 && start->isSymbol())
+        {
+            std::string symbol = start->getSymbol();
+            const operand_t* v = context.findVar(symbol);
+            if (v)
+                args.push_back(Token(*v));
+            else if (context.findFunc(symbol))
+                args.push_back(Token(symbol));
+            else
+            {
+                const Array* a = context.findArray(symbol);
+                if (!a || a->size() != 1)
+                    return context.fail(
+                        a ? EVAL_NOT_SCALAR : EVAL_UNDEFINED_SYMBOL, start);
+                args.push_back(Token((*a)[0]));
+            }
+        }
+        else
+        {
+            auto r = joined.empty() ? context.tryEvalExpr(start, ite)
+                                    : joined[args.size()];
+            if (!r) return r;
+            args.push_back(Token(r.value));
+        }
+        start = ite + 1;
+    }
+
+    if (type == FuncType::ORDINARY) return context.call(*this, args);
+    if (args.size() != parameterTable.size())
+        return context.fail(EVAL_WRONG_NUMBER_OF_ARGS, beg);
+    if (form && args.size() <= inlineArgs)
+    {
+        // Functions passed by name go to the body, which reports them.
+        operand_t x[inlineArgs];
+        size_t i = 0;
+        for (; i < args.size() && args[i].isOperand(); ++i)
+            x[i] = args[i].getOperand();
+        if (i == args.size())
+        {
+            context.stats.operations += form->operations;
+            auto r = form->eval(x);
+            return r ? r : context.fail(r.error, beg);
+        }
+    }
+    operand_t value;
+    if (context.tieredCall(beg->getSymbol(), *this, args, value)) return value;
+    size_t held = (tkList.size() + args.capacity()) * sizeof(Token);
+    context.allocate(held);
+    TokenList cpy(tkList);
+    setArguments(args, cpy);
+    auto r = context.tryEvalBody(cpy.begin(), cpy.end());
+    context.release(held);
+    return r;
+}
 }  // namespace eval
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include <evaluator/MathKernels.h>
+
+#include <atomic>
+
+#include "simd/KernelImpl.h"
+
+#ifdef EVAL_SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace eval
+{
+namespace simd
+{
+namespace
+{
+// Single lane fallback for targets without a vector unit we know about.
+struct PackScalar
+{
+    using reg = double;
+    using mask = bool;
+    static constexpr size_t width = 1;
+    static constexpr bool hasFMA = false;
+
+    static reg load(const double* p) { return *p; }
+    static void store(double* p, reg a) { *p = a; }
+    static reg set(double a) { return a; }
+
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    static reg fma(reg a, reg b, reg c) { return a * b + c; }
+    static reg abs(reg a) { return std::fabs(a); }
+    static reg sign(reg a) { return std::signbit(a) ? -0.0 : 0.0; }
+    static reg xorv(reg a, reg b) { return std::signbit(b) ? -a : a; }
+
+    static mask lt(reg a, reg b) { return a < b; }
+    static mask le(reg a, reg b) { return a <= b; }
+    static mask gt(reg a, reg b) { return a > b; }
+    static mask ge(reg a, reg b) { return a >= b; }
+    static mask eq(reg a, reg b) { return a == b; }
+    static mask mand(mask a, mask b) { return a && b; }
+    static mask mor(mask a, mask b) { return a || b; }
+    static mask mnot(mask a) { return !a; }
+    static reg select(mask m, reg a, reg b) { return m ? a : b; }
+    static int bits(mask m) { return m; }
+
+    static reg round(reg a) { return std::nearbyint(a); }
+    static reg pow2i(reg k) { return std::ldexp(1.0, static_cast<int>(k)); }
+    static reg exponent(reg x) { return std::ilogb(x); }
+    static reg significand(reg x) { return std::ldexp(x, -std::ilogb(x)); }
+};
+
+#ifdef EVAL_SIMD_X86
+void cpuid(unsigned int leaf, unsigned int sub, unsigned int r[4])
+{
+#ifdef _MSC_VER
+    int t[4];
+    __cpuidex(t, static_cast<int>(leaf), static_cast<int>(sub));
+    for (int i = 0; i < 4; ++i) r[i] = static_cast<unsigned int>(t[i]);
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+#endif
+
+const KernelTable& tableFor(ISA isa)
+{
+#ifdef EVAL_SIMD_X86
+    switch (isa)
+    {
+    case ISA::AVX512:
+        return avx512Kernels();
+    case ISA::AVX2:
+        return avx2Kernels();
+    case ISA::SSE2:
+        return sse2Kernels();
+    default:
+        break;
+    }
+#else
+    (void)isa;
+#endif
+    return scalarKernels();
+}
+
+std::atomic<const KernelTable*> active{nullptr};
+std::atomic<ISA> activeIsa{ISA::SCALAR};
+
+const KernelTable& kernels()
+{
+    const KernelTable* t = active.load(std::memory_order_acquire);
+    if (t) return *t;
+    setISA(detectISA());
+    return *active.load(std::memory_order_acquire);
+}
+}  // namespace
+
+const KernelTable& scalarKernels()
+{
+    static const KernelTable table = Kernels<PackScalar>::table();
+    return table;
+}
+
+ISA detectISA()
+{
+#ifdef EVAL_SIMD_X86
+    unsigned int r[4];
+    cpuid(0, 0, r);
+    unsigned int maxLeaf = r[0];
+    cpuid(1, 0, r);
+    ISA isa = (r[3] >> 26) & 1 ? ISA::SSE2 : ISA::SCALAR;
+    bool osxsave = (r[2] >> 27) & 1, avx = (r[2] >> 28) & 1,
+         fma = (r[2] >> 12) & 1;
+    if (!osxsave || !avx || !fma || maxLeaf < 7) return isa;
+
+    unsigned long long xcr0 = xgetbv0();
+    if ((xcr0 & 0x6) != 0x6) return isa;  // XMM and YMM state
+    cpuid(7, 0, r);
+    if ((r[1] >> 5) & 1) isa = ISA::AVX2;
+    if ((r[1] >> 16) & 1 && (xcr0 & 0xe6) == 0xe6)  // opmask and ZMM state
+        isa = ISA::AVX512;
+    return isa;
+#else
+    return ISA::SCALAR;
+#endif
+}
+
+ISA activeISA()
+{
+    kernels();
+    return activeIsa.load(std::memory_order_acquire);
+}
+
+void setISA(ISA isa)
+{
+    ISA best = detectISA();
+    if (static_cast<int>(isa) > static_cast<int>(best)) isa = best;
+    activeIsa.store(isa, std::memory_order_release);
+    active.store(&tableFor(isa), std::memory_order_release);
+}
+
+const char* isaName(ISA isa)
+{
+    switch (isa)
+    {
+    case ISA::SSE2:
+        return "SSE2";
+    case ISA::AVX2:
+        return "AVX2";
+    case ISA::AVX512:
+        return "AVX-512";
+    default:
+        return "scalar";
+    }
+}
+
+void sin(const double* x, double* y, size_t n) { kernels().sin(x, y, n); }
+void cos(const double* x, double* y, size_t n) { kernels().cos(x, y, n); }
+void exp(const double* x, double* y, size_t n) { kernels().exp(x, y, n); }
+void ln(const double* x, double* y, size_t n) { kernels().ln(x, y, n); }
+void lg(const double* x, double* y, size_t n) { kernels().lg(x, y, n); }
+void atan(const double* x, double* y, size_t n) { kernels().atan(x, y, n); }
+void erf(const double* x, double* y, size_t n) { kernels().erf(x, y, n); }
+void gamma(const double* x, double* y, size_t n) { kernels().gamma(x, y, n); }
+void pow(const double* x, const double* y, double* z, size_t n)
+{
+    kernels().pow(x, y, z, n);
+}
+}  // namespace simd
+}  // namespace eval
\ No newline at end of file
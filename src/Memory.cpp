@@ -0,0 +1,145 @@
+#include <evaluator/Context.h>
+
+#include <evaluator/Expr.h>
+
+namespace eval
+{
+namespace
+{
+size_t heapBytes(const std::string& s)
+{
+    static const size_t inlineCapacity = std::string().capacity();
+    return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}
+
+size_t tokenBytes(const TokenList& tkl)
+{
+    size_t bytes = tkl.capacity() * sizeof(Token);
+    for (const auto& t : tkl)
+        if (t.isSymbol()) bytes += heapBytes(std::get<2>(t.value));
+    return bytes;
+}
+
+// A node of an unordered_map: the next pointer, the cached hash and the
+// element, plus its name.
+template <typename Value>
+size_t entryBytes(const std::string& name, const Value&)
+{
+    return 2 * sizeof(void*) + sizeof(std::pair<const std::string, Value>) +
+           heapBytes(name);
+}
+
+template <typename Map>
+size_t bucketBytes(const Map& m)
+{
+    return m.bucket_count() * sizeof(void*);
+}
+
+size_t bytesOf(const std::string& name, const operand_t& v)
+{
+    return entryBytes(name, v);
+}
+
+size_t bytesOf(const std::string& name, const Array& a)
+{
+    return entryBytes(name, a) + a.capacity() * sizeof(operand_t);
+}
+
+size_t bytesOf(const std::string& name, const Function& f)
+{
+    return entryBytes(name, f) + tokenBytes(f.tkList) +
+           f.parameterTable.bytes() + (f.form ? f.form->bytes() : 0);
+}
+
+size_t bytesOf(const std::string& name, const ArrayFunction& f)
+{
+    return entryBytes(name, f);
+}
+
+template <typename Map>
+size_t tableBytes(const Map& m)
+{
+    size_t bytes = bucketBytes(m);
+    for (const auto& e : m) bytes += bytesOf(e.first, e.second);
+    return bytes;
+}
+
+size_t tierBytes(const std::unordered_map<std::string, TierTable::Entry>& m)
+{
+    size_t bytes = bucketBytes(m);
+    for (const auto& e : m)
+    {
+        bytes += entryBytes(e.first, e.second) + heapBytes(e.second.text);
+        for (const auto& d : e.second.dependencies)
+            bytes += sizeof(d) + heapBytes(d.first);
+        if (e.second.code) bytes += sizeof(Expr) + e.second.code->bytes();
+    }
+    return bytes;
+}
+}  // namespace
+
+size_t Expr::bytes() const
+{
+    size_t bytes = nodes.capacity() * sizeof(Node) + heapBytes(lane) +
+                   roots.capacity() * sizeof(size_t) +
+                   buffer.capacity() * sizeof(operand_t);
+    for (const auto& node : nodes)
+        bytes += heapBytes(node.symbol) + node.args.capacity() * sizeof(size_t);
+    for (const auto& f : functions) bytes += sizeof(f) + heapBytes(f);
+    return bytes;
+}
+
+MemoryUsage Context::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.variables = tableBytes(varTable);
+    usage.arrays = tableBytes(arrayTable);
+    usage.functions = tableBytes(funcTable);
+    usage.arrayFunctions = tableBytes(arrayFuncTable);
+    usage.cache = cache.stats().bytes;
+    usage.tiers = tierBytes(tiers.functions) + tierBytes(tiers.loops);
+    usage.versions = bucketBytes(versions);
+    for (const auto& v : versions)
+        usage.versions += entryBytes(v.first, v.second);
+    usage.evaluation = memory;
+
+    definitionCount = varTable.size() + arrayTable.size() + funcTable.size() -
+                      (varTable.count("ANS") + arrayTable.count("ANS"));
+    definitionBytes = usage.definitions();
+    return usage;
+}
+
+Expected<bool> Context::reserve(const std::string& name, const Function* f,
+                                const Array* a)
+{
+    size_t bytes, old = 0;
+    bool existed;
+    if (f)
+    {
+        bytes = bytesOf(name, *f);
+        auto ite = funcTable.find(name);
+        existed = ite != funcTable.end();
+        if (existed) old = bytesOf(name, ite->second);
+    }
+    else
+    {
+        bytes = a ? bytesOf(name, *a) : bytesOf(name, operand_zero);
+        auto v = varTable.find(name);
+        auto ite = arrayTable.find(name);
+        existed = v != varTable.end() || ite != arrayTable.end();
+        if (v != varTable.end()) old += bytesOf(name, v->second);
+        if (ite != arrayTable.end()) old += bytesOf(name, ite->second);
+    }
+    bool added = !existed && name != "ANS";
+    size_t count = definitionCount + added;
+    size_t total = (old < definitionBytes ? definitionBytes - old : 0) + bytes;
+    if (added && quota.maxDefinitions && count > quota.maxDefinitions)
+        return Expected<bool>::failure(EVAL_TOO_MANY_DEFINITIONS);
+    if (bytes > old && quota.maxDefinitionBytes &&
+        total > quota.maxDefinitionBytes)
+        return Expected<bool>::failure(EVAL_DEFINITIONS_TOO_LARGE);
+    definitionCount = count;
+    definitionBytes = total;
+    return true;
+}
+}  // namespace eval
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include <evaluator/Context.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace eval
+{
+namespace
+{
+// A range evaluated as a task. Whoever claims it first runs it: a thread of
+// the pool, or the thread that spawned it once it gets to the join.
+struct Job
+{
+    std::function<void()> run;
+    std::atomic<bool> claimed{false};
+    std::atomic<bool> done{false};
+};
+
+class Pool
+{
+   protected:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Job>> jobs;
+    };
+    const size_t count;  // of workers
+    // One per worker, then one for the threads outside the pool.
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    // Unclaimed jobs, and the workers waiting for some.
+    std::atomic<size_t> pending{0}, idle{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    bool stopping = false;
+
+    static thread_local size_t self;
+
+    bool claim(Job& job)
+    {
+        if (job.claimed.exchange(true)) return false;
+        pending.fetch_sub(1);
+        return true;
+    }
+
+    static void run(Job& job)
+    {
+        job.run();
+        job.done.store(true, std::memory_order_release);
+    }
+
+    // Own queue newest first, the others oldest first, as the oldest jobs of
+    // a fork-join tree are the largest. Jobs claimed back by the thread that
+    // spawned them are dropped on the way.
+    bool runOne()
+    {
+        size_t own = std::min(self, count);
+        for (size_t k = 0; k < queues.size(); ++k)
+        {
+            auto& q = *queues[(own + k) % queues.size()];
+            while (true)
+            {
+                std::shared_ptr<Job> job;
+                {
+                    std::lock_guard<std::mutex> lock(q.mutex);
+                    if (q.jobs.empty()) break;
+                    if (k)
+                    {
+                        job = std::move(q.jobs.front());
+                        q.jobs.pop_front();
+                    }
+                    else
+                    {
+                        job = std::move(q.jobs.back());
+                        q.jobs.pop_back();
+                    }
+                }
+                if (!claim(*job)) continue;
+                run(*job);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(size_t index)
+    {
+        self = index;
+        while (true)
+        {
+            if (runOne()) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            idle.fetch_add(1);
+            sleepCv.wait(lock, [this] { return stopping || pending.load(); });
+            idle.fetch_sub(1);
+            if (stopping) return;
+        }
+    }
+
+   public:
+    // The thread that evaluates is one of threads.
+    explicit Pool(unsigned int threads)
+        : count(threads ? threads - 1
+                        : std::max(std::thread::hardware_concurrency(), 1u) -
+                              1)
+    {
+        for (size_t i = 0; i <= count; ++i)
+            queues.push_back(std::make_unique<Queue>());
+        for (size_t i = 0; i < count; ++i)
+            workers.emplace_back(&Pool::work, this, i);
+    }
+
+    ~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCv.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    // Whether a spawned job would be picked up at once.
+    bool hungry() const { return idle.load() > pending.load(); }
+
+    void spawn(const std::shared_ptr<Job>& job)
+    {
+        auto& q = *queues[std::min(self, count)];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.jobs.push_back(job);
+        }
+        // Pairs with the check of work: either the sleeper sees the job or
+        // this sees the sleeper.
+        pending.fetch_add(1);
+        if (idle.load())
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCv.notify_one();
+        }
+    }
+
+    // Runs the job here if no thread took it yet, otherwise runs other jobs
+    // until it is done.
+    void join(Job& job)
+    {
+        if (claim(job))
+        {
+            run(job);
+            return;
+        }
+        while (!job.done.load(std::memory_order_acquire))
+            if (!runOne()) std::this_thread::yield();
+    }
+};
+
+thread_local size_t Pool::self = static_cast<size_t>(-1);
+
+// Started by the first parallel evaluation of the process.
+Pool& pool(unsigned int threads)
+{
+    static Pool instance(threads);
+    return instance;
+}
+}  // namespace
+
+const Context* Context::definingLayer() const
+{
+    auto c = this;
+    while (c->parent && c->varTable.empty() && c->funcTable.empty() &&
+           c->arrayTable.empty() && c->arrayFuncTable.empty() &&
+           c->versions.empty() && !c->builtins)
+        c = c->parent;
+    return c;
+}
+
+bool Context::worthTask(const TokenList::const_iterator& beg,
+                        const TokenList::const_iterator& end) const
+{
+    bool expensive = false;
+    std::vector<const Function*> seen, pending;
+    auto visit = [&](const Token& t)
+    {
+        if (!t.isSymbol()) return true;
+        const Function* f = findFunc(t.getSymbol());
+        if (!f || std::find(seen.begin(), seen.end(), f) != seen.end())
+            return true;
+        seen.push_back(f);
+        if (!f->pure) return false;
+        if (f->type == FuncType::ORDINARY) return true;
+        expensive = true;
+        if (f->type == FuncType::CUSTOM) pending.push_back(f);
+        return true;
+    };
+    for (auto ite = beg; ite != end; ++ite)
+        if (!visit(*ite)) return false;
+    if (!expensive) return false;
+    while (!pending.empty())
+    {
+        const Function* f = pending.back();
+        pending.pop_back();
+        for (const auto& t : f->tkList)
+            if (!visit(t)) return false;
+    }
+    return true;
+}
+
+bool Context::tryEvalParallel(const Range* ranges, size_t n,
+                              Expected<operand_t>* out)
+{
+    if (!parallel.enabled || n < 2 || depth >= spawnDepth) return false;
+    auto& tasks = pool(parallel.threads);
+    if (!tasks.hungry()) return false;
+    std::vector<char> worth(n);
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+        count += worth[i] = worthTask(ranges[i].first, ranges[i].second);
+    if (count < 2) return false;
+
+    // Every range runs in a fork, so that this context stays as it is for
+    // the tasks reading through it.
+    struct Piece
+    {
+        uint64_t operations, calls, tasks;
+        size_t peakMemory;
+    };
+    std::vector<Piece> pieces(n);
+    const Context* layer = definingLayer();
+    auto evaluate = [&, layer](size_t i)
+    {
+        Context child(layer);
+        child.strictMath = strictMath;
+        child.budget = budget;
+        child.cancellation = cancellation;
+        child.tiering = tiering;
+        child.parallel = parallel;
+        child.spawnDepth = spawnDepth;
+        child.depth = depth;
+        child.input = input;
+        child.foreign = foreign;
+        child.started = started;
+        child.deadline = deadline;
+        child.memory = memory;
+        child.stats.operations = stats.operations;
+        out[i] = child.tryEvalExpr(ranges[i].first, ranges[i].second);
+        pieces[i] = {child.stats.operations - stats.operations,
+                     child.stats.calls, child.stats.tasks,
+                     child.stats.peakMemory};
+    };
+
+    std::vector<std::shared_ptr<Job>> jobs(n);
+    size_t first = n;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!worth[i]) continue;
+        if (first == n)
+        {
+            first = i;
+            continue;
+        }
+        jobs[i] = std::make_shared<Job>();
+        jobs[i]->run = [&evaluate, i] { evaluate(i); };
+        tasks.spawn(jobs[i]);
+    }
+    for (size_t i = 0; i < n; ++i)
+        if (!jobs[i]) evaluate(i);
+    for (size_t i = 0; i < n; ++i)
+        if (jobs[i]) tasks.join(*jobs[i]);
+
+    uint64_t smallest = static_cast<uint64_t>(-1);
+    for (size_t i = 0; i < n; ++i)
+    {
+        stats.operations += pieces[i].operations;
+        stats.calls += pieces[i].calls;
+        stats.tasks += pieces[i].tasks + (jobs[i] ? 1 : 0);
+        stats.peakMemory = std::max(stats.peakMemory, pieces[i].peakMemory);
+        if (worth[i]) smallest = std::min(smallest, pieces[i].operations);
+    }
+    // Tasks too small to pay for themselves keep the ones at this depth
+    // and below sequential, much larger ones let them go deeper.
+    if (smallest < parallel.grain)
+        spawnDepth = depth;
+    else if (smallest >= 16 * parallel.grain && spawnDepth < maxRecursionDepth)
+        ++spawnDepth;
+    return true;
+}
+}  // namespace eval
\ No newline at end of file
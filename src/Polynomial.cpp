@@ -0,0 +1,327 @@
+#include <evaluator/Polynomial.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include <evaluator/Context.h>
+#include <evaluator/Expr.h>
+
+namespace eval
+{
+namespace
+{
+// Only recognize uses these, as integer operands keep no rational form.
+#ifdef EVAL_DECIMAL_OPERAND
+constexpr unsigned int maxDegree = 64;
+constexpr size_t maxTerms = 1024;
+
+using Exponents = std::vector<unsigned int>;
+using Terms = std::map<Exponents, operand_t, std::greater<Exponents>>;
+
+Polynomial make(size_t variables, const Terms& terms)
+{
+    Polynomial p;
+    p.variables = variables;
+    for (const auto& t : terms)
+        if (t.second != operand_zero) p.terms.push_back({t.second, t.first});
+    return p;
+}
+
+Polynomial constant(size_t variables, const operand_t& c)
+{
+    return make(variables, {{Exponents(variables, 0), c}});
+}
+
+Polynomial add(const Polynomial& a, const Polynomial& b, bool subtract)
+{
+    Terms sum;
+    for (const auto& t : a.terms) sum[t.exponents] = t.coefficient;
+    for (const auto& t : b.terms)
+    {
+        auto ite = sum.find(t.exponents);
+        if (ite == sum.end())
+            sum.emplace(t.exponents, subtract ? -t.coefficient : t.coefficient);
+        else if (subtract)
+            ite->second = ite->second - t.coefficient;
+        else
+            ite->second = ite->second + t.coefficient;
+    }
+    return make(a.variables, sum);
+}
+
+// Fails, leaving r as it was, past maxDegree or maxTerms.
+bool multiply(const Polynomial& a, const Polynomial& b, Polynomial& r)
+{
+    Terms product;
+    Exponents e(a.variables);
+    for (const auto& s : a.terms)
+        for (const auto& t : b.terms)
+        {
+            for (size_t v = 0; v < e.size(); ++v)
+            {
+                e[v] = s.exponents[v] + t.exponents[v];
+                if (e[v] > maxDegree) return false;
+            }
+            auto ite = product.find(e);
+            if (ite == product.end())
+                product.emplace(e, s.coefficient * t.coefficient);
+            else
+                ite->second = ite->second + s.coefficient * t.coefficient;
+            if (product.size() > maxTerms) return false;
+        }
+    r = make(a.variables, product);
+    return true;
+}
+
+bool equal(const Polynomial& a, const Polynomial& b)
+{
+    if (a.terms.size() != b.terms.size()) return false;
+    for (size_t i = 0; i < a.terms.size(); ++i)
+        if (a.terms[i].exponents != b.terms[i].exponents ||
+            !(a.terms[i].coefficient == b.terms[i].coefficient))
+            return false;
+    return true;
+}
+
+// A node of the body as numerator / denominator, an empty denominator
+// standing for 1.
+struct Quotient
+{
+    bool valid = false;
+    Polynomial numerator, denominator;
+};
+
+// Divides the numerator by a constant denominator, so that a polynomial
+// keeps an empty one.
+void normalize(Quotient& q)
+{
+    if (q.denominator.terms.empty() || !q.denominator.constant()) return;
+    operand_t c = q.denominator.terms[0].coefficient;
+    for (auto& t : q.numerator.terms) t.coefficient = t.coefficient / c;
+    q.denominator.terms.clear();
+}
+
+bool multiply(const Quotient& a, const Quotient& b, Quotient& r)
+{
+    if (!multiply(a.numerator, b.numerator, r.numerator)) return false;
+    if (a.denominator.terms.empty() || b.denominator.terms.empty())
+        r.denominator = a.denominator.terms.empty() ? b.denominator
+                                                    : a.denominator;
+    else if (!multiply(a.denominator, b.denominator, r.denominator))
+        return false;
+    r.valid = true;
+    return true;
+}
+
+bool add(const Quotient& a, const Quotient& b, bool subtract, Quotient& r)
+{
+    if (equal(a.denominator, b.denominator))
+    {
+        r.numerator = add(a.numerator, b.numerator, subtract);
+        r.denominator = a.denominator;
+        r.valid = true;
+        return true;
+    }
+    // a / p + b / q = (a q + b p) / (p q)
+    Polynomial one = constant(a.numerator.variables, operand_one);
+    const Polynomial& p = a.denominator.terms.empty() ? one : a.denominator;
+    const Polynomial& q = b.denominator.terms.empty() ? one : b.denominator;
+    Polynomial aq, bp;
+    if (!multiply(a.numerator, q, aq) || !multiply(b.numerator, p, bp) ||
+        !multiply(p, q, r.denominator))
+        return false;
+    r.numerator = add(aq, bp, subtract);
+    r.valid = true;
+    return true;
+}
+#endif
+
+struct ValueOps
+{
+    using Value = operand_t;
+    Value constant(const operand_t& c) { return c; }
+    Value add(const Value& a, const Value& b) { return a + b; }
+    // As the interpreter, which skips the right operand of 0 * b.
+    Value mul(const Value& a, const Value& b)
+    {
+        return a == operand_zero ? operand_zero : a * b;
+    }
+};
+
+struct CountOps
+{
+    using Value = int;
+    size_t operations = 0;
+    Value constant(const operand_t&) { return 0; }
+    Value add(Value, Value) { return ++operations, 0; }
+    Value mul(Value, Value) { return ++operations, 0; }
+    Value div(Value, Value) { return ++operations, 0; }
+};
+}  // namespace
+
+unsigned int Polynomial::degree(size_t v) const
+{
+    unsigned int d = 0;
+    for (const auto& t : terms) d = std::max(d, t.exponents[v]);
+    return d;
+}
+
+bool Polynomial::constant() const
+{
+    for (const auto& t : terms)
+        for (auto e : t.exponents)
+            if (e) return false;
+    return true;
+}
+
+size_t Polynomial::single() const
+{
+    size_t found = variables;
+    for (const auto& t : terms)
+        for (size_t v = 0; v < variables; ++v)
+        {
+            if (!t.exponents[v] || v == found) continue;
+            if (found != variables) return variables;
+            found = v;
+        }
+    return found;
+}
+
+std::vector<operand_t> Polynomial::coefficients(size_t v) const
+{
+    std::vector<operand_t> c(degree(v) + 1, operand_zero);
+    for (const auto& t : terms) c[t.exponents[v]] = t.coefficient;
+    return c;
+}
+
+size_t RationalForm::bytes() const
+{
+    size_t terms = numerator.terms.capacity() + denominator.terms.capacity();
+    return sizeof(RationalForm) +
+           terms * (sizeof(Monomial) +
+                    numerator.variables * sizeof(unsigned int));
+}
+
+Expected<operand_t> RationalForm::eval(const operand_t* x) const
+{
+    ValueOps ops;
+    operand_t n = numerator.evaluate(ops, x);
+    if (polynomial()) return n;
+    operand_t d = denominator.evaluate(ops, x);
+    if (d == operand_zero)
+        return Expected<operand_t>::failure(EVAL_DIV_BY_ZERO);
+    return n / d;
+}
+
+std::shared_ptr<const RationalForm> RationalForm::recognize(
+    const Context& context, const Function& f)
+{
+#ifndef EVAL_DECIMAL_OPERAND
+    // Integer division truncates, coefficients would not.
+    (void)context;
+    (void)f;
+    return nullptr;
+#else
+    Expr expr;
+    if (!expr.compile(context, f) || !expr.functions.empty()) return nullptr;
+    size_t variables = f.parameterTable.size();
+    std::vector<Quotient> values(expr.nodes.size());
+    for (size_t k = 0; k < expr.nodes.size(); ++k)
+    {
+        const Node& node = expr.nodes[k];
+        Quotient& q = values[k];
+        auto arg = [&](size_t i) -> const Quotient&
+        { return values[node.args[i]]; };
+        switch (node.type)
+        {
+        case NodeType::CONST:
+            q.numerator = constant(variables, node.value);
+            q.valid = true;
+            break;
+        case NodeType::PARAM:
+        {
+            Exponents e(variables, 0);
+            e[static_cast<size_t>(node.value)] = 1;
+            q.numerator = make(variables, {{e, operand_one}});
+            q.valid = true;
+            break;
+        }
+        case NodeType::NEG:
+            q = arg(0);
+            for (auto& t : q.numerator.terms)
+                t.coefficient = -t.coefficient;
+            break;
+        case NodeType::ADD:
+        case NodeType::SUB:
+            if (arg(0).valid && arg(1).valid)
+                add(arg(0), arg(1), node.type == NodeType::SUB, q);
+            break;
+        case NodeType::MUL:
+            if (arg(0).valid && arg(1).valid) multiply(arg(0), arg(1), q);
+            break;
+#ifndef EVAL_MIXED_OPERAND
+        // Quotients of integers are exact, products by a reciprocal
+        // would not be.
+        case NodeType::DIV:
+        {
+            const Quotient& d = arg(1);
+            if (!arg(0).valid || !d.valid || d.numerator.terms.empty())
+                break;
+            Quotient inverse;
+            inverse.numerator =
+                d.denominator.terms.empty()
+                    ? constant(variables, operand_one)
+                    : d.denominator;
+            inverse.denominator = d.numerator;
+            inverse.valid = true;
+            normalize(inverse);
+            multiply(arg(0), inverse, q);
+            break;
+        }
+#endif
+        case NodeType::POW:
+        {
+            // Integer exponents from 0 to maxDegree only: pow(0, -1)
+            // is infinite where a quotient would fail.
+            const Quotient& e = arg(1);
+            if (!arg(0).valid || !e.valid || !e.denominator.terms.empty() ||
+                !e.numerator.constant())
+                break;
+            operand_t k = e.numerator.terms.empty()
+                              ? operand_zero
+                              : e.numerator.terms[0].coefficient;
+            if (k < 0 || k > maxDegree ||
+                k != std::floor(static_cast<decimal_t>(k)))
+                break;
+            Quotient r;
+            r.numerator = constant(variables, operand_one);
+            r.valid = true;
+            for (unsigned int i = static_cast<unsigned int>(k); i; --i)
+                if (!multiply(r, arg(0), r))
+                {
+                    r.valid = false;
+                    break;
+                }
+            if (r.valid) q = std::move(r);
+            break;
+        }
+        default:
+            break;
+        }
+        if (q.valid) normalize(q);
+    }
+    Quotient& body = values[expr.root(0)];
+    if (!body.valid) return nullptr;
+    auto form = std::make_shared<RationalForm>();
+    form->numerator = std::move(body.numerator);
+    form->denominator = std::move(body.denominator);
+    form->numerator.variables = form->denominator.variables = variables;
+    CountOps count;
+    std::vector<int> x(variables);
+    form->evaluate(count, x.data());
+    form->operations = count.operations;
+    return form;
+#endif
+}
+}  // namespace eval
\ No newline at end of file
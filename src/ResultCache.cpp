@@ -0,0 +1,70 @@
+#include <evaluator/ResultCache.h>
+
+namespace eval
+{
+void ResultCache::setCapacity(size_t n)
+{
+    capacity = n;
+    while (entries.size() > capacity)
+    {
+        counters.bytes -= entries.back().bytes;
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+    counters.entries = entries.size();
+}
+
+bool ResultCache::find(
+    const std::string& key,
+    const std::function<uint64_t(const std::string&)>& version,
+    operand_t& value)
+{
+    auto ite = index.find(key);
+    if (ite == index.end())
+    {
+        ++counters.misses;
+        return false;
+    }
+    for (const auto& d : ite->second->deps)
+        if (version(d.first) != d.second)
+        {
+            counters.bytes -= ite->second->bytes;
+            entries.erase(ite->second);
+            index.erase(ite);
+            counters.entries = entries.size();
+            ++counters.misses;
+            return false;
+        }
+    entries.splice(entries.begin(), entries, ite->second);
+    ++counters.hits;
+    value = ite->second->value;
+    return true;
+}
+
+void ResultCache::insert(const std::string& key, operand_t value,
+                         Dependencies deps)
+{
+    if (!capacity) return;
+    auto ite = index.find(key);
+    if (ite != index.end())
+    {
+        counters.bytes -= ite->second->bytes;
+        entries.erase(ite->second);
+        index.erase(ite);
+    }
+    size_t bytes = sizeof(Entry) + 2 * key.size() + 64;  // key, index node
+    for (const auto& d : deps) bytes += sizeof(d) + d.first.size();
+    entries.push_front(Entry{key, value, std::move(deps), bytes});
+    index.emplace(key, entries.begin());
+    counters.bytes += bytes;
+    setCapacity(capacity);
+}
+
+void ResultCache::clear()
+{
+    entries.clear();
+    index.clear();
+    counters.entries = 0;
+    counters.bytes = 0;
+}
+}  // namespace eval
\ No newline at end of file
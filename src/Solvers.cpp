@@ -0,0 +1,517 @@
+#include <evaluator/Context.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <evaluator/Expr.h>
+
+namespace eval
+{
+#ifdef EVAL_DECIMAL_OPERAND
+namespace
+{
+const operand_t epsilon = std::numeric_limits<operand_t>::epsilon();
+constexpr size_t maxIterations = 200;
+constexpr size_t maxIntervals = 1000;
+constexpr size_t maxTerms = size_t(1) << 24;
+
+// Arguments of a solver call: the body, the variable it is a function of,
+// then between required and required + optional operands. tkl runs up to
+// the closing parenthesis of the call, as for every high order function.
+struct Call
+{
+    TokenList::const_iterator bodyBeg, bodyEnd;
+    std::string var;
+    std::vector<operand_t> values;
+};
+
+bool parseCall(const TokenList& tkl, Context& context, size_t required,
+               size_t optional, Call& call)
+{
+    auto ite = findArgSep(tkl.begin(), tkl.end());
+    if (ite == tkl.end() || !ite->isComma() || ite + 1 == tkl.end())
+    {
+        context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+        return false;
+    }
+    call.bodyBeg = tkl.begin();
+    call.bodyEnd = ite++;
+    if (!ite->isSymbol())
+    {
+        context.raise(EVAL_UNEXPECTED_TOKEN_TYPE);
+        return false;
+    }
+    call.var = ite->getSymbol();
+    ++ite;
+    while (ite != tkl.end() && ite->isComma())
+    {
+        auto beg = ++ite;
+        ite = findArgSep(beg, tkl.end());
+        if (beg == ite) break;
+        auto r = context.tryEvalExpr(beg, ite);
+        if (!r)
+        {
+            context.raise(r);
+            return false;
+        }
+        call.values.push_back(r.value);
+    }
+    if (ite == tkl.end() || !ite->isRParen() || ite + 1 != tkl.end() ||
+        call.values.size() < required ||
+        call.values.size() > required + optional)
+    {
+        context.raise(EVAL_WRONG_NUMBER_OF_ARGS);
+        return false;
+    }
+    return true;
+}
+
+operand_t withSign(operand_t a, operand_t b)
+{
+    return b >= operand_zero ? std::abs(a) : -std::abs(a);
+}
+
+// ROOT(body, x, a, b[, tol]): a zero of the body in [a, b], where it must
+// change sign, by Brent's method.
+operand_t root(const TokenList& tkl, Context& context)
+{
+    Call call;
+    if (!parseCall(tkl, context, 2, 1, call)) return operand_zero;
+    operand_t a = call.values[0], b = call.values[1];
+    operand_t tol =
+        call.values.size() > 2 ? call.values[2] : operand_t(1e-12L);
+
+    LaneBody f(context, call.bodyBeg, call.bodyEnd, call.var);
+    operand_t fa, fb;
+    if (!f.eval(a, fa) || !f.eval(b, fb)) return operand_zero;
+    if (fa == operand_zero) return a;
+    if (fb == operand_zero) return b;
+    if ((fa > operand_zero) == (fb > operand_zero))
+        return context.raise(EVAL_NOT_BRACKETED);
+
+    operand_t c = a, fc = fa, d = b - a, e = d;
+    for (size_t i = 0; i < maxIterations; ++i)
+    {
+        if ((fb > operand_zero) == (fc > operand_zero))
+        {
+            c = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if (std::abs(fc) < std::abs(fb))
+        {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+        operand_t tol1 = 2 * epsilon * std::abs(b) + tol / 2;
+        operand_t xm = (c - b) / 2;
+        if (std::abs(xm) <= tol1 || fb == operand_zero) return b;
+        if (std::abs(e) >= tol1 && std::abs(fa) > std::abs(fb))
+        {
+            // Inverse quadratic interpolation, or secant when a == c.
+            operand_t s = fb / fa, p, q;
+            if (a == c)
+            {
+                p = 2 * xm * s;
+                q = 1 - s;
+            }
+            else
+            {
+                operand_t qa = fa / fc, r = fb / fc;
+                p = s * (2 * xm * qa * (qa - r) - (b - a) * (r - 1));
+                q = (qa - 1) * (r - 1) * (s - 1);
+            }
+            if (p > operand_zero) q = -q;
+            p = std::abs(p);
+            if (2 * p < std::min<operand_t>(3 * xm * q - std::abs(tol1 * q),
+                                            std::abs(e * q)))
+            {
+                e = d;
+                d = p / q;
+            }
+            else
+                d = e = xm;
+        }
+        else
+            d = e = xm;
+        a = b;
+        fa = fb;
+        b += std::abs(d) > tol1 ? d : withSign(tol1, xm);
+        if (!f.eval(b, fb)) return operand_zero;
+    }
+    return context.raise(EVAL_NOT_CONVERGED);
+}
+
+// MINIMIZE(body, x, a, b[, tol]): where the body is smallest in [a, b], by
+// Brent's combination of golden section search and parabolic steps.
+operand_t minimize(const TokenList& tkl, Context& context)
+{
+    Call call;
+    if (!parseCall(tkl, context, 2, 1, call)) return operand_zero;
+    operand_t a = std::min(call.values[0], call.values[1]),
+              b = std::max(call.values[0], call.values[1]);
+    operand_t tol =
+        call.values.size() > 2 ? call.values[2] : operand_t(1e-10L);
+    const operand_t golden = 0.381966011250105151795413165634361882L;
+    const operand_t sqrtEps = std::sqrt(epsilon);
+
+    LaneBody f(context, call.bodyBeg, call.bodyEnd, call.var);
+    operand_t x = a + golden * (b - a), w = x, v = x, fx;
+    if (!f.eval(x, fx)) return operand_zero;
+    operand_t fw = fx, fv = fx, d = operand_zero, e = operand_zero;
+    for (size_t i = 0; i < maxIterations; ++i)
+    {
+        operand_t xm = (a + b) / 2;
+        operand_t tol1 = sqrtEps * std::abs(x) + tol / 3, tol2 = 2 * tol1;
+        if (std::abs(x - xm) <= tol2 - (b - a) / 2) return x;
+        bool goldenStep = true;
+        if (std::abs(e) > tol1)
+        {
+            // Parabola through x, w and v.
+            operand_t r = (x - w) * (fx - fv), q = (x - v) * (fx - fw);
+            operand_t p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > operand_zero)
+                p = -p;
+            else
+                q = -q;
+            operand_t last = e;
+            e = d;
+            if (std::abs(p) < std::abs(q * last / 2) && p > q * (a - x) &&
+                p < q * (b - x))
+            {
+                d = p / q;
+                operand_t u = x + d;
+                if (u - a < tol2 || b - u < tol2) d = withSign(tol1, xm - x);
+                goldenStep = false;
+            }
+        }
+        if (goldenStep)
+        {
+            e = x >= xm ? a - x : b - x;
+            d = golden * e;
+        }
+        operand_t u = std::abs(d) >= tol1 ? x + d : x + withSign(tol1, d), fu;
+        if (!f.eval(u, fu)) return operand_zero;
+        if (fu <= fx)
+        {
+            (u >= x ? a : b) = x;
+            v = w;
+            fv = fw;
+            w = x;
+            fw = fx;
+            x = u;
+            fx = fu;
+        }
+        else
+        {
+            (u < x ? a : b) = u;
+            if (fu <= fw || w == x)
+            {
+                v = w;
+                fv = fw;
+                w = u;
+                fw = fu;
+            }
+            else if (fu <= fv || v == x || v == w)
+            {
+                v = u;
+                fv = fu;
+            }
+        }
+    }
+    return context.raise(EVAL_NOT_CONVERGED);
+}
+
+// 15 point Gauss-Kronrod rule: abscissae in decreasing order, the odd ones
+// shared with the embedded 7 point Gauss rule, the last one the center.
+const long double kronrodX[8] = {
+    0.991455371120812639206854697526329L, 0.949107912342758524526189684047851L,
+    0.864864423359769072789712788640926L, 0.741531185599394439863864773280788L,
+    0.586087235467691130294144845693013L, 0.405845151377397166906606412076961L,
+    0.207784955007898467600689403773245L, 0.0L};
+const long double kronrodW[8] = {
+    0.022935322010529224963732008058970L, 0.063092092629978553290700663189204L,
+    0.104790010322250183839876322541518L, 0.140653259715525918745189590510238L,
+    0.169004726639267902826583426598550L, 0.190350578064785409913256402421014L,
+    0.204432940075298892414161999234649L, 0.209482141084727828012999174891714L};
+const long double gaussW[4] = {
+    0.129484966168869693270611432679082L, 0.279705391489276667901467771423780L,
+    0.381830050505118944950369775488975L, 0.417959183673469387755102040816327L};
+
+struct Interval
+{
+    operand_t a, b, value, error;
+
+    bool operator<(const Interval& other) const { return error < other.error; }
+};
+
+void kronrodPoints(operand_t a, operand_t b, operand_t* x)
+{
+    operand_t c = (a + b) / 2, h = (b - a) / 2;
+    for (size_t j = 0; j < 7; ++j)
+    {
+        x[2 * j] = c - h * kronrodX[j];
+        x[2 * j + 1] = c + h * kronrodX[j];
+    }
+    x[14] = c;
+}
+
+// The Kronrod estimate over [a, b] from the body at kronrodPoints, and its
+// error estimated against the Gauss rule as QUADPACK does.
+Interval kronrod(operand_t a, operand_t b, const operand_t* f)
+{
+    operand_t h = (b - a) / 2;
+    operand_t k = kronrodW[7] * f[14], g = gaussW[3] * f[14];
+    for (size_t j = 0; j < 7; ++j)
+    {
+        operand_t pair = f[2 * j] + f[2 * j + 1];
+        k += kronrodW[j] * pair;
+        if (j % 2) g += gaussW[j / 2] * pair;
+    }
+    operand_t mean = k / 2, asc = kronrodW[7] * std::abs(f[14] - mean);
+    for (size_t j = 0; j < 7; ++j)
+        asc += kronrodW[j] *
+               (std::abs(f[2 * j] - mean) + std::abs(f[2 * j + 1] - mean));
+    asc *= std::abs(h);
+    operand_t error = std::abs((k - g) * h);
+    if (asc != operand_zero && error != operand_zero)
+        error = asc * std::min<operand_t>(
+                          1, std::pow(200 * error / asc, operand_t(1.5L)));
+    return Interval{a, b, k * h, error};
+}
+
+// INTEGRATE(body, x, a, b[, tol]): the integral of the body from a to b by
+// adaptive 15 point Gauss-Kronrod quadrature, splitting the interval with
+// the largest error until the total error is within tol, absolute or
+// relative to the result.
+operand_t integrate(const TokenList& tkl, Context& context)
+{
+    Call call;
+    if (!parseCall(tkl, context, 2, 1, call)) return operand_zero;
+    operand_t a = call.values[0], b = call.values[1];
+    operand_t tol =
+        call.values.size() > 2 ? call.values[2] : operand_t(1e-10L);
+
+    LaneBody body(context, call.bodyBeg, call.bodyEnd, call.var);
+    operand_t x[30], f[30];
+    kronrodPoints(a, b, x);
+    if (!body.eval(x, f, 15)) return operand_zero;
+    std::vector<Interval> heap{kronrod(a, b, f)};
+    operand_t value = heap[0].value, error = heap[0].error;
+    while (error > std::max<operand_t>(tol, tol * std::abs(value)))
+    {
+        if (heap.size() >= maxIntervals || !std::isfinite(value))
+            return context.raise(EVAL_NOT_CONVERGED);
+        std::pop_heap(heap.begin(), heap.end());
+        Interval worst = heap.back();
+        heap.pop_back();
+        operand_t mid = (worst.a + worst.b) / 2;
+        // Both halves in a single batch.
+        kronrodPoints(worst.a, mid, x);
+        kronrodPoints(mid, worst.b, x + 15);
+        if (!body.eval(x, f, 30)) return operand_zero;
+        for (auto part : {kronrod(worst.a, mid, f), kronrod(mid, worst.b, f + 15)})
+        {
+            heap.push_back(part);
+            std::push_heap(heap.begin(), heap.end());
+        }
+        value = error = operand_zero;
+        for (const auto& i : heap)
+        {
+            value += i.value;
+            error += i.error;
+        }
+    }
+    return value;
+}
+
+// LIMIT(body, x, a[, dir[, tol]]): the limit of the body as x approaches a
+// from above, or from below when dir is negative, by Richardson
+// extrapolation of its values at a + dir * h for halving h.
+operand_t limit(const TokenList& tkl, Context& context)
+{
+    Call call;
+    if (!parseCall(tkl, context, 1, 2, call)) return operand_zero;
+    operand_t a = call.values[0];
+    operand_t dir = call.values.size() > 1 && call.values[1] < operand_zero
+                        ? -operand_one
+                        : operand_one;
+    operand_t tol =
+        call.values.size() > 2 ? call.values[2] : operand_t(1e-8L);
+
+    constexpr size_t steps = 16;
+    LaneBody f(context, call.bodyBeg, call.bodyEnd, call.var);
+    operand_t x[steps], y[steps];
+    operand_t h = std::max<operand_t>(1, std::abs(a)) / 8;
+    for (size_t k = 0; k < steps; ++k, h /= 2) x[k] = a + dir * h;
+    if (!f.eval(x, y, steps)) return operand_zero;
+
+    // Neville's table towards h = 0, keeping the entry that agrees best with
+    // its neighbours, and stopping once higher orders only make it worse.
+    operand_t table[steps][steps];
+    operand_t best = y[0], bestError = std::numeric_limits<operand_t>::max();
+    for (size_t k = 0; k < steps; ++k)
+    {
+        table[k][0] = y[k];
+        operand_t factor = 1;
+        for (size_t j = 1; j <= k; ++j)
+        {
+            factor *= 2;
+            table[k][j] = table[k][j - 1] +
+                          (table[k][j - 1] - table[k - 1][j - 1]) / (factor - 1);
+            operand_t error =
+                std::max(std::abs(table[k][j] - table[k][j - 1]),
+                         std::abs(table[k][j] - table[k - 1][j - 1]));
+            if (error <= bestError)
+            {
+                bestError = error;
+                best = table[k][j];
+            }
+        }
+        if (k && std::abs(table[k][k] - table[k - 1][k - 1]) > 2 * bestError)
+            break;
+    }
+    if (!(bestError <= tol * std::max<operand_t>(1, std::abs(best))))
+        return context.raise(EVAL_NOT_CONVERGED);
+    return best;
+}
+
+// Iterated Aitken delta squared over the partial results s[0, count),
+// oldest first, count odd. Overwrites s.
+operand_t aitken(operand_t* s, size_t count)
+{
+    for (; count >= 3; count -= 2)
+        for (size_t i = 0; i + 2 < count; ++i)
+        {
+            operand_t d1 = s[i + 1] - s[i], d2 = s[i + 2] - s[i + 1];
+            operand_t dd = d2 - d1;
+            s[i] = dd == operand_zero ? s[i + 2] : s[i + 2] - d2 * d2 / dd;
+        }
+    return s[0];
+}
+
+// SERIES(body, k, a[, tol[, method]]) and PRODUCT: the sum, or product, of
+// the body for k = a, a + 1, ... The partial results are watched directly
+// (method 0), through iterated Aitken extrapolation of the last ones (1),
+// or through Richardson extrapolation in 1 / n of those after n = 8, 16,
+// 32, ... terms (2, the default). The series ends once a window of
+// consecutive values agree within tol, relative or absolute, whichever is
+// larger. A small last term, or a few agreeing Aitken estimates, say little
+// about a slowly decaying tail, so methods 0 and 1 also need their value to
+// agree with the limit that the last two Richardson extrapolations agree
+// on. Every method fails once the extrapolations are exhausted.
+template <bool product>
+operand_t series(const TokenList& tkl, Context& context)
+{
+    Call call;
+    if (!parseCall(tkl, context, 1, 2, call)) return operand_zero;
+    operand_t k = call.values[0];
+    operand_t tol =
+        call.values.size() > 1 ? call.values[1] : operand_t(1e-12L);
+    operand_t method = call.values.size() > 2 ? call.values[2] : operand_t(2);
+    if (method != 0 && method != 1 && method != 2)
+        return context.raise(EVAL_INVALID_EXPR);
+
+    constexpr size_t batch = 64, sums = 9, steps = 20;
+    const size_t window = method == 0 ? 8 : method == 1 ? 4 : 2;
+    auto close = [tol](operand_t a, operand_t b)
+    { return std::abs(a - b) <= tol * std::max<operand_t>(1, std::abs(a)); };
+
+    LaneBody body(context, call.bodyBeg, call.bodyEnd, call.var);
+    operand_t x[batch], t[batch];
+    operand_t s = product ? operand_one : operand_zero, estimate = s;
+    operand_t recent[sums], scratch[sums];
+    operand_t table[steps][steps];
+    size_t quiet = 0, level = 0, next = 8;
+    for (size_t n = 0; n < maxTerms; n += batch)
+    {
+        for (size_t i = 0; i < batch; ++i)
+            x[i] = k + static_cast<operand_t>(n + i);
+        if (!body.eval(x, t, batch)) return operand_zero;
+        for (size_t i = 0; i < batch; ++i)
+        {
+            operand_t previous = s;
+            s = product ? s * t[i] : s + t[i];
+            if (!std::isfinite(s)) return context.raise(EVAL_NOT_CONVERGED);
+            size_t terms = n + i + 1;
+            bool extrapolated = false;
+            if (terms == next && level < steps)
+            {
+                next *= 2;
+                table[level][0] = s;
+                operand_t factor = 1;
+                for (size_t j = 1; j <= level; ++j)
+                {
+                    factor *= 2;
+                    table[level][j] =
+                        table[level][j - 1] +
+                        (table[level][j - 1] - table[level - 1][j - 1]) /
+                            (factor - 1);
+                }
+                ++level;
+                extrapolated = true;
+            }
+            // Whether v is the limit the last two extrapolations agree on.
+            auto settled = [&](operand_t v)
+            {
+                return level >= 2 &&
+                       close(table[level - 1][level - 1],
+                             table[level - 2][level - 2]) &&
+                       close(v, table[level - 1][level - 1]);
+            };
+            operand_t e;
+            bool agree;
+            if (method == 0)
+            {
+                e = s;
+                agree = close(s, previous) && settled(s);
+            }
+            else if (method == 1)
+            {
+                recent[(terms - 1) % sums] = s;
+                if (terms < sums) continue;
+                for (size_t j = 0; j < sums; ++j)
+                    scratch[j] = recent[(terms + j) % sums];
+                e = aitken(scratch, sums);
+                agree = close(e, estimate) && settled(e);
+            }
+            else
+            {
+                if (!extrapolated) continue;
+                e = table[level - 1][level - 1];
+                agree = close(e, estimate);
+            }
+            quiet = agree ? quiet + 1 : 0;
+            estimate = e;
+            if (quiet >= window)
+            {
+                context.stats.seriesTerms = terms;
+                return e;
+            }
+            if (level == steps) break;
+        }
+        if (level == steps) break;
+    }
+    return context.raise(EVAL_NOT_CONVERGED);
+}
+}  // namespace
+
+void Context::importSolvers()
+{
+    funcTable["ROOT"] = Function(FuncType::HIGH_ORDER, root);
+    funcTable["MINIMIZE"] = Function(FuncType::HIGH_ORDER, minimize);
+    funcTable["INTEGRATE"] = Function(FuncType::HIGH_ORDER, integrate);
+    funcTable["LIMIT"] = Function(FuncType::HIGH_ORDER, limit);
+    funcTable["SERIES"] = Function(FuncType::HIGH_ORDER, series<false>);
+    funcTable["PRODUCT"] = Function(FuncType::HIGH_ORDER, series<true>);
+}
+#else
+void Context::importSolvers() {}
+#endif
+}  // namespace eval
\ No newline at end of file
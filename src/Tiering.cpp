@@ -0,0 +1,165 @@
+#include <evaluator/Context.h>
+
+#include <algorithm>
+
+#include <evaluator/Expr.h>
+
+namespace eval
+{
+namespace
+{
+constexpr size_t inlineArgs = 8;
+
+bool runCompiled(Context& context, TierTable::Entry& entry,
+                 const operand_t* const* args, operand_t* out, size_t n)
+{
+    // The interpreter replays what the code leaves, e.g. a division by zero.
+    auto code = entry.code;
+    if (!code->evalBatch(context, args, out, n)) return false;
+    entry.profile.compiledRuns += n;
+    context.stats.operations += code->nodes.size() * n;
+    return true;
+}
+}  // namespace
+
+void Context::promote(TierTable::Entry& entry, uint64_t threshold,
+                      const std::function<bool(Expr&)>& compile)
+{
+    auto& profile = entry.profile;
+    if (entry.code && entry.checked != lastVersion)
+    {
+        for (const auto& d : entry.dependencies)
+            if (version(d.first) != d.second)
+            {
+                entry.code.reset();
+                entry.dependencies.clear();
+                entry.coldSince = profile.runs;
+                profile.promoted = false;
+                ++profile.deoptimizations;
+                break;
+            }
+        entry.checked = lastVersion;
+    }
+    // Bodies that do not compile are retried ever less often.
+    uint64_t wait = threshold << std::min<uint64_t>(profile.failures, 10);
+    if (entry.code || profile.runs - entry.coldSince < wait) return;
+
+    auto code = std::make_shared<Expr>();
+    if (!compile(*code))
+    {
+        entry.coldSince = profile.runs;
+        ++profile.failures;
+        return;
+    }
+    for (const auto& name : code->functions)
+        entry.dependencies.emplace_back(name, version(name));
+    entry.checked = lastVersion;
+    entry.code = std::move(code);
+    profile.promoted = true;
+    profile.nodes = entry.code->nodes.size();
+    profile.deduplicated = entry.code->deduplicated;
+    ++profile.promotions;
+}
+
+TierTable::Entry& Context::countCalls(const std::string& name,
+                                      const Function& f, uint64_t calls)
+{
+    auto& entry = tiers.functions[name];
+    entry.profile.runs += calls;
+    promote(entry, tiering.functionThreshold,
+            [&](Expr& code)
+            {
+                code.exact = true;
+                if (!code.compile(*this, f)) return false;
+                // Redefining the function itself drops its code as well.
+                code.functions.push_back(name);
+                return true;
+            });
+    return entry;
+}
+
+bool Context::tieredCall(const std::string& name, const Function& f,
+                         const TokenList& args, operand_t& value)
+{
+    if (!tiering.enabled) return false;
+    auto& entry = countCalls(name, f, 1);
+    if (!entry.code) return false;
+
+    // Functions passed by name are left to the interpreter.
+    for (const auto& a : args)
+        if (!a.isOperand()) return false;
+    operand_t values[inlineArgs];
+    const operand_t* columns[inlineArgs];
+    std::vector<operand_t> moreValues;
+    std::vector<const operand_t*> moreColumns;
+    operand_t* v = values;
+    const operand_t** c = columns;
+    if (args.size() > inlineArgs)
+    {
+        moreValues.resize(args.size());
+        moreColumns.resize(args.size());
+        v = moreValues.data();
+        c = moreColumns.data();
+    }
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        v[i] = args[i].getOperand();
+        c[i] = &v[i];
+    }
+    return runCompiled(*this, entry, c, &value, 1);
+}
+
+bool Context::tieredCall(const std::string& name, const Function& f,
+                         const operand_t* const* args, operand_t* out,
+                         size_t n)
+{
+    if (!tiering.enabled) return false;
+    auto& entry = countCalls(name, f, n);
+    return entry.code && runCompiled(*this, entry, args, out, n);
+}
+
+std::shared_ptr<Expr> Context::tieredLoop(std::string& key,
+                                          const TokenList& body,
+                                          const std::string& lane, size_t n)
+{
+    auto compile = [&](Expr& code)
+    { return code.compile(*this, body.begin(), body.end(), lane); };
+    auto ite = tiers.loops.find(key);
+    if (ite == tiers.loops.end())
+    {
+        if (tiers.loops.size() >= TierTable::maxLoops)
+        {
+            key.clear();
+            auto code = std::make_shared<Expr>();
+            if (!compile(*code)) return nullptr;
+            return code;
+        }
+        ite = tiers.loops.emplace(key, TierTable::Entry()).first;
+        for (const auto& t : body)
+        {
+            if (!ite->second.text.empty() && t.type != TokenType::COMMA &&
+                t.type != TokenType::RPAREN && t.type != TokenType::LPAREN &&
+                ite->second.text.back() != '(')
+                ite->second.text += ' ';
+            // Loop variables are renamed with a leading #.
+            std::string s = t.toString();
+            ite->second.text += t.isSymbol() && s[0] == '#' ? s.substr(1) : s;
+        }
+    }
+    auto& entry = ite->second;
+    entry.profile.runs += n;
+    promote(entry, tiering.loopThreshold, compile);
+    if (entry.code) entry.profile.compiledRuns += n;
+    return entry.code;
+}
+
+std::vector<std::pair<std::string, TierProfile>> Context::tierProfile() const
+{
+    std::vector<std::pair<std::string, TierProfile>> profiles;
+    for (const auto& e : tiers.functions)
+        profiles.emplace_back(e.first, e.second.profile);
+    for (const auto& e : tiers.loops)
+        profiles.emplace_back(e.second.text, e.second.profile);
+    return profiles;
+}
+}  // namespace eval
\ No newline at end of file
@@ -1,253 +1,487 @@
-#include <evaluator/Tokenizer.h>
-namespace eval
-{
-    std::string Token::toString() const
-    {
-        switch (type)
-        {
-        case TokenType::OPERAND:
-            return std::to_string(std::get<1>(value));
-        case TokenType::SYMBOL:
-            return std::get<2>(value);
-        case TokenType::ADD:
-            return "+";
-        case TokenType::SUB:
-            return "-";
-        case TokenType::MUL:
-            return "*";
-        case TokenType::DIV:
-            return "/";
-        case TokenType::POW:
-            return "^";
-        case TokenType::LPAREN:
-            return "(";
-        case TokenType::RPAREN:
-            return ")";
-        case TokenType::COMMA:
-            return ",";
-        case TokenType::EQ:
-            return "=";
-        default:
-            return "None";
-        }
-    }
-
-    TokenList::TokenList(const std::string &buffer)
-    {
-        auto ite = buffer.begin(), end_ite = buffer.end();
-        parseSpace(ite, end_ite);
-        while (ite != end_ite)
-        {
-            auto tk = parse(ite, end_ite);
-            EVAL_THROW(tk.type == TokenType::NONE, EVAL_PARSE_FAILED);
-            push_back(tk);
-            parseSpace(ite, end_ite);
-        }
-    }
-
-    template <>
-    bool TokenList::parseOperand<int_t>(std::string::const_iterator &ite,
-                                        const std::string::const_iterator &end,
-                                        int_t &opnd)
-    {
-        return parseInt(ite, end, opnd);
-    }
-
-    template <>
-    bool TokenList::parseOperand<decimal_t>(std::string::const_iterator &ite,
-                                            const std::string::const_iterator &end,
-                                            decimal_t &opnd)
-    {
-        return parseDecimal(ite, end, opnd);
-    }
-
-    Token TokenList::parse(std::string::const_iterator &ite,
-                           const std::string::const_iterator &end)
-    {
-        operand_t opnd;
-        if (parseOperand<operand_t>(ite, end, opnd))
-            return Token(opnd);
-        TokenType ty;
-        if (parseOperator(ite, end, ty))
-            return Token(ty);
-        std::string symbol;
-        if (parseSymbol(ite, end, symbol))
-            return Token(symbol);
-        return Token();
-    }
-    void TokenList::parseSpace(std::string::const_iterator &ite,
-                               const std::string::const_iterator &end)
-    {
-        while (ite != end && isSpace(*ite))
-            ++ite;
-    }
-    bool TokenList::parseInt(std::string::const_iterator &ite,
-                             const std::string::const_iterator &end, int_t &opnd)
-    {
-        if (ite == end)
-            return false;
-        if (!isDigit(*ite))
-            return false;
-        std::stringstream ss;
-        while (ite != end && isDigit(*ite))
-        {
-            ss << *ite;
-            ++ite;
-        }
-        ss >> opnd;
-        EVAL_THROW(ss.fail(), EVAL_OPERAND_OVERFLOW);
-        return true;
-    }
-    bool TokenList::parseDecimal(std::string::const_iterator &ite,
-                                 const std::string::const_iterator &end,
-                                 decimal_t &opnd)
-    {
-        if (ite == end)
-            return false;
-        if (!isDigit(*ite))
-            return false;
-        auto cpy = ite;
-        std::stringstream ss;
-        if (isDigitNonZero(*ite))
-        {
-            while (isDigit(*ite))
-            {
-                ss << *ite;
-                ++ite;
-            }
-        }
-        else
-        {
-            ss << *ite;
-            ++ite;
-        }
-        if (*ite == '.')
-        {
-            ss << *ite;
-            ++ite;
-
-            while (isDigit(*ite))
-            {
-                ss << *ite;
-                ++ite;
-            }
-        }
-        if (*ite == 'e' || *ite == 'E')
-        {
-            ss << *ite;
-            ++ite;
-            if (*ite == '+' || *ite == '-')
-            {
-                ss << *ite;
-                ++ite;
-            }
-            if (!isDigit(*ite))
-            {
-                ite = cpy;
-                return false;
-            }
-            while (isDigit(*ite))
-            {
-                ss << *ite;
-                ++ite;
-            }
-        }
-        ss >> opnd;
-        EVAL_THROW(ss.fail(), EVAL_OPERAND_OVERFLOW);
-        return true;
-    }
-
-    bool TokenList::parseOperator(std::string::const_iterator &ite,
-                                  const std::string::const_iterator &end,
-                                  TokenType &ty)
-    {
-        if (ite == end)
-            return false;
-        switch (*ite)
-        {
-        case '+':
-            ty = TokenType::ADD;
-            break;
-        case '-':
-            ty = TokenType::SUB;
-            break;
-        case '*':
-            ty = TokenType::MUL;
-            break;
-        case '/':
-            ty = TokenType::DIV;
-            break;
-        case '^':
-            ty = TokenType::POW;
-            break;
-        case '(':
-            ty = TokenType::LPAREN;
-            break;
-        case ')':
-            ty = TokenType::RPAREN;
-            break;
-        case ',':
-            ty = TokenType::COMMA;
-            break;
-        case '=':
-            ty = TokenType::EQ;
-            break;
-        default:
-            return false;
-        }
-        ++ite;
-        return true;
-    }
-    bool TokenList::parseSymbol(std::string::const_iterator &ite,
-                                const std::string::const_iterator &end,
-                                std::string &symbol)
-    {
-        if (ite == end)
-            return false;
-        if (!isSymbolStart(*ite))
-            return false;
-        symbol.clear();
-        symbol += *ite;
-        ++ite;
-        while (ite != end && isSymbol(*ite))
-        {
-            symbol += *ite;
-            ++ite;
-        }
-        return true;
-    }
-    TokenList::const_iterator findParen(const TokenList::const_iterator &beg,
-                                        const TokenList::const_iterator &end)
-    {
-        int inParen = 0;
-        auto ite = beg;
-        for (; ite != end; ++ite)
-        {
-            if (ite->isLParen())
-                ++inParen;
-            else if (ite->isRParen() && (!(--inParen)))
-                return ite;
-        }
-        return ite;
-    }
-    TokenList::const_iterator findArgSep(const TokenList::const_iterator &beg,
-                                         const TokenList::const_iterator &end)
-    {
-        int inParen = 0;
-        auto ite = beg;
-        for (; ite != end; ++ite)
-        {
-            if (ite->isLParen())
-                ++inParen;
-            else if (ite->isRParen())
-            {
-                if (!inParen)
-                    return ite;
-                --inParen;
-            }
-            else if (!inParen && ite->isComma())
-                return ite;
-        }
-        return ite;
-    }
+#include <evaluator/Tokenizer.h>
+namespace eval
+{
+    std::string Token::toString() const
+    {
+        switch (type)
+        {
+        case TokenType::OPERAND:
+            return std::to_string(std::get<1>(value));
+        case TokenType::SYMBOL:
+            return std::get<2>(value);
+        case TokenType::ADD:
+            return "+";
+        case TokenType::SUB:
+            return "-";
+        case TokenType::MUL:
+            return "*";
+        case TokenType::DIV:
+            return "/";
+        case TokenType::POW:
+            return "^";
+        case TokenType::LPAREN:
+            return "(";
+        case TokenType::RPAREN:
+            return ")";
+        case TokenType::COMMA:
+            return ",";
+        case TokenType::EQ:
+            return "=";
+        default:
+            return "None";
+        }
+    }
+
+    TokenList::TokenList(const std::string &buffer)
+    {
+        auto r = tryParse(buffer);
+        EVAL_THROW(!r, r.error);
+        swap(r.value);
+    }
+
+    Expected<TokenList> TokenList::tryParse(const std::string &buffer)
+    {
+        Expected<TokenList> r;
+        auto ite = buffer.begin(), end_ite = buffer.end();
+        parseSpace(ite, end_ite);
+        while (ite != end_ite)
+        {
+            EVAL_EXCEPTION error = EVAL_PARSE_FAILED;
+            auto tk = r.value.parse(ite, end_ite, error);
+            if (tk.type == TokenType::NONE)
+                return Expected<TokenList>::failure(error, r.value.size());
+            r.value.push_back(tk);
+            parseSpace(ite, end_ite);
+        }
+        auto indexed = r.value.buildIndex();
+        if (!indexed)
+            return Expected<TokenList>::failure(indexed);
+        return r;
+    }
+
+    Expected<bool> TokenList::buildIndex()
+    {
+        auto n = static_cast<int32_t>(size());
+        std::vector<int32_t> open;
+        for (int32_t i = 0; i < n; ++i)
+        {
+            Token &t = (*this)[i];
+            t.span = t.main = 0;
+            if (t.isLParen())
+                open.push_back(i);
+            else if (t.isRParen())
+            {
+                if (open.empty())
+                    return Expected<bool>::failure(EVAL_PAREN_MISMATCH, i);
+                (*this)[open.back()].link = i - open.back();
+                open.pop_back();
+            }
+        }
+        if (!open.empty())
+            return Expected<bool>::failure(EVAL_PAREN_MISMATCH, open.back());
+
+        // Right to left, sep being the next "," or ")" of the level. A ")"
+        // keeps the one after its group, which findArgSep reaches from the
+        // "(".
+        int32_t sep = n;
+        for (int32_t i = n - 1; i >= 0; --i)
+        {
+            Token &t = (*this)[i];
+            if (t.isRParen())
+            {
+                t.link = sep - i;
+                sep = i;
+            }
+            else if (t.isLParen())
+                sep = i + t.link + (*this)[i + t.link].link;
+            else if (t.isComma())
+            {
+                t.link = 0;
+                sep = i;
+            }
+            else
+                t.link = sep - i;
+        }
+
+        // Statements split at their top level "=" and ",".
+        for (int32_t beg = 0; beg <= n;)
+        {
+            int32_t end = beg;
+            while (end < n && !(*this)[end].isEq() && !(*this)[end].isComma())
+                end += (*this)[end].isLParen() ? (*this)[end].link + 1 : 1;
+            index(beg, end, 0);
+            beg = end + 1;
+        }
+        return true;
+    }
+
+    // Records the main operator of [beg, end) and those of its operands,
+    // returning it, or -1 past maxRecursionDepth.
+    int32_t TokenList::index(int32_t beg, int32_t end, unsigned int depth)
+    {
+        if (depth > maxRecursionDepth)
+            return -1;
+        const_iterator first = cbegin() + beg, last = cbegin() + end;
+        const_iterator unmatched;
+        auto main =
+            static_cast<int32_t>(findMainOperator(first, last, unmatched) -
+                                 cbegin());
+        if (unmatched != last)
+            return -1;
+        if (end - beg < 2)
+            return main;
+        Token &t = (*this)[beg];
+        if (!t.span)
+        {
+            t.span = end - beg;
+            t.main = main - beg;
+        }
+        if (main == beg && t.isSub())
+            index(beg + 1, end, depth + 1);
+        else if (main != end)
+        {
+            int32_t left = index(beg, main, depth + 1);
+            Token &op = (*this)[main];
+            if (!op.span && left >= 0)
+            {
+                op.span = beg - main;
+                op.main = left - main;
+            }
+            index(main + 1, end, depth + 1);
+        }
+        else if (t.isLParen() && t.link == end - beg - 1)
+            index(beg + 1, end - 1, depth + 1);
+        else if (t.isSymbol() && first[1].isLParen() &&
+                 first[1].link == end - beg - 2)
+        {
+            // The arguments of a call.
+            for (auto arg = first + 2; arg < last - 1;)
+            {
+                auto argEnd = findArgSep(arg, last - 1);
+                index(static_cast<int32_t>(arg - cbegin()),
+                      static_cast<int32_t>(argEnd - cbegin()), depth + 1);
+                arg = argEnd + 1;
+            }
+        }
+        return main;
+    }
+
+    void TokenList::clip()
+    {
+        auto n = static_cast<int32_t>(size());
+        for (int32_t i = 0; i < n; ++i)
+        {
+            Token &t = (*this)[i];
+            if (t.isLParen() ? t.link >= n - i : t.link > n - i)
+                t.link = t.isLParen() ? -1 : n - i;
+            if (t.span > n - i || t.span < -i)
+                t.span = t.main = 0;
+        }
+    }
+
+    template <>
+    bool TokenList::parseOperand<int_t>(std::string::const_iterator &ite,
+                                        const std::string::const_iterator &end,
+                                        int_t &opnd, bool &overflow)
+    {
+        return parseInt(ite, end, opnd, overflow);
+    }
+
+    template <>
+    bool TokenList::parseOperand<decimal_t>(std::string::const_iterator &ite,
+                                            const std::string::const_iterator &end,
+                                            decimal_t &opnd, bool &overflow)
+    {
+        return parseDecimal(ite, end, opnd, overflow);
+    }
+
+#ifdef EVAL_MIXED_OPERAND
+    // Integer literals that fit are read exactly, anything else as a decimal.
+    template <>
+    bool TokenList::parseOperand<Number>(std::string::const_iterator &ite,
+                                         const std::string::const_iterator &end,
+                                         Number &opnd, bool &overflow)
+    {
+        auto beg = ite;
+        decimal_t d;
+        if (!parseDecimal(ite, end, d, overflow))
+            return false;
+        opnd = d;
+        if (overflow || ite - beg > 19)
+            return true;
+        uint64_t i = 0;
+        for (auto c = beg; c != ite; ++c)
+        {
+            if (!isDigit(*c))
+                return true;
+            i = i * 10 + static_cast<uint64_t>(*c - '0');
+        }
+        opnd = i; // stays decimal above the int64_t range
+        return true;
+    }
+#endif
+
+    Token TokenList::parse(std::string::const_iterator &ite,
+                           const std::string::const_iterator &end,
+                           EVAL_EXCEPTION &error)
+    {
+        operand_t opnd;
+        bool overflow = false;
+        if (parseOperand<operand_t>(ite, end, opnd, overflow))
+        {
+            if (overflow)
+            {
+                error = EVAL_OPERAND_OVERFLOW;
+                return Token();
+            }
+            return Token(opnd);
+        }
+        TokenType ty;
+        if (parseOperator(ite, end, ty))
+            return Token(ty);
+        std::string symbol;
+        if (parseSymbol(ite, end, symbol))
+            return Token(symbol);
+        return Token();
+    }
+    void TokenList::parseSpace(std::string::const_iterator &ite,
+                               const std::string::const_iterator &end)
+    {
+        while (ite != end && isSpace(*ite))
+            ++ite;
+    }
+    bool TokenList::parseInt(std::string::const_iterator &ite,
+                             const std::string::const_iterator &end, int_t &opnd,
+                             bool &overflow)
+    {
+        if (ite == end)
+            return false;
+        if (!isDigit(*ite))
+            return false;
+        std::stringstream ss;
+        while (ite != end && isDigit(*ite))
+        {
+            ss << *ite;
+            ++ite;
+        }
+        ss >> opnd;
+        overflow = ss.fail();
+        return true;
+    }
+    bool TokenList::parseDecimal(std::string::const_iterator &ite,
+                                 const std::string::const_iterator &end,
+                                 decimal_t &opnd, bool &overflow)
+    {
+        if (ite == end)
+            return false;
+        if (!isDigit(*ite))
+            return false;
+        auto cpy = ite;
+        std::stringstream ss;
+        if (isDigitNonZero(*ite))
+        {
+            while (isDigit(*ite))
+            {
+                ss << *ite;
+                ++ite;
+            }
+        }
+        else
+        {
+            ss << *ite;
+            ++ite;
+        }
+        if (*ite == '.')
+        {
+            ss << *ite;
+            ++ite;
+
+            while (isDigit(*ite))
+            {
+                ss << *ite;
+                ++ite;
+            }
+        }
+        if (*ite == 'e' || *ite == 'E')
+        {
+            ss << *ite;
+            ++ite;
+            if (*ite == '+' || *ite == '-')
+            {
+                ss << *ite;
+                ++ite;
+            }
+            if (!isDigit(*ite))
+            {
+                ite = cpy;
+                return false;
+            }
+            while (isDigit(*ite))
+            {
+                ss << *ite;
+                ++ite;
+            }
+        }
+        ss >> opnd;
+        overflow = ss.fail();
+        return true;
+    }
+
+    bool TokenList::parseOperator(std::string::const_iterator &ite,
+                                  const std::string::const_iterator &end,
+                                  TokenType &ty)
+    {
+        if (ite == end)
+            return false;
+        ty = operatorType(*ite);
+        if (ty == TokenType::NONE)
+            return false;
+        ++ite;
+        return true;
+    }
+    bool TokenList::parseSymbol(std::string::const_iterator &ite,
+                                const std::string::const_iterator &end,
+                                std::string &symbol)
+    {
+        if (ite == end)
+            return false;
+        if (!isSymbolStart(*ite))
+            return false;
+        symbol.clear();
+        symbol += *ite;
+        ++ite;
+        while (ite != end && isSymbol(*ite))
+        {
+            symbol += *ite;
+            ++ite;
+        }
+        return true;
+    }
+    TokenList::const_iterator findParen(const TokenList::const_iterator &beg,
+                                        const TokenList::const_iterator &end)
+    {
+        if (beg->isLParen() && beg->link >= 0)
+            return beg->link < end - beg ? beg + beg->link : end;
+        int inParen = 0;
+        auto ite = beg;
+        for (; ite != end; ++ite)
+        {
+            if (ite->isLParen())
+                ++inParen;
+            else if (ite->isRParen() && (!(--inParen)))
+                return ite;
+        }
+        return ite;
+    }
+    TokenList::const_iterator findArgSep(const TokenList::const_iterator &beg,
+                                         const TokenList::const_iterator &end)
+    {
+        if (beg != end && (beg->isComma() || beg->isRParen()))
+            return beg;
+        if (beg != end && beg->link >= 0)
+        {
+            auto ite = beg;
+            if (ite->isLParen())
+            {
+                if (ite->link >= end - ite)
+                    return end;
+                ite += ite->link;
+            }
+            return ite->link < end - ite ? ite + ite->link : end;
+        }
+        int inParen = 0;
+        auto ite = beg;
+        for (; ite != end; ++ite)
+        {
+            if (ite->isLParen())
+                ++inParen;
+            else if (ite->isRParen())
+            {
+                if (!inParen)
+                    return ite;
+                --inParen;
+            }
+            else if (!inParen && ite->isComma())
+                return ite;
+        }
+        return ite;
+    }
+
+    static bool isNegation(const TokenList::const_iterator &beg,
+                           const TokenList::const_iterator &ite)
+    {
+        if (!ite->isSub())
+            return false;
+        if (ite == beg)
+            return true;
+        auto pre = ite - 1;
+        return !pre->isOperand() && !pre->isSymbol() && !pre->isRParen();
+    }
+
+    TokenList::const_iterator findMainOperator(
+        const TokenList::const_iterator &beg,
+        const TokenList::const_iterator &end,
+        TokenList::const_iterator &unmatched)
+    {
+        unmatched = end;
+        if (beg >= end)
+            return end;
+        if (beg->span == end - beg)
+            return beg + beg->main;
+        // The left operand of the binary operator at end, once it is known
+        // that end is before the separator of beg, so in the list.
+        auto sep = beg;
+        if (sep->isLParen() && sep->link >= 0)
+            sep += sep->link;
+        if (sep->link > end - sep && end->span < 0 &&
+            end->span == beg - end)
+            return end + end->main;
+
+        if (beg->isSub()) // "-x", "-(1)", "-(x+1)+3"
+        {
+            int inParen = 0;
+            auto main = end;
+            for (auto ite = beg + 1; ite != end; ++ite)
+            {
+                if (ite->isLParen())
+                    ++inParen;
+                else if (ite->isRParen())
+                    --inParen;
+                else if (!inParen && (ite->isAdd() || ite->isSub()))
+                    main = ite;
+            }
+            if (main != end)
+                return main;
+            if (inParen)
+                unmatched = beg;
+            return beg;
+        }
+
+        int minPre = 4;
+        auto main = end;
+        for (auto ite = beg; ite != end; ++ite)
+        {
+            if (ite->isLParen())
+            {
+                auto lParen = ite;
+                ite = findParen(ite, end);
+                if (ite == end)
+                {
+                    unmatched = lParen;
+                    return end;
+                }
+                continue;
+            }
+            if (ite->isOperator() && !isNegation(beg, ite))
+            {
+                int pre = getOperatorPrecedence(ite->type);
+                if (pre <= minPre)
+                {
+                    minPre = pre;
+                    main = ite;
+                }
+            }
+        }
+        return main;
+    }
 } // namespace eval
\ No newline at end of file
@@ -0,0 +1,517 @@
+#ifndef KERNEL_IMPL_H_
+#define KERNEL_IMPL_H_
+
+// Lane-generic kernel bodies. Every translation unit that includes this
+// header supplies its own Pack type and is compiled with its own target
+// flags, so everything here must stay in the anonymous namespace and must
+// not instantiate std templates that could be merged across units.
+
+#include <cmath>
+#include <cstddef>
+
+#include "KernelTable.h"
+
+namespace eval
+{
+namespace simd
+{
+namespace
+{
+constexpr double INF = HUGE_VAL;
+constexpr double DBL_MIN_NORMAL = 2.2250738585072014e-308;
+
+constexpr double LOG2E = 1.4426950408889634;
+constexpr double LN2_HI = 6.93147180369123816490e-01;  // 32 significant bits
+constexpr double LN2_LO = 1.90821492927058770002e-10;
+constexpr double LOG10_2_HI = 3.01029995549470186234e-01;
+constexpr double LOG10_2_LO = 1.14511008980218384741e-10;
+constexpr double INV_LN10 = 4.34294481903251816668e-01;
+constexpr double SQRT2 = 1.41421356237309514547;
+
+constexpr double TWO_OVER_PI = 6.36619772367581382433e-01;
+// pi/2 split into pieces of at most 33 bits, so n * PIO2_k is exact while
+// n < 2^20.
+constexpr double PIO2_1 = 1.57079632673412561417e+00;
+constexpr double PIO2_2 = 6.07710050630396597660e-11;
+constexpr double PIO2_3 = 2.02226624879595063154e-21;
+constexpr double TRIG_LIMIT = 1.6e6;
+
+constexpr double ATAN_HI[]{0.0, 4.63647609000806093515e-01,
+                           7.85398163397448278999e-01,
+                           9.82793723247329054082e-01,
+                           1.57079632679489655800e+00};
+constexpr double ATAN_LO[]{0.0, 2.26987774529616870924e-17,
+                           3.06161699786838301793e-17,
+                           1.39033110312309984516e-17,
+                           6.12323399573676603587e-17};
+
+// Taylor coefficients: e^r - 1 - r = r^2 * sum EXP_C[k] r^k.
+constexpr double EXP_C[]{1.0 / 2,
+                         1.0 / 6,
+                         1.0 / 24,
+                         1.0 / 120,
+                         1.0 / 720,
+                         1.0 / 5040,
+                         1.0 / 40320,
+                         1.0 / 362880,
+                         1.0 / 3628800,
+                         1.0 / 39916800,
+                         1.0 / 479001600,
+                         1.0 / 6227020800};
+
+// log(1 + f) = 2s + s * z * sum LOG_C[k] z^k with s = f / (2 + f), z = s^2.
+constexpr double LOG_C[]{2.0 / 3,  2.0 / 5,  2.0 / 7,  2.0 / 9,  2.0 / 11,
+                         2.0 / 13, 2.0 / 15, 2.0 / 17, 2.0 / 19, 2.0 / 21};
+
+// sin(r) = r + r^3 * sum SIN_C[k] z^k, cos(r) = 1 - z/2 + z^2 * sum COS_C[k]
+// z^k, z = r^2, |r| <= pi/4.
+constexpr double SIN_C[]{-1.0 / 6,
+                         1.0 / 120,
+                         -1.0 / 5040,
+                         1.0 / 362880,
+                         -1.0 / 39916800,
+                         1.0 / 6227020800,
+                         -1.0 / 1307674368000,
+                         1.0 / 355687428096000,
+                         -1.0 / 121645100408832000};
+constexpr double COS_C[]{1.0 / 24,
+                         -1.0 / 720,
+                         1.0 / 40320,
+                         -1.0 / 3628800,
+                         1.0 / 479001600,
+                         -1.0 / 87178291200,
+                         1.0 / 20922789888000,
+                         -1.0 / 6402373705728000};
+
+// The remaining polynomials are Chebyshev interpolants fitted in long double
+// and expanded around the centre of their interval, u = x - centre.
+
+// (atan(t) - t) / t^3 for z = t^2 in [0, (7/16)^2], centre 0.095703125.
+constexpr double ATAN_C[]{
+    -0.31541081060823267,  0.17541987445654017,  -0.11535268572867716,
+    0.082338470303967556,  -0.061721668873731657, 0.047800154650672402,
+    -0.037891000105190469, 0.030565808615324767,  -0.024994660017128092,
+    0.020659134561989114,  -0.017230516752018941, 0.01480510955393353,
+    -0.012557717181399015};
+
+// erf(x) / x in powers of z = x^2, for z in [0, 1].
+constexpr double ERF_C[]{
+    1.1283791670955126,     -0.37612638903183748,   0.11283791670954955,
+    -0.026866170645091645,  0.0052239776249566033,  -0.00085483269882102311,
+    0.00012055331356527476, -1.4925600561621621e-05, 1.6461076036478061e-06,
+    -1.6351015261761858e-07, 1.4663845604445669e-08, -1.1386077858333009e-09,
+    5.9753801906481388e-11};
+
+// erfc(x) * e^(x^2) on [1, 2], [2, 3.5] and [3.5, 6].
+constexpr double ERFC1_C[]{
+    0.32158541645431749,    -0.16362291773256005,   0.07615103985547747,
+    -0.032930905299565327,  0.01337734095306087,    -0.005145957547835687,
+    0.001886134877208141,   -0.00066193007013441555, 0.00022330994184844856,
+    -7.2658872878861308e-05, 2.2864329257004101e-05, -6.9753625984958491e-06,
+    2.0669255809480091e-06, -5.9449535910971468e-07, 1.6748672351241112e-07,
+    -4.9546943046152594e-08, 1.2901145964860915e-08};
+constexpr double ERFC2_C[]{
+    0.19366209627906869,    -0.063237637560634843,  0.019758592987322837,
+    -0.005934337896998051,  0.0017195818852906331,  -0.00048219508497976328,
+    0.00013118180050139595, -3.4698609586767856e-05, 8.9401563401264908e-06,
+    -2.2473734148840519e-06, 5.5197419944251952e-07, -1.3262534323038736e-07,
+    3.1214513850832412e-08, -7.2006293976373832e-09, 1.6203336718356105e-09,
+    -3.6078021005492296e-10, 8.8498856191370823e-11, -1.8791658273654186e-11};
+constexpr double ERFC3_C[]{
+    0.11630270721024731,    -0.023503448598163151,  0.0046613263689723487,
+    -0.00090809889702970863, 0.00017392830404049155, -3.277578113447901e-05,
+    6.0811145514825971e-06, -1.111567720752253e-06,  2.0029196626179619e-07,
+    -3.55957455313392e-08,  6.2424414747357367e-09, -1.0807637190818787e-09,
+    1.8479427871704101e-10, -3.121952453613281e-11,  5.2207720703124997e-12,
+    -8.6273156249999999e-13, 1.37323e-13,            -2.1975200000000001e-14,
+    4.4889600000000003e-15, -7.3728000000000002e-16};
+
+// gamma(x) on [1, 2], centre 1.5.
+constexpr double GAMMA_C[]{
+    0.88622692545275805,    0.032338397448885031,   0.41481345368830186,
+    -0.10729480456478042,   0.14464535904449782,    -0.077523052298869549,
+    0.058610303826087957,   -0.038001935606749762,  0.025837606121865402,
+    -0.017222441616093674,  0.011522522840240867,   -0.0076902377783312657,
+    0.005131537539849281,   -0.0034225008136976004, 0.0022835841540654656,
+    -0.0015243015378170336, 0.0010085796859736244,  -0.00066495832676688829,
+    0.00047642439603805541, -0.00033913056055704754, 0.00013624926408131917,
+    -5.5607159932454424e-05, 0.00017709732055664061, -0.00014311472574869791};
+
+template <size_t N>
+constexpr size_t countOf(const double (&)[N])
+{
+    return N;
+}
+
+double scalarSin(double x) { return std::sin(x); }
+double scalarCos(double x) { return std::cos(x); }
+double scalarExp(double x) { return std::exp(x); }
+double scalarLn(double x) { return std::log(x); }
+double scalarLg(double x) { return std::log10(x); }
+double scalarAtan(double x) { return std::atan(x); }
+double scalarErf(double x) { return std::erf(x); }
+double scalarGamma(double x) { return std::tgamma(x); }
+double scalarPow(double x, double y) { return std::pow(x, y); }
+
+template <typename V>
+struct Kernels
+{
+    using reg = typename V::reg;
+    using mask = typename V::mask;
+
+    static reg c(double a) { return V::set(a); }
+
+    static reg poly(reg x, const double* k, size_t n)
+    {
+        reg r = c(k[n - 1]);
+        for (size_t i = n - 1; i-- > 0;) r = V::fma(r, x, c(k[i]));
+        return r;
+    }
+
+    template <size_t N>
+    static reg poly(reg x, const double (&k)[N])
+    {
+        return poly(x, k, N);
+    }
+
+    static reg floor(reg x)
+    {
+        reg r = V::round(x);
+        return V::sub(r, V::select(V::gt(r, x), c(1.0), c(0.0)));
+    }
+
+    // s + e == a + b exactly.
+    static void twoSum(reg a, reg b, reg& s, reg& e)
+    {
+        s = V::add(a, b);
+        reg bb = V::sub(s, a);
+        e = V::add(V::sub(a, V::sub(s, bb)), V::sub(b, bb));
+    }
+
+    // p + e == a * b exactly, barring overflow.
+    static void twoProd(reg a, reg b, reg& p, reg& e)
+    {
+        p = V::mul(a, b);
+        if (V::hasFMA)
+        {
+            e = V::fma(a, b, V::sub(c(0.0), p));
+            return;
+        }
+        const reg split = c(134217729.0);  // 2^27 + 1
+        reg t = V::mul(split, a);
+        reg ah = V::sub(t, V::sub(t, a)), al = V::sub(a, ah);
+        t = V::mul(split, b);
+        reg bh = V::sub(t, V::sub(t, b)), bl = V::sub(b, bh);
+        e = V::add(
+            V::add(V::add(V::sub(V::mul(ah, bh), p), V::mul(ah, bl)),
+                   V::mul(al, bh)),
+            V::mul(al, bl));
+    }
+
+    // e^x for -745 < x < 709.7, bad lanes are left to libm.
+    static reg expCore(reg x)
+    {
+        reg k = V::round(V::mul(x, c(LOG2E)));
+        reg r = V::sub(V::sub(x, V::mul(k, c(LN2_HI))), V::mul(k, c(LN2_LO)));
+        reg p = V::add(c(1.0),
+                       V::fma(V::mul(r, r), poly(r, EXP_C), r));
+        // Scale in two steps so subnormal results and k = 1024 stay exact.
+        reg k1 = V::round(V::mul(k, c(0.5)));
+        return V::mul(V::mul(p, V::pow2i(k1)), V::pow2i(V::sub(k, k1)));
+    }
+
+    static reg exp(reg x, mask& bad)
+    {
+        bad = V::mnot(V::mand(V::lt(x, c(709.7)), V::gt(x, c(-745.0))));
+        return expCore(x);
+    }
+
+    // Splits a positive normal x into 2^e * m with m in [sqrt(1/2), sqrt(2)).
+    static void decompose(reg x, reg& e, reg& m)
+    {
+        e = V::exponent(x);
+        m = V::significand(x);
+        mask big = V::gt(m, c(SQRT2));
+        m = V::select(big, V::mul(m, c(0.5)), m);
+        e = V::select(big, V::add(e, c(1.0)), e);
+    }
+
+    // log(m) for m in [sqrt(1/2), sqrt(2)), returned as f - (hfsq - t) so
+    // the caller can fold in the exponent without losing the low bits.
+    static void logCore(reg m, reg& f, reg& hfsq, reg& t)
+    {
+        f = V::sub(m, c(1.0));
+        reg s = V::div(f, V::add(c(2.0), f));
+        reg z = V::mul(s, s);
+        reg R = V::mul(z, poly(z, LOG_C));
+        hfsq = V::mul(c(0.5), V::mul(f, f));
+        t = V::mul(s, V::add(hfsq, R));
+    }
+
+    static mask positiveNormal(reg x)
+    {
+        return V::mand(V::ge(x, c(DBL_MIN_NORMAL)), V::lt(x, c(INF)));
+    }
+
+    static reg ln(reg x, mask& bad)
+    {
+        bad = V::mnot(positiveNormal(x));
+        reg e, m, f, hfsq, t;
+        decompose(x, e, m);
+        logCore(m, f, hfsq, t);
+        return V::sub(
+            V::mul(e, c(LN2_HI)),
+            V::sub(V::sub(hfsq, V::add(t, V::mul(e, c(LN2_LO)))), f));
+    }
+
+    static reg lg(reg x, mask& bad)
+    {
+        bad = V::mnot(positiveNormal(x));
+        reg e, m, f, hfsq, t;
+        decompose(x, e, m);
+        logCore(m, f, hfsq, t);
+        reg logm = V::sub(f, V::sub(hfsq, t));
+        return V::add(V::mul(e, c(LOG10_2_HI)),
+                      V::fma(logm, c(INV_LN10), V::mul(e, c(LOG10_2_LO))));
+    }
+
+    // x = n * pi/2 + r + t with |r| <= pi/4 and q = n mod 4.
+    static void reduce(reg x, reg& r, reg& t, reg& q)
+    {
+        reg n = V::round(V::mul(x, c(TWO_OVER_PI)));
+        reg r1 = V::sub(x, V::mul(n, c(PIO2_1)));
+        reg r2, e2, e3;
+        twoSum(r1, V::sub(c(0.0), V::mul(n, c(PIO2_2))), r2, e2);
+        twoSum(r2, V::sub(c(0.0), V::mul(n, c(PIO2_3))), r, e3);
+        t = V::add(e2, e3);
+        q = V::sub(n, V::mul(c(4.0), floor(V::mul(n, c(0.25)))));
+    }
+
+    static reg sinKernel(reg r, reg t, reg z)
+    {
+        reg v = V::mul(z, r);
+        reg tc = V::sub(t, V::mul(V::mul(t, z), c(0.5)));
+        return V::add(r, V::fma(v, poly(z, SIN_C), tc));
+    }
+
+    static reg cosKernel(reg r, reg t, reg z)
+    {
+        reg hz = V::mul(c(0.5), z);
+        reg w = V::sub(c(1.0), hz);
+        reg tail = V::sub(V::mul(V::mul(z, z), poly(z, COS_C)), V::mul(r, t));
+        return V::add(w, V::add(V::sub(V::sub(c(1.0), w), hz), tail));
+    }
+
+    static reg sincos(reg x, mask& bad, bool cosine)
+    {
+        bad = V::mnot(V::lt(V::abs(x), c(TRIG_LIMIT)));
+        reg r, t, q;
+        reduce(x, r, t, q);
+        if (cosine)  // cos(x) = sin(x + pi/2)
+        {
+            q = V::add(q, c(1.0));
+            q = V::select(V::eq(q, c(4.0)), c(0.0), q);
+        }
+        reg z = V::mul(r, r);
+        reg s = sinKernel(r, t, z), co = cosKernel(r, t, z);
+        mask odd = V::mor(V::eq(q, c(1.0)), V::eq(q, c(3.0)));
+        mask neg = V::ge(q, c(2.0));
+        reg res = V::select(odd, co, s);
+        return V::select(neg, V::sub(c(0.0), res), res);
+    }
+
+    static reg sin(reg x, mask& bad) { return sincos(x, bad, false); }
+    static reg cos(reg x, mask& bad) { return sincos(x, bad, true); }
+
+    static reg atan(reg x, mask& bad)
+    {
+        bad = V::mnot(V::eq(x, x));
+        reg ax = V::abs(x);
+        mask m1 = V::ge(ax, c(7.0 / 16)), m2 = V::ge(ax, c(11.0 / 16)),
+             m3 = V::ge(ax, c(19.0 / 16)), m4 = V::ge(ax, c(39.0 / 16));
+        reg num = ax, den = c(1.0), hi = c(0.0), lo = c(0.0);
+        num = V::select(m1, V::sub(V::add(ax, ax), c(1.0)), num);
+        den = V::select(m1, V::add(c(2.0), ax), den);
+        num = V::select(m2, V::sub(ax, c(1.0)), num);
+        den = V::select(m2, V::add(ax, c(1.0)), den);
+        num = V::select(m3, V::sub(ax, c(1.5)), num);
+        den = V::select(m3, V::fma(ax, c(1.5), c(1.0)), den);
+        num = V::select(m4, c(-1.0), num);
+        den = V::select(m4, ax, den);
+        for (int i = 1; i <= 4; ++i)
+        {
+            mask m = i == 1 ? m1 : i == 2 ? m2 : i == 3 ? m3 : m4;
+            hi = V::select(m, c(ATAN_HI[i]), hi);
+            lo = V::select(m, c(ATAN_LO[i]), lo);
+        }
+        reg t = V::div(num, den);
+        reg z = V::mul(t, t);
+        reg w = V::mul(V::mul(t, z), poly(V::sub(z, c(0.095703125)), ATAN_C));
+        reg res = V::add(hi, V::add(t, V::add(w, lo)));
+        return V::xorv(res, V::sign(x));
+    }
+
+    static reg erf(reg x, mask& bad)
+    {
+        bad = V::mnot(V::eq(x, x));
+        reg ax = V::abs(x);
+        reg res = c(1.0);
+        mask small = V::lt(ax, c(1.0));
+        if (V::bits(small))
+        {
+            reg g = poly(V::mul(ax, ax), ERF_C);
+            res = V::select(small, V::mul(ax, g), res);
+        }
+        mask mid = V::mand(V::mnot(small), V::lt(ax, c(6.0)));
+        if (V::bits(mid))
+        {
+            mask m2 = V::ge(ax, c(2.0)), m3 = V::ge(ax, c(3.5));
+            reg h = poly(V::sub(ax, c(1.5)), ERFC1_C);
+            if (V::bits(V::mand(mid, m2)))
+                h = V::select(m2, poly(V::sub(ax, c(2.75)), ERFC2_C), h);
+            if (V::bits(V::mand(mid, m3)))
+                h = V::select(m3, poly(V::sub(ax, c(4.75)), ERFC3_C), h);
+            reg x2, x2e;
+            twoProd(ax, ax, x2, x2e);
+            reg ex = expCore(V::sub(c(0.0), V::select(mid, x2, c(0.0))));
+            ex = V::sub(ex, V::mul(ex, x2e));
+            res = V::select(mid, V::sub(c(1.0), V::mul(ex, h)), res);
+        }
+        return V::xorv(res, V::sign(x));
+    }
+
+    static reg gamma(reg x, mask& bad)
+    {
+        bad = V::mnot(V::mand(V::ge(x, c(1e-300)), V::le(x, c(171.0))));
+        x = V::select(bad, c(1.5), x);
+        mask small = V::lt(x, c(1.0));
+        reg y = V::select(small, V::add(x, c(1.0)), x);
+        reg steps = V::sub(floor(y), c(1.0));
+        reg g = poly(V::sub(V::sub(y, steps), c(1.5)), GAMMA_C);
+
+        double lanes[V::width];
+        V::store(lanes, steps);
+        double most = 0;
+        for (size_t i = 0; i < V::width; ++i)
+            if (lanes[i] > most) most = lanes[i];
+
+        // gamma(y) = (y - 1)(y - 2)...(y - steps) gamma(y - steps), with the
+        // product carried in double-double and pre-scaled by 2^-600 so the
+        // Dekker split cannot overflow.
+        reg ph = c(0x1p-600), pl = c(0.0);
+        for (double j = 1; j <= most; ++j)
+        {
+            reg a = V::select(V::le(c(j), steps), V::sub(y, c(j)), c(1.0));
+            reg p, e;
+            twoProd(ph, a, p, e);
+            pl = V::fma(pl, a, e);
+            ph = p;
+        }
+        reg res = V::mul(V::fma(ph, g, V::mul(pl, g)), c(0x1p600));
+        return V::select(small, V::div(res, x), res);
+    }
+
+    static reg pow(reg x, reg y, mask& bad)
+    {
+        bad = V::mnot(V::mand(positiveNormal(x), V::lt(V::abs(y), c(INF))));
+        x = V::select(bad, c(1.0), x);
+        y = V::select(bad, c(0.0), y);
+
+        // log(x) in double-double: e * ln2 + 2s + 2s^3/3 + s^5 R(s^2).
+        reg e, m;
+        decompose(x, e, m);
+        reg f = V::sub(m, c(1.0));
+        reg d = V::add(c(2.0), f);
+        reg dl = V::sub(f, V::sub(d, c(2.0)));
+        reg sh = V::div(f, d);
+        reg p, pe;
+        twoProd(sh, d, p, pe);
+        reg sl = V::div(V::sub(V::sub(V::sub(f, p), pe), V::mul(sh, dl)), d);
+
+        reg s2h, s2l, s3h, s3l;
+        twoProd(sh, sh, s2h, s2l);
+        s2l = V::fma(V::add(sh, sh), sl, s2l);
+        twoProd(s2h, sh, s3h, s3l);
+        s3l = V::add(s3l, V::fma(s2h, sl, V::mul(s2l, sh)));
+        reg t3h, t3l;
+        twoProd(s3h, c(2.0 / 3), t3h, t3l);
+        t3l = V::fma(s3l, c(2.0 / 3), V::fma(s3h, c(3.7007434154171883e-17),
+                                              t3l));
+        reg z = s2h;
+        reg tail = V::mul(V::mul(s3h, z), poly(z, LOG_C + 1, countOf(LOG_C) - 1));
+
+        reg hi, lo;
+        twoSum(V::add(sh, sh), t3h, hi, lo);
+        lo = V::add(lo, V::add(V::add(V::add(sl, sl), t3l), tail));
+        reg h2, l2;
+        twoSum(V::mul(e, c(LN2_HI)), hi, h2, l2);
+        l2 = V::add(l2, V::fma(e, c(LN2_LO), lo));
+        twoSum(h2, l2, hi, lo);
+
+        reg ph, pl;
+        twoProd(y, hi, ph, pl);
+        pl = V::fma(y, lo, pl);
+        reg w, wl;
+        twoSum(ph, pl, w, wl);
+        bad = V::mor(bad, V::mnot(V::lt(V::abs(w), c(708.0))));
+        reg r = expCore(V::select(bad, c(0.0), w));
+        return V::fma(r, wl, r);
+    }
+
+    template <reg (*K)(reg, mask&), double (*S)(double)>
+    static void map(const double* x, double* y, size_t n)
+    {
+        double buf[V::width];
+        for (size_t i = 0; i < n; i += V::width)
+        {
+            size_t w = n - i < V::width ? n - i : V::width;
+            const double* in = x + i;
+            if (w < V::width)
+            {
+                for (size_t j = 0; j < V::width; ++j)
+                    buf[j] = j < w ? x[i + j] : 1.0;
+                in = buf;
+            }
+            mask bad;
+            reg r = K(V::load(in), bad);
+            int b = V::bits(bad);
+            V::store(buf, r);
+            for (size_t j = 0; j < w; ++j)
+                y[i + j] = (b >> j) & 1 ? S(x[i + j]) : buf[j];
+        }
+    }
+
+    static void pow(const double* x, const double* y, double* z, size_t n)
+    {
+        double bx[V::width], by[V::width];
+        for (size_t i = 0; i < n; i += V::width)
+        {
+            size_t w = n - i < V::width ? n - i : V::width;
+            for (size_t j = 0; j < V::width; ++j)
+            {
+                bx[j] = j < w ? x[i + j] : 1.0;
+                by[j] = j < w ? y[i + j] : 1.0;
+            }
+            mask bad;
+            reg r = pow(V::load(bx), V::load(by), bad);
+            int b = V::bits(bad);
+            V::store(bx, r);
+            for (size_t j = 0; j < w; ++j)
+                z[i + j] = (b >> j) & 1 ? scalarPow(x[i + j], y[i + j]) : bx[j];
+        }
+    }
+
+    static KernelTable table()
+    {
+        return {map<sin, scalarSin>,     map<cos, scalarCos>,
+                map<exp, scalarExp>,     map<ln, scalarLn>,
+                map<lg, scalarLg>,       map<atan, scalarAtan>,
+                map<erf, scalarErf>,     map<gamma, scalarGamma>,
+                pow};
+    }
+};
+}  // namespace
+}  // namespace simd
+}  // namespace eval
+
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef KERNEL_TABLE_H_
+#define KERNEL_TABLE_H_
+
+#include <cstddef>
+
+namespace eval
+{
+namespace simd
+{
+struct KernelTable
+{
+    using Unary = void (*)(const double*, double*, size_t);
+    using Binary = void (*)(const double*, const double*, double*, size_t);
+
+    Unary sin, cos, exp, ln, lg, atan, erf, gamma;
+    Binary pow;
+};
+
+// One table per translation unit, each compiled with its own target flags.
+const KernelTable& scalarKernels();
+#ifdef EVAL_SIMD_X86
+const KernelTable& sse2Kernels();
+const KernelTable& avx2Kernels();
+const KernelTable& avx512Kernels();
+#endif
+}  // namespace simd
+}  // namespace eval
+
+#endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include <immintrin.h>
+
+#include "KernelImpl.h"
+
+namespace eval
+{
+namespace simd
+{
+namespace
+{
+struct PackAVX2
+{
+    using reg = __m256d;
+    using mask = __m256d;
+    static constexpr size_t width = 4;
+    static constexpr bool hasFMA = true;
+
+    static reg load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, reg a) { _mm256_storeu_pd(p, a); }
+    static reg set(double a) { return _mm256_set1_pd(a); }
+
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+    static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+    static reg abs(reg a) { return _mm256_andnot_pd(set(-0.0), a); }
+    static reg sign(reg a) { return _mm256_and_pd(set(-0.0), a); }
+    static reg xorv(reg a, reg b) { return _mm256_xor_pd(a, b); }
+
+    static mask lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static mask le(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static mask gt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static mask ge(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static mask eq(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static mask mand(mask a, mask b) { return _mm256_and_pd(a, b); }
+    static mask mor(mask a, mask b) { return _mm256_or_pd(a, b); }
+    static mask mnot(mask a)
+    {
+        return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi32(-1)));
+    }
+    static reg select(mask m, reg a, reg b)
+    {
+        return _mm256_blendv_pd(b, a, m);
+    }
+    static int bits(mask m) { return _mm256_movemask_pd(m); }
+
+    static reg round(reg a)
+    {
+        return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    // 2^k for integral k in [-1022, 1023].
+    static reg pow2i(reg k)
+    {
+        __m256i b = _mm256_castpd_si256(add(k, set(6755399441055744.0)));
+        b = _mm256_add_epi64(b, _mm256_set1_epi64x(1023));
+        return _mm256_castsi256_pd(_mm256_slli_epi64(b, 52));
+    }
+    // Unbiased exponent of a positive normal number.
+    static reg exponent(reg x)
+    {
+        __m256i b = _mm256_srli_epi64(_mm256_castpd_si256(x), 52);
+        b = _mm256_or_si256(b, _mm256_castpd_si256(set(4503599627370496.0)));
+        return sub(_mm256_castsi256_pd(b), set(4503599627370496.0 + 1023));
+    }
+    // Significand of a positive normal number, in [1, 2).
+    static reg significand(reg x)
+    {
+        __m256i b = _mm256_and_si256(_mm256_castpd_si256(x),
+                                     _mm256_set1_epi64x(0x000fffffffffffffLL));
+        b = _mm256_or_si256(b, _mm256_set1_epi64x(0x3ff0000000000000LL));
+        return _mm256_castsi256_pd(b);
+    }
+};
+}  // namespace
+
+const KernelTable& avx2Kernels()
+{
+    static const KernelTable table = Kernels<PackAVX2>::table();
+    return table;
+}
+}  // namespace simd
+}  // namespace eval
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <immintrin.h>
+
+#include "KernelImpl.h"
+
+namespace eval
+{
+namespace simd
+{
+namespace
+{
+// Restricted to AVX-512F; the floating point logic instructions need DQ, so
+// sign manipulation goes through the integer unit.
+struct PackAVX512
+{
+    using reg = __m512d;
+    using mask = __mmask8;
+    static constexpr size_t width = 8;
+    static constexpr bool hasFMA = true;
+
+    static reg load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, reg a) { _mm512_storeu_pd(p, a); }
+    static reg set(double a) { return _mm512_set1_pd(a); }
+
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+    static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+    static reg abs(reg a) { return _mm512_abs_pd(a); }
+    static reg sign(reg a)
+    {
+        return _mm512_castsi512_pd(
+            _mm512_and_si512(_mm512_castpd_si512(a),
+                             _mm512_set1_epi64(0x8000000000000000LL)));
+    }
+    static reg xorv(reg a, reg b)
+    {
+        return _mm512_castsi512_pd(
+            _mm512_xor_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b)));
+    }
+
+    static mask lt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static mask le(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+    static mask gt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static mask ge(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+    static mask eq(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+    static mask mand(mask a, mask b) { return static_cast<mask>(a & b); }
+    static mask mor(mask a, mask b) { return static_cast<mask>(a | b); }
+    static mask mnot(mask a) { return static_cast<mask>(~a); }
+    static reg select(mask m, reg a, reg b)
+    {
+        return _mm512_mask_blend_pd(m, b, a);
+    }
+    static int bits(mask m) { return m; }
+
+    static reg round(reg a)
+    {
+        return _mm512_roundscale_pd(a,
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    // 2^k for integral k in [-1022, 1023].
+    static reg pow2i(reg k)
+    {
+        __m512i b = _mm512_castpd_si512(add(k, set(6755399441055744.0)));
+        b = _mm512_add_epi64(b, _mm512_set1_epi64(1023));
+        return _mm512_castsi512_pd(_mm512_slli_epi64(b, 52));
+    }
+    // Unbiased exponent of a positive normal number.
+    static reg exponent(reg x)
+    {
+        __m512i b = _mm512_srli_epi64(_mm512_castpd_si512(x), 52);
+        b = _mm512_or_si512(b, _mm512_castpd_si512(set(4503599627370496.0)));
+        return sub(_mm512_castsi512_pd(b), set(4503599627370496.0 + 1023));
+    }
+    // Significand of a positive normal number, in [1, 2).
+    static reg significand(reg x)
+    {
+        __m512i b = _mm512_and_si512(_mm512_castpd_si512(x),
+                                     _mm512_set1_epi64(0x000fffffffffffffLL));
+        b = _mm512_or_si512(b, _mm512_set1_epi64(0x3ff0000000000000LL));
+        return _mm512_castsi512_pd(b);
+    }
+};
+}  // namespace
+
+const KernelTable& avx512Kernels()
+{
+    static const KernelTable table = Kernels<PackAVX512>::table();
+    return table;
+}
+}  // namespace simd
+}  // namespace eval
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <emmintrin.h>
+
+#include "KernelImpl.h"
+
+namespace eval
+{
+namespace simd
+{
+namespace
+{
+struct PackSSE2
+{
+    using reg = __m128d;
+    using mask = __m128d;
+    static constexpr size_t width = 2;
+    static constexpr bool hasFMA = false;
+
+    static reg load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, reg a) { _mm_storeu_pd(p, a); }
+    static reg set(double a) { return _mm_set1_pd(a); }
+
+    static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+    static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+    static reg abs(reg a) { return _mm_andnot_pd(set(-0.0), a); }
+    static reg sign(reg a) { return _mm_and_pd(set(-0.0), a); }
+    static reg xorv(reg a, reg b) { return _mm_xor_pd(a, b); }
+
+    static mask lt(reg a, reg b) { return _mm_cmplt_pd(a, b); }
+    static mask le(reg a, reg b) { return _mm_cmple_pd(a, b); }
+    static mask gt(reg a, reg b) { return _mm_cmpgt_pd(a, b); }
+    static mask ge(reg a, reg b) { return _mm_cmpge_pd(a, b); }
+    static mask eq(reg a, reg b) { return _mm_cmpeq_pd(a, b); }
+    static mask mand(mask a, mask b) { return _mm_and_pd(a, b); }
+    static mask mor(mask a, mask b) { return _mm_or_pd(a, b); }
+    static mask mnot(mask a)
+    {
+        return _mm_xor_pd(a, _mm_castsi128_pd(_mm_set1_epi32(-1)));
+    }
+    static reg select(mask m, reg a, reg b)
+    {
+        return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));
+    }
+    static int bits(mask m) { return _mm_movemask_pd(m); }
+
+    // Round to nearest even with the 1.5 * 2^52 trick; anything larger is
+    // integral already.
+    static reg round(reg a)
+    {
+        const reg magic = set(6755399441055744.0);
+        return select(lt(abs(a), set(2251799813685248.0)),
+                      sub(add(a, magic), magic), a);
+    }
+    // 2^k for integral k in [-1022, 1023].
+    static reg pow2i(reg k)
+    {
+        __m128i b = _mm_castpd_si128(add(k, set(6755399441055744.0)));
+        b = _mm_add_epi64(b, _mm_set1_epi64x(1023));
+        return _mm_castsi128_pd(_mm_slli_epi64(b, 52));
+    }
+    // Unbiased exponent of a positive normal number.
+    static reg exponent(reg x)
+    {
+        __m128i b = _mm_srli_epi64(_mm_castpd_si128(x), 52);
+        b = _mm_or_si128(b, _mm_castpd_si128(set(4503599627370496.0)));
+        return sub(_mm_castsi128_pd(b), set(4503599627370496.0 + 1023));
+    }
+    // Significand of a positive normal number, in [1, 2).
+    static reg significand(reg x)
+    {
+        __m128i b = _mm_and_si128(_mm_castpd_si128(x),
+                                  _mm_set1_epi64x(0x000fffffffffffffLL));
+        b = _mm_or_si128(b, _mm_set1_epi64x(0x3ff0000000000000LL));
+        return _mm_castsi128_pd(b);
+    }
+};
+}  // namespace
+
+const KernelTable& sse2Kernels()
+{
+    static const KernelTable table = Kernels<PackSSE2>::table();
+    return table;
+}
+}  // namespace simd
+}  // namespace eval
\ No newline at end of file
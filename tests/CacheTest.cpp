@@ -0,0 +1,39 @@
+#include "Check.h"
+
+// Cached results are dropped when a symbol they read changes, in the
+// context itself or in the layer a fork reads through to.
+int main()
+{
+    eval::Context parent;
+    parent.cache.setCapacity(16);
+    check::exec(parent, "x = 1");
+    check::exec(parent, "f(a) = a * x");
+    check::value(parent, "f(2) + 1", 3);
+    check::value(parent, "f(2) + 1", 3);
+    check::expect(parent.cache.stats().hits == 1, "repeated input hits");
+    check::exec(parent, "x = 2");
+    check::value(parent, "f(2) + 1", 5);
+    check::exec(parent, "f(a) = a - x");
+    check::value(parent, "f(2) + 1", 1);
+
+    // The fork, then the parent, then the fork write x.
+    auto fork = parent.fork();
+    fork.cache.setCapacity(16);
+    check::exec(parent, "x = 4");
+    check::exec(parent, "x = 5");
+    check::value(fork, "x + 1", 6);
+    check::exec(fork, "x = 100");
+    check::value(fork, "x + 1", 101);
+    check::exec(parent, "x = 7");
+    check::value(fork, "x + 1", 101);
+    check::value(parent, "x + 1", 8);
+
+    // Two forks of one parent.
+    auto other = parent.fork();
+    other.cache.setCapacity(16);
+    check::value(other, "x + 1", 8);
+    check::exec(other, "x = 9");
+    check::value(other, "x + 1", 10);
+    check::value(fork, "x + 1", 101);
+    return check::result();
+}
\ No newline at end of file
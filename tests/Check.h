@@ -0,0 +1,78 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include <evaluator/Context.h>
+
+// Checks for the test programs, which report every failed check and exit
+// with the number of them.
+namespace check
+{
+inline int failures = 0;
+
+inline bool expect(bool ok, const std::string& what)
+{
+    if (!ok)
+    {
+        ++failures;
+        std::cerr << "FAILED: " << what << '\n';
+    }
+    return ok;
+}
+
+inline std::string describe(const eval::Expected<eval::operand_t>& r)
+{
+    if (!r) return eval::EVAL_EXCEPTION_MSG[r.error];
+    return std::to_string(static_cast<long double>(r.value));
+}
+
+// The value of input run as the REPL runs it, through the result cache.
+inline eval::Expected<eval::operand_t> evaluate(eval::Context& context,
+                                                const std::string& input)
+{
+    auto r = context.tryExec(input);
+    if (!r) return eval::Expected<eval::operand_t>::failure(r);
+    return r.value.second;
+}
+
+// input evaluates to expected, within tolerance when it is not 0.
+inline bool value(eval::Context& context, const std::string& input,
+                  long double expected, long double tolerance = 0)
+{
+    auto r = evaluate(context, input);
+    long double v = r ? static_cast<long double>(r.value) : 0;
+    bool ok = r && (tolerance ? std::fabs(v - expected) <= tolerance
+                              : v == expected);
+    return expect(ok, input + " gave " + describe(r) + ", expected " +
+                          std::to_string(expected));
+}
+
+// input fails with the given error.
+inline bool error(eval::Context& context, const std::string& input,
+                  eval::EVAL_EXCEPTION expected)
+{
+    auto r = evaluate(context, input);
+    return expect(!r && r.error == expected,
+                  input + " gave " + describe(r) + ", expected " +
+                      eval::EVAL_EXCEPTION_MSG[expected]);
+}
+
+// Runs the definitions, which must succeed.
+inline void exec(eval::Context& context, const std::string& input)
+{
+    auto r = context.tryExec(input);
+    expect(static_cast<bool>(r),
+           input + " failed: " + eval::EVAL_EXCEPTION_MSG[r.error]);
+}
+
+inline int result()
+{
+    if (failures) std::cerr << failures << " checks failed\n";
+    return failures ? 1 : 0;
+}
+}  // namespace check
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "Check.h"
+
+// Errors come back through Expected the same way with and without
+// EVAL_NO_THROW, this program being built both ways.
+int main()
+{
+    eval::Context context;
+    context.importMath();
+    check::exec(context, "sq(x) = x * x");
+    check::exec(context, "g(x) = zz(x)");
+    check::exec(context, "h(x) = rand(x)");
+
+    // Builtins given a function or the wrong number of arguments.
+    check::error(context, "abs(sq)", eval::EVAL_UNEXPECTED_TOKEN_TYPE);
+    check::error(context, "max(1, sq)", eval::EVAL_UNEXPECTED_TOKEN_TYPE);
+    check::error(context, "rand(1)", eval::EVAL_WRONG_NUMBER_OF_ARGS);
+    check::error(context, "eq(1, 2, 3)", eval::EVAL_WRONG_NUMBER_OF_ARGS);
+    check::error(context, "abs(1, 2)", eval::EVAL_WRONG_NUMBER_OF_ARGS);
+    check::error(context, "h(1)", eval::EVAL_WRONG_NUMBER_OF_ARGS);
+    check::error(context, "SUM(h(k), k, 1, 100)",
+                 eval::EVAL_WRONG_NUMBER_OF_ARGS);
+    check::error(context, "sum(rand(vec(1, 2)))",
+                 eval::EVAL_WRONG_NUMBER_OF_ARGS);
+    check::value(context, "max(3, 1, 2) + min(4)", 7);
+
+#ifdef EVAL_DECIMAL_OPERAND
+    check::error(context, "sin(sq)", eval::EVAL_UNEXPECTED_TOKEN_TYPE);
+
+    // Derivatives through undefined functions and non-symbols.
+    check::error(context, "D(g, 1)", eval::EVAL_UNDEFINED_SYMBOL);
+    check::error(context, "D(1, 1)", eval::EVAL_UNEXPECTED_TOKEN_TYPE);
+    check::value(context, "D(sq, 3)", 6, 1e-12L);
+#endif
+
+    check::error(context, "1 +", eval::EVAL_INVALID_EXPR);
+    check::error(context, "zz + 1", eval::EVAL_UNDEFINED_SYMBOL);
+    return check::result();
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <future>
+#include <vector>
+
+#include <evaluator/Executor.h>
+
+#include "Check.h"
+
+namespace
+{
+// The results of the same tasks submitted in the same order.
+std::vector<eval::Executor::Result> run(const eval::Context& library,
+                                        unsigned int threads, size_t maxBatch)
+{
+    eval::Executor executor(library, threads, maxBatch);
+    std::vector<std::future<eval::Executor::Result>> futures;
+    for (int i = 0; i < 400; ++i)
+    {
+        if (i % 3 == 0)
+            futures.push_back(executor.submit("rand(0, 1000) + 1"));
+        else if (i % 3 == 1)
+            futures.push_back(executor.call("noisy", {eval::operand_t(i)}));
+        else
+            futures.push_back(executor.call("square", {eval::operand_t(i)}));
+    }
+    std::vector<eval::Executor::Result> results;
+    for (auto& f : futures) results.push_back(f.get());
+    return results;
+}
+}  // namespace
+
+// Tasks draw rand by submission order, whatever thread runs them.
+int main()
+{
+    eval::Context library;
+    library.importMath();
+    library.random.reseed(42);
+    check::exec(library, "noisy(x) = x + rand(0, 1000)");
+    check::exec(library, "square(x) = x * x");
+
+    auto one = run(library, 1, 64);
+    for (auto [threads, maxBatch] : {std::pair<unsigned int, size_t>{4, 64},
+                                     {4, 1},
+                                     {3, 7}})
+    {
+        auto other = run(library, threads, maxBatch);
+        size_t different = 0;
+        for (size_t i = 0; i < one.size(); ++i)
+            different += !(one[i] && other[i] && one[i].value == other[i].value);
+        check::expect(!different, std::to_string(different) +
+                                      " results differ on " +
+                                      std::to_string(threads) + " threads");
+    }
+    for (size_t i = 2; i < one.size(); i += 3)
+        check::expect(one[i] && one[i].value == eval::operand_t(i * i),
+                      "square(" + std::to_string(i) + ")");
+    return check::result();
+}
\ No newline at end of file
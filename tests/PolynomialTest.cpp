@@ -0,0 +1,95 @@
+#include <string>
+#include <vector>
+
+#include <evaluator/Polynomial.h>
+
+#include "Check.h"
+
+namespace
+{
+bool same(const eval::Expected<eval::operand_t>& a,
+          const eval::Expected<eval::operand_t>& b)
+{
+    if (a.ok != b.ok) return false;
+    if (!a.ok) return a.error == b.error;
+    if (a.value == b.value) return true;
+#ifdef EVAL_DECIMAL_OPERAND
+    return a.value != a.value && b.value != b.value;
+#else
+    return false;
+#endif
+}
+
+// Single calls, which the interpreter runs, against one batch, which runs
+// compiled once tiering sees it.
+void compare(eval::Context& context, const std::string& name,
+             const std::vector<eval::operand_t>& xs)
+{
+    std::vector<eval::Expected<eval::operand_t>> batch(xs.size());
+    const eval::operand_t* args[] = {xs.data()};
+    for (int pass = 0; pass < 2; ++pass)
+        context.tryCall(name, args, 1, xs.size(), batch.data());
+    size_t different = 0;
+    for (size_t i = 0; i < xs.size(); ++i)
+        different += !same(context.tryCall(name, {xs[i]}), batch[i]);
+    check::expect(!different, name + ": " + std::to_string(different) +
+                                  " compiled calls differ");
+    bool compiled = false;
+    for (const auto& p : context.tierProfile())
+        compiled = compiled || (p.first == name && p.second.compiledRuns);
+    check::expect(compiled, name + " ran compiled");
+}
+}  // namespace
+
+// Bodies recognized as polynomials or rational functions give the same
+// results interpreted, compiled and inlined.
+int main()
+{
+    eval::Context context;
+    context.importMath();
+    context.tiering.functionThreshold = 0;
+    check::exec(context, "f(x) = x ^ 5 - x ^ 4 + 2 * x - 3");
+    check::exec(context, "p(x) = (x + 1) ^ 10");
+    check::exec(context, "q(x) = 3 * x ^ 3 - x");
+    check::exec(context, "g(x) = f(x) * q(x) + 1");
+    check::exec(context, "r(x) = (x ^ 2 + 1) / (x - 1)");
+    check::exec(context, "s(x) = 1 / (x - 1) + 1 / (x + 1)");
+    check::exec(context, "w(x) = x * (x - x)");
+
+#ifdef EVAL_DECIMAL_OPERAND
+    auto f = context.rationalForm("f");
+    if (check::expect(f && f->polynomial(), "f is a polynomial"))
+    {
+        auto c = f->numerator.coefficients(0);
+        check::expect(c.size() == 6 && c[0] == -3 && c[1] == 2 && c[2] == 0 &&
+                          c[3] == 0 && c[4] == -1 && c[5] == 1,
+                      "coefficients of f");
+    }
+    auto p = context.rationalForm("p");
+    check::expect(p && p->numerator.degree(0) == 10, "p has degree 10");
+    check::expect(!context.rationalForm("g"), "g calls other functions");
+    // Mixed operands keep quotients of integers exact, so only polynomials
+    // are recognized.
+    auto r = context.rationalForm("r");
+#ifdef EVAL_MIXED_OPERAND
+    check::expect(!r, "r is left to the interpreter");
+#else
+    check::expect(r && !r->polynomial(), "r is a rational function");
+#endif
+    check::exec(context, "h(x) = x * x ^ 0.5");
+    check::expect(!context.rationalForm("h"), "h has a fractional power");
+    check::value(context, "p(1)", 1024);
+    check::error(context, "r(1)", eval::EVAL_DIV_BY_ZERO);
+#endif
+
+    std::vector<eval::operand_t> xs;
+    for (int i = 0; i < 1000; ++i)
+#ifdef EVAL_DECIMAL_OPERAND
+        xs.push_back(eval::operand_t(i * 0.013L - 3));
+#else
+        xs.push_back(eval::operand_t(i % 9 - 4));
+#endif
+    for (auto name : {"f", "p", "q", "g", "r", "s", "w"})
+        compare(context, name, xs);
+    return check::result();
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "Check.h"
+
+// Series report the limit or fail, never a value that merely stopped
+// changing.
+int main()
+{
+    eval::Context context;
+    context.importMath();
+    using eval::EVAL_NOT_CONVERGED;
+#ifdef EVAL_DECIMAL_OPERAND
+    const long double zeta2 = 1.64493406684822643647L;
+    const long double zeta3 = 1.20205690315959428540L;
+
+    // Richardson extrapolation, the default.
+    check::value(context, "SERIES(1/k^2, k, 1)", zeta2, 1e-11L);
+    check::value(context, "SERIES(1/k^3, k, 1)", zeta3, 1e-11L);
+    check::value(context, "PRODUCT(1+1/k^2, k, 1)",
+                 3.67607791037497772L, 1e-10L);
+
+    // Partial sums: a small last term is not convergence.
+    check::error(context, "SERIES(1/k^2, k, 1, 1e-12, 0)",
+                 EVAL_NOT_CONVERGED);
+    check::value(context, "SERIES(0.5^k, k, 0, 1e-12, 0)", 2, 1e-11L);
+
+    // Aitken: estimates that agree with each other are not convergence
+    // either.
+    check::error(context, "SERIES(1/k^1.5, k, 1, 1e-12, 1)",
+                 EVAL_NOT_CONVERGED);
+    check::error(context, "SERIES(1/k^2, k, 1, 1e-12, 1)",
+                 EVAL_NOT_CONVERGED);
+    check::error(context, "SERIES(1/k^2, k, 1, 1e-8, 1)",
+                 EVAL_NOT_CONVERGED);
+    check::value(context, "SERIES(1/k^3, k, 1, 1e-12, 1)", zeta3, 1e-11L);
+    check::value(context, "SERIES((-1)^k/(k+1), k, 0, 1e-12, 1)",
+                 0.69314718055994530942L, 1e-11L);
+    check::value(context, "SERIES(0.5^k, k, 0, 1e-12, 1)", 2, 1e-11L);
+#endif
+    return check::result();
+}
\ No newline at end of file
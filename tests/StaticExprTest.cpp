@@ -0,0 +1,128 @@
+#include <cstring>
+#include <string>
+
+#include <evaluator/StaticExpr.h>
+
+#include "Check.h"
+
+namespace
+{
+// Bit for bit, NaNs of any payload being equal.
+#if defined(EVAL_MIXED_OPERAND)
+bool same(const eval::Number& a, const eval::Number& b)
+{
+    if (a.integral != b.integral) return false;
+    if (a.integral) return a.i == b.i;
+    return std::memcmp(&a.d, &b.d, 10) == 0 || (a.d != a.d && b.d != b.d);
+}
+#elif defined(EVAL_DECIMAL_OPERAND)
+bool same(eval::decimal_t a, eval::decimal_t b)
+{
+    return std::memcmp(&a, &b, 10) == 0 || (a != a && b != b);
+}
+#else
+bool same(eval::operand_t a, eval::operand_t b) { return a == b; }
+#endif
+
+eval::Context& runtime()
+{
+    static eval::Context context = []
+    {
+        eval::Context c;
+        c.importMath();
+        c.tiering.enabled = false;
+        return c;
+    }();
+    return context;
+}
+
+// The compiled literal against Context::tryEval, with x running over a few
+// values, y = 2 - x and any other parameter 2.
+template <typename F>
+void compare(const F& f, const char* text)
+{
+    const eval::operand_t xs[] = {
+        eval::operand_t(0), eval::operand_t(1), eval::operand_t(3),
+        eval::operand_t(-2), eval::operand_t(7),
+#ifdef EVAL_DECIMAL_OPERAND
+        eval::operand_t(0.5L), eval::operand_t(-1.25L), eval::operand_t(1e-3L)
+#endif
+    };
+    auto& context = runtime();
+    for (auto x : xs)
+    {
+        eval::operand_t values[F::arity + 1];
+        for (size_t i = 0; i < F::arity; ++i)
+        {
+            auto name = F::parameters[i];
+            values[i] = name == "x"   ? x
+                        : name == "y" ? eval::operand_t(2) - x
+                                      : eval::operand_t(2);
+            context.varTable[std::string(name)] = values[i];
+        }
+        auto r = f.tryEval(values);
+        auto s = context.tryEval(text);
+        bool ok = r.ok == s.ok &&
+                  (r.ok ? same(r.value, s.value) : r.error == s.error);
+        check::expect(ok, std::string(text) + " at x = " +
+                              std::to_string(static_cast<long double>(x)) +
+                              ": " + check::describe(r) + " against " +
+                              check::describe(s));
+    }
+}
+
+#define SAME(text) compare(EVAL_EXPR(text), text)
+}  // namespace
+
+// EVAL_EXPR gives the results of the interpreter, bit for bit, in every
+// operand mode.
+int main()
+{
+    SAME("2^3^2");
+    SAME("x*y-x/y^2");
+    SAME("-x^2");
+    SAME("x--y");
+    SAME("(3 - x) * -y");
+    SAME("(x + y) * (x - y) / 3");
+    SAME("x ^ 5 - 3 * x ^ 2 + 7");
+    SAME("123456789 * x - 987654321 / y");
+    SAME("1/(x-x)");
+    SAME("0*(1/(x-x))");
+    SAME("1/(x-x)*0");
+    SAME("abs(min(3, x, -y))");
+    SAME("max(x, y) - min(x, y)");
+    SAME("eq(x, y) + neq(x, y) + leq(x, y) + lt(x, y) + geq(x, 1) + gt(y, 1)");
+    SAME("IF_ELSE(gt(x, y), x, y)");
+    SAME("IF_ELSE(x, 10 / x, 1 / (y - y))");
+    SAME("abs(IF_ELSE(2, (1), x))+-1");
+    SAME("-min(-abs(3+-1))");
+    SAME("3*(abs((-1)))");
+#ifdef EVAL_DECIMAL_OPERAND
+    SAME("0.1 + 0.2 - 0.3");
+    SAME("3.14159265358979323846264338328 * x");
+    SAME("1e-320 * x + 4.9e-4950");
+    SAME("123456789012345678901 - x");
+    SAME("0.000001234567890123456789 * y");
+    SAME("1.18973149535723176502e4932 / (x + 3)");
+    SAME("9007199254740993 + 5. + 0.1e1 + 7e+2 + 2.5E3");
+    SAME("sin(x) * cos(y) + tan(x / 7)");
+    SAME("ln(abs(x) + 1) - lg(y ^ 2 + 1) + ln(x)");
+    SAME("log(2, abs(x) + 3) + exp(-x)");
+    SAME("asin(x / 10) + acos(y / 10) + atan(x)");
+    SAME("erf(x) + gamma(abs(x) + 0.5)");
+    SAME("floor(x * 2.5) + ceil(y / 3)");
+    SAME("x ^ 0.5 + y ^ -1.5");
+    SAME("1 / ((2*pi)^0.5 * s) * e^(-(x-mu)^2/(2*s^2))");
+    SAME("ceil(floor((e/2))*0.1e1)");
+    SAME("ln(x)*-gt(x, y)");
+    SAME("tan(0--sin(pi))");
+    SAME("IF_ELSE(1.9e-4951, e, gamma(4.9e-4950))--sin(pi)");
+    SAME("-IF_ELSE(y, 2.5e3, log(lt(IF_ELSE(pi, -pi, -x), max(pi, e, -1e-8)), "
+         "log(0.1, y)--2))");
+    SAME("max(y, e*-IF_ELSE(x+-1e-320, (-x), e--x))+-2--log(1.9e-4951, "
+         "log(e, -4.9e-4950)/log(3.6e-4951, -x))");
+    SAME("(max(0.3, (2), 0.000001234567890123456789+-y)--max(1e300, "
+         "log(-pi, e), x--123456789012345678901))--1e300");
+#endif
+    return check::result();
+}
\ No newline at end of file